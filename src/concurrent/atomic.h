@@ -0,0 +1,94 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_ATOMIC_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_ATOMIC_H_
+
+namespace pfi {
+namespace concurrent {
+namespace atomic {
+
+// loads and stores which order the memory accesses around them for other
+// threads, for lock-free structures. x86 keeps the order of loads and of
+// stores by itself, so only the compiler is stopped there.
+
+inline void compiler_barrier()
+{
+  __asm__ __volatile__("" : : : "memory");
+}
+
+inline void full_barrier()
+{
+  __sync_synchronize();
+}
+
+template <class T>
+inline T load_acquire(const volatile T& x)
+{
+  T v = x;
+#if defined(__i386__) || defined(__x86_64__)
+  compiler_barrier();
+#else
+  full_barrier();
+#endif
+  return v;
+}
+
+template <class T>
+inline void store_release(volatile T& x, T v)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  compiler_barrier();
+#else
+  full_barrier();
+#endif
+  x = v;
+}
+
+// a hint in spin loops
+inline void cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause" : : : "memory");
+#else
+  compiler_barrier();
+#endif
+}
+
+// the size which keeps variables written by different threads on
+// different cache lines
+const int cache_line_size = 64;
+
+} // atomic
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_ATOMIC_H_
@@ -0,0 +1,175 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_BROADCAST_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_BROADCAST_H_
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+#include "mutex.h"
+#include "condition.h"
+#include "lock.h"
+#include "../lang/shared_ptr.h"
+#include "../lang/util.h"
+#include "../system/time_util.h"
+
+namespace pfi{
+namespace concurrent{
+
+// a channel which delivers every written value to every subscriber, like
+// chan::dup(), but a write costs the same for any number of subscribers.
+// values are kept once, as shared_ptr<const T>, in a ring of the last
+// capacity values, and each subscriber only has its cursor into the ring.
+//
+// the writer never waits for readers: a subscriber which falls more than
+// capacity values behind skips to the oldest value in the ring, and
+// missed() counts the values it lost.
+template<class T>
+class broadcast : pfi::lang::noncopyable{
+public:
+  typedef pfi::lang::shared_ptr<const T> value_ptr;
+
+  class subscriber;
+
+  explicit broadcast(size_t capacity)
+    :ring(capacity > 0 ? capacity : 1), next(0){
+  }
+
+  size_t capacity() const{
+    return ring.size();
+  }
+
+  // the number of values written so far
+  uint64_t written() const{
+    pfi::concurrent::scoped_lock lock(m);
+    return next;
+  }
+
+  void write(const T& value){
+    write(value_ptr(new T(value)));
+  }
+
+  void write(const value_ptr& value){
+    {
+      pfi::concurrent::scoped_lock lock(m);
+      ring[next % ring.size()]=value;
+      next++;
+    }
+    cond.notify_all();
+  }
+
+private:
+  uint64_t oldest() const{
+    return next > ring.size() ? next - ring.size() : 0;
+  }
+
+  std::vector<value_ptr> ring;
+  uint64_t next;
+  mutable mutex m;
+  condition cond;
+};
+
+// a reader of a broadcast, which sees the values written after it is made.
+// a copy reads on from the same position by itself. a subscriber is used
+// by one thread at a time, and must not outlive its broadcast.
+template<class T>
+class broadcast<T>::subscriber{
+public:
+  explicit subscriber(broadcast& b)
+    :b(&b), pos(b.written()), missed_count(0){
+  }
+
+  // the number of values which can be read now
+  size_t size() const{
+    pfi::concurrent::scoped_lock lock(b->m);
+    return static_cast<size_t>(b->next - std::max(pos, b->oldest()));
+  }
+
+  bool empty() const{
+    return size()==0;
+  }
+
+  // the number of values skipped because this subscriber lagged
+  uint64_t missed() const{
+    return missed_count;
+  }
+
+  bool try_read(value_ptr& value){
+    pfi::concurrent::scoped_lock lock(b->m);
+    return take(value);
+  }
+
+  value_ptr read(){
+    value_ptr value;
+    pfi::concurrent::scoped_lock lock(b->m);
+    while (!take(value))
+      b->cond.wait(b->m);
+    return value;
+  }
+
+  // returns false when nothing is written for second seconds
+  bool read(value_ptr& value, double second){
+    const double start=static_cast<double>(system::time::get_clock_time());
+    pfi::concurrent::scoped_lock lock(b->m);
+    while (!take(value)) {
+      const double rest=second-(static_cast<double>(system::time::get_clock_time())-start);
+      if (rest <= 0)
+        return false;
+      b->cond.wait(b->m, rest);
+    }
+    return true;
+  }
+
+private:
+  // with b->m locked
+  bool take(value_ptr& value){
+    const uint64_t oldest=b->oldest();
+    if (pos < oldest) {
+      missed_count+=oldest-pos;
+      pos=oldest;
+    }
+    if (pos==b->next)
+      return false;
+    value=b->ring[pos % b->ring.size()];
+    pos++;
+    return true;
+  }
+
+  broadcast* b;
+  uint64_t pos;
+  uint64_t missed_count;
+};
+
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_BROADCAST_H_
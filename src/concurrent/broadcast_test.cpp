@@ -0,0 +1,156 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "broadcast.h"
+
+#include <string>
+#include <vector>
+
+#include "thread.h"
+#include "../system/time_util.h"
+#include "../lang/shared_ptr.h"
+#include "../lang/bind.h"
+
+using namespace std;
+using namespace pfi::concurrent;
+using namespace pfi::lang;
+using namespace pfi::system::time;
+
+TEST(broadcast, read)
+{
+  broadcast<string> b(8);
+  broadcast<string>::subscriber s1(b);
+  b.write("a");
+  broadcast<string>::subscriber s2(b);
+  b.write("b");
+  b.write("c");
+  EXPECT_EQ(3U, b.written());
+  EXPECT_EQ(3U, s1.size());
+  EXPECT_EQ(2U, s2.size());
+
+  broadcast<string>::value_ptr v1, v2;
+  EXPECT_EQ("a", *s1.read());
+  ASSERT_TRUE(s1.try_read(v1));
+  ASSERT_TRUE(s2.try_read(v2));
+  EXPECT_EQ("b", *v1);
+  // the value is shared, not copied for each subscriber
+  EXPECT_EQ(v1.get(), v2.get());
+
+  // a copy reads on by itself
+  broadcast<string>::subscriber s3(s2);
+  EXPECT_EQ("c", *s2.read());
+  EXPECT_EQ("c", *s3.read());
+  EXPECT_EQ("c", *s1.read());
+  EXPECT_TRUE(s1.empty());
+  EXPECT_FALSE(s1.try_read(v1));
+  EXPECT_EQ(0U, s1.missed());
+}
+
+TEST(broadcast, lag)
+{
+  broadcast<int> b(4);
+  broadcast<int>::subscriber s(b);
+  for (int i = 0; i < 10; i++)
+    b.write(i);
+  EXPECT_EQ(4U, s.size());
+
+  for (int i = 6; i < 10; i++)
+    EXPECT_EQ(i, *s.read());
+  EXPECT_EQ(6U, s.missed());
+  EXPECT_TRUE(s.empty());
+
+  b.write(10);
+  EXPECT_EQ(10, *s.read());
+  EXPECT_EQ(6U, s.missed());
+}
+
+TEST(broadcast, read_timeout)
+{
+  broadcast<int> b(1);
+  broadcast<int>::subscriber s(b);
+  broadcast<int>::value_ptr v;
+  for (int i = -1; i <= 1; i++) {
+    double timeout = 0.001 * i;
+    clock_time start = get_clock_time();
+    ASSERT_FALSE(s.read(v, timeout));
+    clock_time end = get_clock_time();
+    EXPECT_LE(timeout, end - start);
+  }
+  b.write(1);
+  ASSERT_TRUE(s.read(v, 1.0));
+  EXPECT_EQ(1, *v);
+}
+
+namespace {
+
+const int end_mark = -1;
+
+void reader_func(broadcast<int>::subscriber s, vector<int>* got)
+{
+  for (;;) {
+    int v = *s.read();
+    if (v == end_mark)
+      break;
+    got->push_back(v);
+  }
+  EXPECT_EQ(0U, s.missed());
+}
+
+} // namespace
+
+TEST(broadcast, normal)
+{
+  const size_t reader_num = 8;
+  const int value_num = 20000;
+
+  broadcast<int> b(value_num + 1);
+  vector<vector<int> > got(reader_num);
+  vector<pfi::lang::shared_ptr<thread> > readers(reader_num);
+  for (size_t i = 0; i < readers.size(); i++) {
+    readers[i].reset(new thread(bind(reader_func,
+                                     broadcast<int>::subscriber(b), &got[i])));
+    ASSERT_TRUE(readers[i]->start());
+  }
+
+  for (int i = 0; i < value_num; i++)
+    b.write(i);
+  b.write(end_mark);
+  for (size_t i = 0; i < readers.size(); i++)
+    ASSERT_TRUE(readers[i]->join());
+
+  for (size_t i = 0; i < got.size(); i++) {
+    ASSERT_EQ(static_cast<size_t>(value_num), got[i].size());
+    for (int j = 0; j < value_num; j++)
+      ASSERT_EQ(j, got[i][j]);
+  }
+}
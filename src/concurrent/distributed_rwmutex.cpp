@@ -0,0 +1,212 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "distributed_rwmutex.h"
+
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+
+#include "atomic.h"
+#include "futex.h"
+#include "../system/time_util.h"
+
+using namespace pfi::system::time;
+
+namespace pfi{
+namespace concurrent{
+
+struct distributed_rw_mutex::slot{
+  volatile int readers;
+} __attribute__((aligned(64)));
+
+namespace {
+
+volatile int thread_count=0;
+__thread int thread_index=0;
+
+// a number for the calling thread, from 1. threads take slots by turns,
+// rather than by the processor they run on, so that a reader unlocks the
+// slot it locked after it moves to another processor.
+int self_index()
+{
+  if (thread_index==0)
+    thread_index=__sync_add_and_fetch(&thread_count, 1);
+  return thread_index;
+}
+
+size_t slot_count()
+{
+  long n=sysconf(_SC_NPROCESSORS_ONLN);
+  size_t r=1;
+  while (n > 0 && r < static_cast<size_t>(n))
+    r<<=1;
+  return r;
+}
+
+double rest_of(double sec, double start)
+{
+  return sec-(static_cast<double>(get_clock_time())-start);
+}
+
+} // namespace
+
+distributed_rw_mutex::distributed_rw_mutex()
+  :slots(NULL), mask(slot_count()-1), writer(0), owner(0)
+{
+  void* p;
+  if (posix_memalign(&p, atomic::cache_line_size, sizeof(slot)*(mask+1))!=0)
+    throw std::bad_alloc();
+  slots=static_cast<slot*>(p);
+  for (size_t i=0;i<=mask;i++)
+    slots[i].readers=0;
+}
+
+distributed_rw_mutex::~distributed_rw_mutex()
+{
+  free(slots);
+}
+
+bool distributed_rw_mutex::read_lock()
+{
+  return lock_read(false, 0);
+}
+
+bool distributed_rw_mutex::read_lock(double sec)
+{
+  return lock_read(true, sec);
+}
+
+bool distributed_rw_mutex::write_lock()
+{
+  return lock_write(false, 0);
+}
+
+bool distributed_rw_mutex::write_lock(double sec)
+{
+  return lock_write(true, sec);
+}
+
+bool distributed_rw_mutex::unlock()
+{
+  const int self=self_index();
+  if (atomic::load_acquire(owner)==self){
+    release_write();
+    return true;
+  }
+
+  slot& s=slots[(self-1)&mask];
+  if (atomic::load_acquire(s.readers)<=0)
+    return false;
+  leave(s);
+  return true;
+}
+
+bool distributed_rw_mutex::lock_read(bool timed, double sec)
+{
+  const double start=timed ? static_cast<double>(get_clock_time()) : 0;
+  slot& s=slots[(self_index()-1)&mask];
+  for (;;){
+    // the increment is a full barrier, so that the writer sees it or
+    // this thread sees the writer
+    __sync_fetch_and_add(&s.readers, 1);
+    if (atomic::load_acquire(writer)==0)
+      return true;
+    leave(s);
+
+    if (!timed)
+      futex_wait(&writer, 1);
+    else{
+      const double rest=rest_of(sec, start);
+      if (rest<=0)
+        return false;
+      futex_wait(&writer, 1, rest);
+    }
+  }
+}
+
+bool distributed_rw_mutex::lock_write(bool timed, double sec)
+{
+  const double start=timed ? static_cast<double>(get_clock_time()) : 0;
+  while (!__sync_bool_compare_and_swap(&writer, 0, 1)){
+    if (!timed)
+      futex_wait(&writer, 1);
+    else{
+      const double rest=rest_of(sec, start);
+      if (rest<=0)
+        return false;
+      futex_wait(&writer, 1, rest);
+    }
+  }
+  atomic::store_release(owner, self_index());
+
+  for (size_t i=0;i<=mask;i++){
+    slot& s=slots[i];
+    for (int spin=0;;spin++){
+      const int r=atomic::load_acquire(s.readers);
+      if (r==0)
+        break;
+      if (spin<64){
+        atomic::cpu_relax();
+        continue;
+      }
+      if (!timed)
+        futex_wait(&s.readers, r);
+      else{
+        const double rest=rest_of(sec, start);
+        if (rest<=0){
+          release_write();
+          return false;
+        }
+        futex_wait(&s.readers, r, rest);
+      }
+    }
+  }
+  return true;
+}
+
+void distributed_rw_mutex::release_write()
+{
+  atomic::store_release(owner, 0);
+  atomic::store_release(writer, 0);
+  futex_wake(&writer, INT_MAX);
+}
+
+void distributed_rw_mutex::leave(slot& s)
+{
+  // the last reader of the slot wakes the writer waiting for it
+  if (__sync_sub_and_fetch(&s.readers, 1)==0 && atomic::load_acquire(writer))
+    futex_wake(&s.readers, 1);
+}
+
+} // concurrent
+} // pfi
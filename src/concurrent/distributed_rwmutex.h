@@ -0,0 +1,85 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_DISTRIBUTED_RWMUTEX_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_DISTRIBUTED_RWMUTEX_H_
+
+#include <cstddef>
+
+#include "rwmutex.h"
+#include "../lang/noncopyable.h"
+
+namespace pfi{
+namespace concurrent{
+
+// a readers-writer lock for read-mostly data (a big-reader lock). each
+// thread counts its read locks in a slot of its own cache line, so that
+// readers do not write any line in common. a writer raises a flag, which
+// turns new readers away, and then waits until every slot drains.
+//
+// read locks scale with cores. write locks cost a scan of the slots, and
+// the lock takes a cache line per processor, so it suits a few hot locks
+// which are rarely written. writers are preferred, as with rw_mutex.
+//
+// it has the interface of rw_mutex, and works with rlock(), wlock() and
+// scoped_rwlock<rlock_func, distributed_rw_mutex>. it is not recursive.
+class distributed_rw_mutex : pfi::lang::noncopyable{
+public:
+  distributed_rw_mutex();
+  ~distributed_rw_mutex();
+
+  bool read_lock();
+  bool read_lock(double sec);
+  bool write_lock();
+  bool write_lock(double sec);
+
+  bool unlock();
+
+private:
+  struct slot;
+
+  bool lock_read(bool timed, double sec);
+  bool lock_write(bool timed, double sec);
+  void release_write();
+  void leave(slot& s);
+
+  slot* slots;
+  size_t mask;
+
+  // 1 while a writer holds or waits for the lock
+  volatile int writer;
+  // the thread index of the writer
+  volatile int owner;
+};
+
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_DISTRIBUTED_RWMUTEX_H_
@@ -0,0 +1,140 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "distributed_rwmutex.h"
+
+#include <vector>
+
+#include "thread.h"
+#include "../lang/shared_ptr.h"
+#include "../lang/bind.h"
+
+using namespace std;
+using namespace pfi::concurrent;
+using namespace pfi::lang;
+
+namespace {
+
+void try_read(distributed_rw_mutex* m, bool* locked)
+{
+  *locked = m->read_lock(0.01);
+  if (*locked)
+    m->unlock();
+}
+
+void try_write(distributed_rw_mutex* m, bool* locked)
+{
+  *locked = m->write_lock(0.01);
+  if (*locked)
+    m->unlock();
+}
+
+bool locked_in_thread(void (*f)(distributed_rw_mutex*, bool*),
+                      distributed_rw_mutex* m)
+{
+  bool locked = false;
+  thread t(bind(f, m, &locked));
+  t.start();
+  t.join();
+  return locked;
+}
+
+struct counters {
+  distributed_rw_mutex m;
+  int a;
+  int b;
+  volatile int errors;
+};
+
+void update(counters* c, int times)
+{
+  for (int i = 0; i < times; i++) {
+    if (i % 16 == 0) {
+      scoped_rwlock<wlock_func, distributed_rw_mutex> lk(c->m);
+      c->a++;
+      thread::yield();
+      c->b++;
+    } else {
+      synchronized(rlock(c->m)) {
+        if (c->a != c->b)
+          __sync_fetch_and_add(&c->errors, 1);
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(distributed_rw_mutex, exclusion)
+{
+  distributed_rw_mutex m;
+
+  ASSERT_TRUE(m.read_lock());
+  EXPECT_TRUE(locked_in_thread(&try_read, &m));
+  EXPECT_FALSE(locked_in_thread(&try_write, &m));
+  EXPECT_TRUE(m.unlock());
+
+  ASSERT_TRUE(m.write_lock());
+  EXPECT_FALSE(locked_in_thread(&try_read, &m));
+  EXPECT_FALSE(locked_in_thread(&try_write, &m));
+  EXPECT_TRUE(m.unlock());
+
+  EXPECT_TRUE(locked_in_thread(&try_write, &m));
+  EXPECT_TRUE(m.write_lock(0));
+  EXPECT_TRUE(m.unlock());
+  EXPECT_TRUE(m.read_lock(0));
+  EXPECT_TRUE(m.unlock());
+  EXPECT_FALSE(m.unlock());
+}
+
+TEST(distributed_rw_mutex, normal)
+{
+  const int thread_num = 8;
+  const int times = 20000;
+
+  counters c;
+  c.a = c.b = 0;
+  c.errors = 0;
+
+  vector<pfi::lang::shared_ptr<thread> > ts(thread_num);
+  for (size_t i = 0; i < ts.size(); i++) {
+    ts[i].reset(new thread(bind(&update, &c, times)));
+    ASSERT_TRUE(ts[i]->start());
+  }
+  for (size_t i = 0; i < ts.size(); i++)
+    ASSERT_TRUE(ts[i]->join());
+
+  EXPECT_EQ(0, c.errors);
+  EXPECT_EQ(thread_num * ((times + 15) / 16), c.a);
+  EXPECT_EQ(c.a, c.b);
+}
@@ -0,0 +1,94 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "futex.h"
+
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "internal.h"
+
+namespace pfi {
+namespace concurrent {
+
+#ifdef __linux__
+
+bool futex_wait(volatile int* addr, int val, double sec)
+{
+  timespec ts;
+  timespec* tsp = NULL;
+  if (sec >= 0) {
+    ts = to_timespec(sec);
+    tsp = &ts;
+  }
+  if (syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, tsp, NULL, 0) == 0)
+    return true;
+  return errno != ETIMEDOUT;
+}
+
+void futex_wake(volatile int* addr, int n)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+#else
+
+// polls without futexes
+bool futex_wait(volatile int* addr, int val, double sec)
+{
+  const double interval = 1e-4;
+  if (*addr != val)
+    return true;
+  if (0 <= sec && sec < interval) {
+    timespec ts = to_timespec(sec);
+    nanosleep(&ts, NULL);
+    return *addr != val;
+  }
+  timespec ts = to_timespec(interval);
+  nanosleep(&ts, NULL);
+  return true;
+}
+
+void futex_wake(volatile int*, int)
+{
+}
+
+#endif
+
+} // concurrent
+} // pfi
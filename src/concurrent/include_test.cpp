@@ -1,12 +1,19 @@
+#include "atomic.h"
+#include "broadcast.h"
 #include "chan.h"
 #include "condition.h"
+#include "distributed_rwmutex.h"
+#include "futex.h"
 #include "internal.h"
 #include "lock.h"
+#include "mpmc_queue.h"
 #include "mutex.h"
 #include "mutex_impl.h"
 #include "mvar.h"
 #include "pcbuf.h"
 #include "qsem.h"
 #include "rwmutex.h"
+#include "spsc_ring.h"
 #include "thread.h"
+#include "thread_pool.h"
 #include "threading_model.h"
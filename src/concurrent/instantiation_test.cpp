@@ -1,23 +1,44 @@
+#include "broadcast.h"
 #include "chan.h"
+#include "distributed_rwmutex.h"
+#include "mpmc_queue.h"
 #include "mvar.h"
 #include "pcbuf.h"
 #include "rwmutex.h"
+#include "spsc_ring.h"
+#include "thread_pool.h"
 #include <string>
 
 namespace pfi {
 namespace concurrent {
 
+template class broadcast<int>;
+template class broadcast<std::string>;
+
 template class chan<int>;
 template class chan<std::string>;
 
+template class mpmc_queue<int>;
+template class mpmc_queue<std::string>;
+
 template class mvar<int>;
 template class mvar<std::string>;
 
 template class pcbuf<int>;
 template class pcbuf<std::string>;
 
+template class spsc_ring<int>;
+template class spsc_ring<std::string>;
+
+template class future<int>;
+template class future<std::string>;
+
 template class scoped_rwlock<pfi::concurrent::rlock_func>;
 template class scoped_rwlock<pfi::concurrent::wlock_func>;
+template class scoped_rwlock<pfi::concurrent::rlock_func, distributed_rw_mutex>;
+template class scoped_rwlock<pfi::concurrent::wlock_func, distributed_rw_mutex>;
+template class basic_rlocker<distributed_rw_mutex>;
+template class basic_wlocker<distributed_rw_mutex>;
 
 } // namespace concurrent
 } // namespace pfi
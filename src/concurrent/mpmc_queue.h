@@ -0,0 +1,244 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_MPMC_QUEUE_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_MPMC_QUEUE_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+#include "atomic.h"
+#include "futex.h"
+#include "../lang/util.h"
+#include "../system/time_util.h"
+
+namespace pfi {
+namespace concurrent {
+
+// a bounded queue for many producers and consumers, without locks
+// (Dmitry Vyukov's bounded MPMC queue). it has the interface of pcbuf.
+// each slot has a sequence number, which tells producers and consumers
+// whether it is free or filled for their turn, so that they contend only
+// on the head or the tail. blocking calls spin shortly, and park on a
+// futex only while the queue is full or empty.
+//
+// the capacity is rounded up to a power of two. T must be default
+// constructible and assignable.
+template <class T>
+class mpmc_queue : pfi::lang::noncopyable {
+public:
+  explicit mpmc_queue(size_t capacity)
+    : mask(round_up(capacity) - 1), cells(NULL),
+      enqueue_pos(0), push_waiters(0), push_event(0),
+      dequeue_pos(0), pop_waiters(0), pop_event(0) {
+    void* p;
+    if (posix_memalign(&p, atomic::cache_line_size, sizeof(cell) * (mask + 1)) != 0)
+      throw std::bad_alloc();
+    cells = static_cast<cell*>(p);
+    for (size_t i = 0; i <= mask; i++) {
+      new (&cells[i]) cell();
+      cells[i].seq = i;
+    }
+  }
+
+  ~mpmc_queue() {
+    for (size_t i = 0; i <= mask; i++)
+      cells[i].~cell();
+    free(cells);
+  }
+
+  size_t capacity() const {
+    return mask + 1;
+  }
+
+  // they may be out of date when they return
+  size_t size() const {
+    const size_t head = atomic::load_acquire(dequeue_pos);
+    const size_t tail = atomic::load_acquire(enqueue_pos);
+    return tail > head ? tail - head : 0;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  bool try_push(const T& value) {
+    cell* c;
+    size_t pos = atomic::load_acquire(enqueue_pos);
+    for (;;) {
+      c = &cells[pos & mask];
+      const size_t seq = atomic::load_acquire(c->seq);
+      const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (dif == 0) {
+        if (__sync_bool_compare_and_swap(&enqueue_pos, pos, pos + 1))
+          break;
+        pos = atomic::load_acquire(enqueue_pos);
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = atomic::load_acquire(enqueue_pos);
+      }
+    }
+    c->value = value;
+    atomic::store_release(c->seq, pos + 1);
+    notify(pop_waiters, pop_event);
+    return true;
+  }
+
+  bool try_pop(T& value) {
+    cell* c;
+    size_t pos = atomic::load_acquire(dequeue_pos);
+    for (;;) {
+      c = &cells[pos & mask];
+      const size_t seq = atomic::load_acquire(c->seq);
+      const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (dif == 0) {
+        if (__sync_bool_compare_and_swap(&dequeue_pos, pos, pos + 1))
+          break;
+        pos = atomic::load_acquire(dequeue_pos);
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = atomic::load_acquire(dequeue_pos);
+      }
+    }
+    value = c->value;
+    c->value = T();
+    atomic::store_release(c->seq, pos + mask + 1);
+    notify(push_waiters, push_event);
+    return true;
+  }
+
+  void push(const T& value) {
+    wait(&mpmc_queue::try_push_ref, const_cast<T&>(value), false, 0,
+         push_waiters, push_event);
+  }
+
+  // returns false when the queue is full for second seconds
+  bool push(const T& value, double second) {
+    return wait(&mpmc_queue::try_push_ref, const_cast<T&>(value), true, second,
+                push_waiters, push_event);
+  }
+
+  void pop(T& value) {
+    wait(&mpmc_queue::try_pop, value, false, 0, pop_waiters, pop_event);
+  }
+
+  // returns false when the queue is empty for second seconds
+  bool pop(T& value, double second) {
+    return wait(&mpmc_queue::try_pop, value, true, second, pop_waiters, pop_event);
+  }
+
+private:
+  struct cell {
+    cell() : seq(0), value() {}
+
+    volatile size_t seq;
+    T value;
+  } __attribute__((aligned(64)));
+
+  static size_t round_up(size_t n) {
+    size_t r = 2;
+    while (r < n)
+      r <<= 1;
+    return r;
+  }
+
+  bool try_push_ref(T& value) {
+    return try_push(value);
+  }
+
+  // wakes a thread parked in wait(), if any
+  static void notify(volatile int& waiters, volatile int& event) {
+    atomic::full_barrier();
+    if (waiters > 0) {
+      __sync_fetch_and_add(&event, 1);
+      futex_wake(&event, 1);
+    }
+  }
+
+  // tries op until it succeeds, spinning and then parking on event, or
+  // until second seconds pass when timed
+  bool wait(bool (mpmc_queue::*op)(T&), T& value, bool timed, double second,
+            volatile int& waiters, volatile int& event) {
+    for (int i = 0; i < 64; i++) {
+      if ((this->*op)(value))
+        return true;
+      atomic::cpu_relax();
+    }
+
+    const double start = static_cast<double>(pfi::system::time::get_clock_time());
+    for (;;) {
+      const int ev = atomic::load_acquire(event);
+      __sync_fetch_and_add(&waiters, 1);
+      // an item may have come before this thread was counted as a waiter
+      if ((this->*op)(value)) {
+        __sync_fetch_and_sub(&waiters, 1);
+        return true;
+      }
+
+      double rest = -1;
+      if (timed) {
+        rest = second - (static_cast<double>(pfi::system::time::get_clock_time()) - start);
+        if (rest <= 0) {
+          __sync_fetch_and_sub(&waiters, 1);
+          return false;
+        }
+      }
+      futex_wait(&event, ev, rest);
+      __sync_fetch_and_sub(&waiters, 1);
+
+      if ((this->*op)(value))
+        return true;
+    }
+  }
+
+  const size_t mask;
+  cell* cells;
+
+  // producers and consumers write different cache lines
+  char pad0[atomic::cache_line_size];
+  volatile size_t enqueue_pos;
+  volatile int push_waiters;
+  volatile int push_event;
+  char pad1[atomic::cache_line_size];
+  volatile size_t dequeue_pos;
+  volatile int pop_waiters;
+  volatile int pop_event;
+  char pad2[atomic::cache_line_size];
+};
+
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_MPMC_QUEUE_H_
@@ -0,0 +1,174 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include "mpmc_queue.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "thread.h"
+#include "mutex.h"
+#include "lock.h"
+#include "../system/time_util.h"
+#include "../lang/shared_ptr.h"
+#include "../lang/bind.h"
+#include "../lang/cast.h"
+
+using namespace std;
+using namespace pfi::concurrent;
+using namespace pfi::lang;
+using namespace pfi::system::time;
+
+TEST(mpmc_queue, fifo)
+{
+  mpmc_queue<string> q(5);
+  EXPECT_EQ(8U, q.capacity());
+  EXPECT_TRUE(q.empty());
+
+  for (int i = 0; i < 8; i++)
+    EXPECT_TRUE(q.try_push(lexical_cast<string>(i)));
+  EXPECT_FALSE(q.try_push("x"));
+  EXPECT_EQ(8U, q.size());
+
+  string v;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 8; i++) {
+      ASSERT_TRUE(q.try_pop(v));
+      EXPECT_EQ(lexical_cast<string>(i), v);
+      EXPECT_TRUE(q.try_push(lexical_cast<string>(i)));
+    }
+  }
+  for (int i = 0; i < 8; i++)
+    ASSERT_TRUE(q.try_pop(v));
+  EXPECT_FALSE(q.try_pop(v));
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(mpmc_queue, pop_timeout)
+{
+  mpmc_queue<int> q(1);
+  int value;
+  for (int i = -1; i <= 1; i++) {
+    double timeout = 0.001 * i;
+    clock_time start = get_clock_time();
+    ASSERT_FALSE(q.pop(value, timeout));
+    clock_time end = get_clock_time();
+    EXPECT_LE(timeout, end - start);
+  }
+}
+
+TEST(mpmc_queue, push_timeout)
+{
+  mpmc_queue<int> q(2);
+  q.push(0);
+  q.push(1);
+  for (int i = -1; i <= 1; i++) {
+    double timeout = 0.001 * i;
+    clock_time start = get_clock_time();
+    ASSERT_FALSE(q.push(i, timeout));
+    clock_time end = get_clock_time();
+    EXPECT_LE(timeout, end - start);
+  }
+}
+
+namespace {
+
+const int end_mark = -1;
+
+void producer_func(mpmc_queue<int>* q, int min, int max)
+{
+  for (int i = min; i < max; i++)
+    q->push(i);
+}
+
+void consumer_func(mpmc_queue<int>* q, vector<int>* got)
+{
+  for (;;) {
+    int v;
+    q->pop(v);
+    if (v == end_mark)
+      break;
+    got->push_back(v);
+  }
+}
+
+} // namespace
+
+TEST(mpmc_queue, normal)
+{
+  // a small queue, so that producers and consumers park often
+  const size_t producer_num = 4;
+  const size_t consumer_num = 4;
+  const int per_producer = 20000;
+
+  mpmc_queue<int> q(4);
+  vector<vector<int> > got(consumer_num);
+
+  vector<pfi::lang::shared_ptr<thread> > consumers(consumer_num);
+  for (size_t i = 0; i < consumers.size(); i++) {
+    consumers[i].reset(new thread(bind(consumer_func, &q, &got[i])));
+    ASSERT_TRUE(consumers[i]->start());
+  }
+
+  vector<pfi::lang::shared_ptr<thread> > producers(producer_num);
+  for (size_t i = 0; i < producers.size(); i++) {
+    producers[i].reset(new thread(bind(producer_func, &q,
+                                       static_cast<int>(i) * per_producer,
+                                       static_cast<int>(i + 1) * per_producer)));
+    ASSERT_TRUE(producers[i]->start());
+  }
+
+  for (size_t i = 0; i < producers.size(); i++)
+    ASSERT_TRUE(producers[i]->join());
+  for (size_t i = 0; i < consumers.size(); i++)
+    q.push(end_mark);
+  for (size_t i = 0; i < consumers.size(); i++)
+    ASSERT_TRUE(consumers[i]->join());
+
+  // every value is popped once, and values of a producer are in order
+  vector<int> count(producer_num * per_producer);
+  for (size_t i = 0; i < got.size(); i++) {
+    vector<int> last(producer_num, -1);
+    for (size_t j = 0; j < got[i].size(); j++) {
+      int v = got[i][j];
+      count[v]++;
+      EXPECT_LT(last[v / per_producer], v);
+      last[v / per_producer] = v;
+    }
+  }
+  for (size_t i = 0; i < count.size(); i++)
+    ASSERT_EQ(1, count[i]) << i;
+  EXPECT_TRUE(q.empty());
+}
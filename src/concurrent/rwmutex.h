@@ -58,19 +58,22 @@ private:
   pfi::lang::scoped_ptr<impl> pimpl;
 };
 
-class rlocker : public lockable{
+// lockers for rw_mutex, and for locks with the same interface
+
+template <class M>
+class basic_rlocker : public lockable{
 public:
-  rlocker(rw_mutex &m)
+  basic_rlocker(M &m)
     : m(m)
     , use_sec(false)
     , sec(-1){
   }
-  rlocker(rw_mutex &m, double sec)
+  basic_rlocker(M &m, double sec)
     : m(m)
     , use_sec(true)
     , sec(sec){
   }
-  ~rlocker(){
+  ~basic_rlocker(){
   }
 
   bool lock(){
@@ -85,24 +88,25 @@ public:
   }
 
 private:
-  rw_mutex &m;
+  M &m;
   bool use_sec;
   double sec;
 };
 
-class wlocker : public lockable{
+template <class M>
+class basic_wlocker : public lockable{
 public:
-  wlocker(rw_mutex &m)
+  basic_wlocker(M &m)
     : m(m)
     , use_sec(false)
     , sec(-1){
   }
-  wlocker(rw_mutex &m, double sec)
+  basic_wlocker(M &m, double sec)
     : m(m)
     , use_sec(true)
     , sec(sec){
   }
-  ~wlocker(){
+  ~basic_wlocker(){
   }
 
   bool lock(){
@@ -117,58 +121,69 @@ public:
   }
 
 private:
-  rw_mutex &m;
+  M &m;
   bool use_sec;
   double sec;
 };
 
-inline std::auto_ptr<lockable> rlock(rw_mutex &m)
+typedef basic_rlocker<rw_mutex> rlocker;
+typedef basic_wlocker<rw_mutex> wlocker;
+
+template <class M>
+inline std::auto_ptr<lockable> rlock(M &m)
 {
-  return std::auto_ptr<lockable>(new rlocker(m));
+  return std::auto_ptr<lockable>(new basic_rlocker<M>(m));
 }
 
-inline std::auto_ptr<lockable> rlock(rw_mutex &m, double sec)
+template <class M>
+inline std::auto_ptr<lockable> rlock(M &m, double sec)
 {
-  return std::auto_ptr<lockable>(new rlocker(m,sec));
+  return std::auto_ptr<lockable>(new basic_rlocker<M>(m,sec));
 }
 
-inline std::auto_ptr<lockable> wlock(rw_mutex &m)
+template <class M>
+inline std::auto_ptr<lockable> wlock(M &m)
 {
-  return std::auto_ptr<lockable>(new wlocker(m));
+  return std::auto_ptr<lockable>(new basic_wlocker<M>(m));
 }
 
-inline std::auto_ptr<lockable> wlock(rw_mutex &m, double sec)
+template <class M>
+inline std::auto_ptr<lockable> wlock(M &m, double sec)
 {
-  return std::auto_ptr<lockable>(new wlocker(m,sec));
+  return std::auto_ptr<lockable>(new basic_wlocker<M>(m,sec));
 }
 
 // for spped optimization
 
 class rlock_func{
 public:
-  static bool lock(rw_mutex *m){
+  template <class M>
+  static bool lock(M *m){
     return m->read_lock();
   }
-  static bool lock(rw_mutex *m, double sec){
+  template <class M>
+  static bool lock(M *m, double sec){
     return m->read_lock(sec);
   }
 };
 
 class wlock_func{
 public:
-  static bool lock(rw_mutex *m){ 
+  template <class M>
+  static bool lock(M *m){
     return m->write_lock();
   }
-  static bool lock(rw_mutex *m, double sec){
+  template <class M>
+  static bool lock(M *m, double sec){
     return m->write_lock(sec);
   }
 };
 
-template <class LF>
-class scoped_rwlock : public pfi::lang::safe_bool<scoped_rwlock<LF> >
+template <class LF, class M = rw_mutex>
+class scoped_rwlock : public pfi::lang::safe_bool<scoped_rwlock<LF, M> >
                     , pfi::lang::noncopyable {
 public:
-  explicit scoped_rwlock(rw_mutex &m, double sec=-1)
+  explicit scoped_rwlock(M &m, double sec=-1)
     : m(&m)
     , need_unlock(false){
     if (sec>=0){
@@ -196,7 +211,7 @@ public:
   bool bool_test() const { return locked(); }
 
 private:
-  rw_mutex *m;
+  M *m;
   mutable bool need_unlock;
 };
 
@@ -0,0 +1,242 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_SPSC_RING_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_SPSC_RING_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "atomic.h"
+#include "futex.h"
+#include "../lang/util.h"
+#include "../system/time_util.h"
+
+namespace pfi {
+namespace concurrent {
+
+// a bounded queue for one producer thread and one consumer thread. the
+// non-blocking calls are wait-free: each side writes only its own index,
+// and reads the other one only when its cached copy says the ring is full
+// or empty. batches move several values for one index update.
+//
+// blocking calls spin shortly, and then park on a futex. the producer
+// does not fence before it looks for a parked consumer, and vice versa,
+// so a wake-up can be missed when the other side parks at the same
+// moment. parking is limited to 1ms at a time for that case.
+//
+// the capacity is rounded up to a power of two. T must be default
+// constructible and assignable.
+template <class T>
+class spsc_ring : pfi::lang::noncopyable {
+public:
+  explicit spsc_ring(size_t capacity)
+    : mask(round_up(capacity) - 1), buf(mask + 1),
+      head(0), cached_tail(0), tail(0), cached_head(0),
+      pop_waiting(0), push_waiting(0) {
+  }
+
+  size_t capacity() const {
+    return mask + 1;
+  }
+
+  // they may be out of date when they return
+  size_t size() const {
+    const size_t h = atomic::load_acquire(head);
+    return atomic::load_acquire(tail) - h;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  // called by the producer
+
+  bool try_push(const T& value) {
+    const size_t t = tail;
+    if (t - cached_head > mask) {
+      cached_head = atomic::load_acquire(head);
+      if (t - cached_head > mask)
+        return false;
+    }
+    buf[t & mask] = value;
+    atomic::store_release(tail, t + 1);
+    wake(pop_waiting);
+    return true;
+  }
+
+  // pushes up to n values from p, and returns how many are pushed
+  size_t push_n(const T* p, size_t n) {
+    const size_t t = tail;
+    if (t - cached_head + n > mask + 1)
+      cached_head = atomic::load_acquire(head);
+    const size_t room = mask + 1 - (t - cached_head);
+    if (n > room)
+      n = room;
+    for (size_t i = 0; i < n; i++)
+      buf[(t + i) & mask] = p[i];
+    if (n > 0) {
+      atomic::store_release(tail, t + n);
+      wake(pop_waiting);
+    }
+    return n;
+  }
+
+  void push(const T& value) {
+    wait(&spsc_ring::try_push_ref, const_cast<T&>(value), false, 0, push_waiting);
+  }
+
+  // returns false when the ring is full for second seconds
+  bool push(const T& value, double second) {
+    return wait(&spsc_ring::try_push_ref, const_cast<T&>(value), true, second,
+                push_waiting);
+  }
+
+  // called by the consumer
+
+  bool try_pop(T& value) {
+    const size_t h = head;
+    if (h == cached_tail) {
+      cached_tail = atomic::load_acquire(tail);
+      if (h == cached_tail)
+        return false;
+    }
+    T& slot = buf[h & mask];
+    value = slot;
+    slot = T();
+    atomic::store_release(head, h + 1);
+    wake(push_waiting);
+    return true;
+  }
+
+  // pops up to n values to p, and returns how many are popped
+  size_t pop_n(T* p, size_t n) {
+    const size_t h = head;
+    if (cached_tail - h < n)
+      cached_tail = atomic::load_acquire(tail);
+    const size_t avail = cached_tail - h;
+    if (n > avail)
+      n = avail;
+    for (size_t i = 0; i < n; i++) {
+      T& slot = buf[(h + i) & mask];
+      p[i] = slot;
+      slot = T();
+    }
+    if (n > 0) {
+      atomic::store_release(head, h + n);
+      wake(push_waiting);
+    }
+    return n;
+  }
+
+  void pop(T& value) {
+    wait(&spsc_ring::try_pop, value, false, 0, pop_waiting);
+  }
+
+  // returns false when the ring is empty for second seconds
+  bool pop(T& value, double second) {
+    return wait(&spsc_ring::try_pop, value, true, second, pop_waiting);
+  }
+
+private:
+  static size_t round_up(size_t n) {
+    size_t r = 1;
+    while (r < n)
+      r <<= 1;
+    return r;
+  }
+
+  bool try_push_ref(T& value) {
+    return try_push(value);
+  }
+
+  // only the parking side writes waiting, so that the line stays shared
+  // while nobody parks
+  static void wake(volatile int& waiting) {
+    if (waiting)
+      futex_wake(&waiting, 1);
+  }
+
+  bool wait(bool (spsc_ring::*op)(T&), T& value, bool timed, double second,
+            volatile int& waiting) {
+    for (int i = 0; i < 256; i++) {
+      if ((this->*op)(value))
+        return true;
+      atomic::cpu_relax();
+    }
+
+    const double max_park = 1e-3;
+    const double start = static_cast<double>(pfi::system::time::get_clock_time());
+    __sync_lock_test_and_set(&waiting, 1);
+    for (;;) {
+      if ((this->*op)(value)) {
+        waiting = 0;
+        return true;
+      }
+
+      double rest = max_park;
+      if (timed) {
+        rest = second - (static_cast<double>(pfi::system::time::get_clock_time()) - start);
+        if (rest <= 0) {
+          waiting = 0;
+          return false;
+        }
+        if (rest > max_park)
+          rest = max_park;
+      }
+      futex_wait(&waiting, 1, rest);
+    }
+  }
+
+  const size_t mask;
+  std::vector<T> buf;
+
+  // written by the consumer
+  char pad0[atomic::cache_line_size];
+  volatile size_t head;
+  size_t cached_tail;
+
+  // written by the producer
+  char pad1[atomic::cache_line_size];
+  volatile size_t tail;
+  size_t cached_head;
+
+  // read on every push and pop, written when a side parks
+  char pad2[atomic::cache_line_size];
+  volatile int pop_waiting;
+  volatile int push_waiting;
+  char pad3[atomic::cache_line_size];
+};
+
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_SPSC_RING_H_
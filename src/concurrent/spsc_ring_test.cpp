@@ -0,0 +1,156 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <gtest/gtest.h>
+
+#include "spsc_ring.h"
+
+#include <string>
+#include <vector>
+
+#include "thread.h"
+#include "../system/time_util.h"
+#include "../lang/bind.h"
+#include "../lang/cast.h"
+
+using namespace std;
+using namespace pfi::concurrent;
+using namespace pfi::lang;
+using namespace pfi::system::time;
+
+TEST(spsc_ring, fifo)
+{
+  spsc_ring<string> r(3);
+  EXPECT_EQ(4U, r.capacity());
+  EXPECT_TRUE(r.empty());
+
+  for (int i = 0; i < 4; i++)
+    EXPECT_TRUE(r.try_push(lexical_cast<string>(i)));
+  EXPECT_FALSE(r.try_push("x"));
+  EXPECT_EQ(4U, r.size());
+
+  string v;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(r.try_pop(v));
+      EXPECT_EQ(lexical_cast<string>(i), v);
+      EXPECT_TRUE(r.try_push(lexical_cast<string>(i)));
+    }
+  }
+
+  string out[8];
+  EXPECT_EQ(4U, r.pop_n(out, 8));
+  EXPECT_EQ("3", out[3]);
+  EXPECT_FALSE(r.try_pop(v));
+
+  string in[6] = { "a", "b", "c", "d", "e", "f" };
+  EXPECT_EQ(4U, r.push_n(in, 6));
+  EXPECT_EQ(0U, r.push_n(in + 4, 2));
+  EXPECT_EQ(2U, r.pop_n(out, 2));
+  EXPECT_EQ(2U, r.push_n(in + 4, 2));
+  EXPECT_EQ(4U, r.pop_n(out, 4));
+  EXPECT_EQ("c", out[0]);
+  EXPECT_EQ("f", out[3]);
+  EXPECT_TRUE(r.empty());
+}
+
+TEST(spsc_ring, timeout)
+{
+  spsc_ring<int> r(1);
+  int value;
+  for (int i = -1; i <= 1; i++) {
+    double timeout = 0.001 * i;
+    clock_time start = get_clock_time();
+    ASSERT_FALSE(r.pop(value, timeout));
+    EXPECT_LE(timeout, get_clock_time() - start);
+  }
+
+  r.push(0);
+  for (int i = -1; i <= 1; i++) {
+    double timeout = 0.001 * i;
+    clock_time start = get_clock_time();
+    ASSERT_FALSE(r.push(i, timeout));
+    EXPECT_LE(timeout, get_clock_time() - start);
+  }
+}
+
+namespace {
+
+const int item_num = 200000;
+
+void producer_func(spsc_ring<int>* r)
+{
+  int batch[7];
+  int i = 0;
+  while (i < item_num) {
+    if (i % 3 == 0) {
+      r->push(i++);
+      continue;
+    }
+    int n = 0;
+    for (; n < 7 && i + n < item_num; n++)
+      batch[n] = i + n;
+    size_t pushed = r->push_n(batch, n);
+    if (pushed == 0) {
+      // full
+      r->push(batch[0]);
+      pushed = 1;
+    }
+    i += static_cast<int>(pushed);
+  }
+}
+
+} // namespace
+
+TEST(spsc_ring, normal)
+{
+  spsc_ring<int> r(16);
+  thread producer(bind(producer_func, &r));
+  ASSERT_TRUE(producer.start());
+
+  int expected = 0;
+  int batch[5];
+  while (expected < item_num) {
+    size_t n = 0;
+    if (expected % 2 == 1)
+      n = r.pop_n(batch, 5);
+    if (n == 0) {
+      // empty, or a single pop
+      r.pop(batch[0]);
+      n = 1;
+    }
+    for (size_t i = 0; i < n; i++)
+      ASSERT_EQ(expected++, batch[i]);
+  }
+  ASSERT_TRUE(producer.join());
+  EXPECT_TRUE(r.empty());
+}
@@ -0,0 +1,393 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+#include "lock.h"
+#include "thread.h"
+
+using namespace pfi::lang;
+
+namespace pfi {
+namespace concurrent {
+
+// Chase and Lev's deque, of a fixed size. only the owner pushes and pops
+// at the bottom. thieves take from the top, and race with the owner by CAS
+// only for the last task.
+class thread_pool::work_deque : noncopyable {
+public:
+  work_deque() : top(0), bottom(0) {
+    std::fill(buf, buf + capacity, static_cast<task*>(NULL));
+  }
+
+  // returns false when the deque is full
+  bool push(task* t) {
+    const long b = bottom;
+    if (b - atomic::load_acquire(top) >= capacity)
+      return false;
+    buf[b & (capacity - 1)] = t;
+    atomic::store_release(bottom, b + 1);
+    return true;
+  }
+
+  task* pop() {
+    const long b = bottom - 1;
+    bottom = b;
+    atomic::full_barrier();
+    const long t = top;
+    if (t > b) {
+      bottom = b + 1;
+      return NULL;
+    }
+
+    task* ret = buf[b & (capacity - 1)];
+    if (t == b) {
+      if (!__sync_bool_compare_and_swap(&top, t, t + 1))
+        ret = NULL;
+      bottom = b + 1;
+    }
+    return ret;
+  }
+
+  // sets retry when it lost a race for a task
+  task* steal(bool& retry) {
+    const long t = atomic::load_acquire(top);
+    atomic::full_barrier();
+    const long b = atomic::load_acquire(bottom);
+    if (t >= b)
+      return NULL;
+
+    task* ret = buf[t & (capacity - 1)];
+    if (!__sync_bool_compare_and_swap(&top, t, t + 1)) {
+      retry = true;
+      return NULL;
+    }
+    return ret;
+  }
+
+  bool empty() const {
+    return atomic::load_acquire(bottom) <= atomic::load_acquire(top);
+  }
+
+private:
+  static const long capacity = 1024;
+
+  // thieves and the owner write different cache lines
+  volatile long top;
+  char pad[atomic::cache_line_size];
+  volatile long bottom;
+  task* volatile buf[capacity];
+};
+
+class thread_pool::worker : noncopyable {
+public:
+  worker(thread_pool* pool, unsigned int seed)
+    : pool(pool), seed(seed), th(bind(&thread_pool::worker_loop, pool, this)) {}
+
+  // picks a victim to steal from
+  unsigned int next_random() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+  }
+
+  thread_pool* const pool;
+  work_deque deque;
+  unsigned int seed;
+  thread th;
+};
+
+__thread thread_pool::worker* thread_pool::current = NULL;
+
+thread_pool::thread_pool(int threads)
+  : injected_size(0), sleepers(0), event(0), stopping(0)
+{
+  if (threads <= 0)
+    threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+  if (threads <= 0)
+    threads = 1;
+
+  // workers steal from each other, so all of them are made before any starts
+  for (int i = 0; i < threads; i++)
+    workers.push_back(new worker(this, static_cast<unsigned int>(i) * 7919 + 1));
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (!workers[i]->th.start()) {
+      stop(i);
+      throw std::runtime_error("thread_pool: failed to start threads");
+    }
+  }
+}
+
+thread_pool::~thread_pool()
+{
+  stop(workers.size());
+}
+
+void thread_pool::stop(size_t started)
+{
+  atomic::store_release(stopping, 1);
+  __sync_fetch_and_add(&event, 1);
+  futex_wake(&event, INT_MAX);
+
+  for (size_t i = 0; i < started; i++)
+    workers[i]->th.join();
+  for (size_t i = 0; i < workers.size(); i++)
+    delete workers[i];
+  workers.clear();
+
+  // tasks posted while the workers were stopping
+  for (size_t i = 0; i < injected.size(); i++)
+    delete injected[i];
+  injected.clear();
+}
+
+void thread_pool::post(const function<void()>& f)
+{
+  task* t = new task(f);
+  worker* self = current;
+  if (!self || self->pool != this || !self->deque.push(t)) {
+    synchronized(injected_m) {
+      injected.push_back(t);
+      atomic::store_release(injected_size, static_cast<int>(injected.size()));
+    }
+  }
+  notify();
+}
+
+void thread_pool::parallel_for(size_t begin, size_t end,
+                               const function<void(size_t)>& f,
+                               size_t grain)
+{
+  if (begin >= end)
+    return;
+  if (grain == 0)
+    grain = std::max<size_t>(1, (end - begin) / (workers.size() * 4));
+
+  task_group g(*this);
+  for (size_t b = begin; b < end; ) {
+    const size_t e = end - b > grain ? b + grain : end;
+    g.run(bind(&run_range, f, b, e));
+    b = e;
+  }
+  g.wait();
+}
+
+bool thread_pool::run_one()
+{
+  worker* self = current;
+  task* t = find_task(self && self->pool == this ? self : NULL);
+  if (!t)
+    return false;
+  run_task(t);
+  return true;
+}
+
+void thread_pool::wait_for(volatile int* count)
+{
+  for (;;) {
+    const int c = atomic::load_acquire(*count);
+    if (c == 0)
+      return;
+    if (run_one())
+      continue;
+    // tasks may be posted while this thread sleeps, so it wakes up shortly
+    futex_wait(count, c, 0.001);
+  }
+}
+
+thread_pool& thread_pool::shared()
+{
+  static thread_pool* pool = new thread_pool();
+  return *pool;
+}
+
+thread_pool::task* thread_pool::find_task(worker* self)
+{
+  task* t;
+  if (self && (t = self->deque.pop()))
+    return t;
+
+  if ((t = pop_injected())) {
+    // wakes another worker for the rest, as only one was woken for them
+    if (atomic::load_acquire(injected_size) > 0)
+      notify();
+    return t;
+  }
+
+  const size_t n = workers.size();
+  for (;;) {
+    bool retry = false;
+    const size_t start = self ? self->next_random() : 0;
+    for (size_t i = 0; i < n; i++) {
+      worker* w = workers[(start + i) % n];
+      if (w == self)
+        continue;
+      if ((t = w->deque.steal(retry))) {
+        if (!w->deque.empty())
+          notify();
+        return t;
+      }
+    }
+    if (!retry)
+      return NULL;
+    atomic::cpu_relax();
+  }
+}
+
+thread_pool::task* thread_pool::pop_injected()
+{
+  if (atomic::load_acquire(injected_size) == 0)
+    return NULL;
+
+  scoped_lock lk(injected_m);
+  if (injected.empty())
+    return NULL;
+  task* t = injected.front();
+  injected.pop_front();
+  atomic::store_release(injected_size, static_cast<int>(injected.size()));
+  return t;
+}
+
+void thread_pool::run_task(task* t)
+{
+  try {
+    (*t)();
+  } catch (...) {
+  }
+  delete t;
+}
+
+void thread_pool::run_range(const function<void(size_t)>& f, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; i++)
+    f(i);
+}
+
+void thread_pool::notify()
+{
+  atomic::full_barrier();
+  if (atomic::load_acquire(sleepers) > 0) {
+    __sync_fetch_and_add(&event, 1);
+    futex_wake(&event, 1);
+  }
+}
+
+void thread_pool::worker_loop(worker* self)
+{
+  current = self;
+  for (;;) {
+    task* t = find_task(self);
+    if (t) {
+      run_task(t);
+      continue;
+    }
+
+    const int ev = atomic::load_acquire(event);
+    __sync_fetch_and_add(&sleepers, 1);
+    // a task may have come before this worker was counted as a sleeper
+    t = find_task(self);
+    if (t) {
+      __sync_fetch_and_sub(&sleepers, 1);
+      run_task(t);
+      continue;
+    }
+    if (atomic::load_acquire(stopping)) {
+      __sync_fetch_and_sub(&sleepers, 1);
+      break;
+    }
+    futex_wait(&event, ev);
+    __sync_fetch_and_sub(&sleepers, 1);
+  }
+  current = NULL;
+}
+
+task_group::task_group(thread_pool& pool)
+  : pool(pool), pending(0), failed(false)
+{
+}
+
+task_group::~task_group()
+{
+  pool.wait_for(&pending);
+}
+
+void task_group::run(const function<void()>& f)
+{
+  __sync_fetch_and_add(&pending, 1);
+  pool.post(bind(&task_group::run_task, this, f));
+}
+
+void task_group::wait()
+{
+  pool.wait_for(&pending);
+
+  std::string msg;
+  synchronized(m) {
+    if (!failed)
+      return;
+    failed = false;
+    msg.swap(error);
+  }
+  throw task_error(msg);
+}
+
+void task_group::run_task(const function<void()>& f)
+{
+  std::string msg;
+  bool ok = true;
+  try {
+    f();
+  } catch (const std::exception& e) {
+    ok = false;
+    msg = e.what();
+  } catch (...) {
+    ok = false;
+    msg = "unknown exception";
+  }
+  if (!ok) {
+    synchronized(m) {
+      if (!failed) {
+        failed = true;
+        error = msg;
+      }
+    }
+  }
+
+  // the group may be gone as soon as pending is 0. waking on a stale
+  // address does no harm.
+  if (__sync_sub_and_fetch(&pending, 1) == 0)
+    futex_wake(&pending, INT_MAX);
+}
+
+} // concurrent
+} // pfi
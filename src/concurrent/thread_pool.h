@@ -0,0 +1,306 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_CONCURRENT_THREAD_POOL_H_
+#define INCLUDE_GUARD_PFI_CONCURRENT_THREAD_POOL_H_
+
+#include <cstddef>
+#include <climits>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "atomic.h"
+#include "futex.h"
+#include "mutex.h"
+#include "../lang/bind.h"
+#include "../lang/function.h"
+#include "../lang/noncopyable.h"
+#include "../lang/shared_ptr.h"
+
+namespace pfi {
+namespace concurrent {
+
+class thread_pool;
+
+// thrown by future::get() and task_group::wait() when a task threw.
+// an exception can not be carried over threads in C++03, so only its
+// message is kept.
+class task_error : public std::runtime_error {
+public:
+  explicit task_error(const std::string& msg)
+    : std::runtime_error(msg) {}
+};
+
+namespace detail {
+
+// the state shared by a future and its task. pending turns to 0 when the
+// task finishes.
+class future_state_base : pfi::lang::noncopyable {
+public:
+  future_state_base() : pending(1), failed(false) {}
+
+  void fail(const std::string& msg) {
+    failed = true;
+    error = msg;
+  }
+
+  void finish() {
+    atomic::store_release(pending, 0);
+    futex_wake(&pending, INT_MAX);
+  }
+
+  void check() const {
+    if (failed)
+      throw task_error(error);
+  }
+
+  volatile int pending;
+
+private:
+  bool failed;
+  std::string error;
+};
+
+template <class R>
+class future_state : public future_state_base {
+public:
+  typedef const R& result_type;
+
+  future_state() : value() {}
+
+  void run(const pfi::lang::function<R()>& f) {
+    value = f();
+  }
+
+  result_type get() const {
+    check();
+    return value;
+  }
+
+private:
+  R value;
+};
+
+template <>
+class future_state<void> : public future_state_base {
+public:
+  typedef void result_type;
+
+  void run(const pfi::lang::function<void()>& f) {
+    f();
+  }
+
+  result_type get() const {
+    check();
+  }
+};
+
+template <class R>
+void run_future(const pfi::lang::shared_ptr<future_state<R> >& st,
+                const pfi::lang::function<R()>& f)
+{
+  try {
+    st->run(f);
+  } catch (const std::exception& e) {
+    st->fail(e.what());
+  } catch (...) {
+    st->fail("unknown exception");
+  }
+  st->finish();
+}
+
+} // detail
+
+// the result of thread_pool::submit(). copies share the same result.
+// R must be default constructible and assignable.
+template <class R>
+class future {
+public:
+  future() : pool(NULL) {}
+
+  bool valid() const {
+    return st.get() != NULL;
+  }
+
+  bool ready() const {
+    return atomic::load_acquire(st->pending) == 0;
+  }
+
+  // waits for the task, running other tasks of the pool meanwhile
+  void wait() const;
+
+  // waits for the task and returns its result. it throws task_error when
+  // the task threw.
+  typename detail::future_state<R>::result_type get() const {
+    wait();
+    return st->get();
+  }
+
+private:
+  friend class thread_pool;
+
+  future(thread_pool* pool,
+         const pfi::lang::shared_ptr<detail::future_state<R> >& st)
+    : pool(pool), st(st) {}
+
+  thread_pool* pool;
+  pfi::lang::shared_ptr<detail::future_state<R> > st;
+};
+
+// a pool of worker threads which run short tasks. each worker has its own
+// deque (Chase and Lev's work stealing deque): it pushes and pops tasks at
+// the bottom without locks, and idle workers steal the oldest tasks from
+// the top of others. tasks posted from other threads go to a shared queue.
+// idle workers park on a futex.
+//
+// threads which wait for tasks (future::wait(), task_group::wait() and
+// parallel_for()) run queued tasks meanwhile, so that tasks can wait for
+// other tasks without using up the workers. a task should not block on
+// anything else for long.
+class thread_pool : pfi::lang::noncopyable {
+public:
+  // threads == 0 means the number of online processors
+  explicit thread_pool(int threads = 0);
+
+  // runs the queued tasks, and then stops the workers
+  ~thread_pool();
+
+  int size() const {
+    return static_cast<int>(workers.size());
+  }
+
+  // queues f. an exception from f is ignored; use submit() or task_group
+  // to see it.
+  void post(const pfi::lang::function<void()>& f);
+
+  template <class R>
+  future<R> submit(const pfi::lang::function<R()>& f) {
+    pfi::lang::shared_ptr<detail::future_state<R> > st(new detail::future_state<R>());
+    post(pfi::lang::bind(&detail::run_future<R>, st, f));
+    return future<R>(this, st);
+  }
+
+  template <class R>
+  future<R> submit(R (*f)()) {
+    return submit(pfi::lang::function<R()>(f));
+  }
+
+  template <class F>
+  future<typename F::result_type> submit(const F& f) {
+    return submit(pfi::lang::function<typename F::result_type()>(f));
+  }
+
+  // runs f(i) for each i in [begin, end) on the pool, grain indices per
+  // task, and waits for them. grain == 0 makes about four tasks per worker.
+  // it throws task_error when f threw.
+  void parallel_for(size_t begin, size_t end,
+                    const pfi::lang::function<void(size_t)>& f,
+                    size_t grain = 0);
+
+  // runs a queued task in the calling thread. it returns false when there
+  // is nothing to run.
+  bool run_one();
+
+  // waits until *count turns to 0, running queued tasks meanwhile
+  void wait_for(volatile int* count);
+
+  // a pool with a worker per processor, for the library and applications
+  // to share instead of starting threads of their own. it is never
+  // destroyed.
+  static thread_pool& shared();
+
+private:
+  typedef pfi::lang::function<void()> task;
+
+  class work_deque;
+  class worker;
+
+  // the worker running on this thread, if any
+  static __thread worker* current;
+
+  void stop(size_t started);
+  task* find_task(worker* self);
+  task* pop_injected();
+  void run_task(task* t);
+  static void run_range(const pfi::lang::function<void(size_t)>& f,
+                        size_t begin, size_t end);
+  void notify();
+  void worker_loop(worker* self);
+
+  std::vector<worker*> workers;
+
+  // tasks from threads out of the pool, and overflows of the deques
+  mutex injected_m;
+  std::deque<task*> injected;
+  volatile int injected_size;
+
+  // parking of idle workers
+  volatile int sleepers;
+  volatile int event;
+  volatile int stopping;
+};
+
+template <class R>
+void future<R>::wait() const
+{
+  pool->wait_for(&st->pending);
+}
+
+// a set of tasks which are waited for together
+class task_group : pfi::lang::noncopyable {
+public:
+  explicit task_group(thread_pool& pool = thread_pool::shared());
+
+  // waits for the tasks, ignoring their errors
+  ~task_group();
+
+  void run(const pfi::lang::function<void()>& f);
+
+  // waits for the tasks run so far, running queued tasks meanwhile. it
+  // throws task_error for the first task which threw.
+  void wait();
+
+private:
+  void run_task(const pfi::lang::function<void()>& f);
+
+  thread_pool& pool;
+  volatile int pending;
+
+  mutex m;
+  bool failed;
+  std::string error;
+};
+
+} // concurrent
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_CONCURRENT_THREAD_POOL_H_
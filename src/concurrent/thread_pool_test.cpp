@@ -0,0 +1,176 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+
+#include "../lang/bind.h"
+#include "../lang/cast.h"
+
+using namespace std;
+using namespace pfi::concurrent;
+using namespace pfi::lang;
+
+namespace {
+
+int square(int x)
+{
+  return x * x;
+}
+
+string answer()
+{
+  return "42";
+}
+
+void add(volatile int* sum, int x)
+{
+  __sync_fetch_and_add(sum, x);
+}
+
+int fail()
+{
+  throw std::runtime_error("failed");
+}
+
+void mark(vector<int>* marks, size_t i)
+{
+  (*marks)[i]++;
+}
+
+void fib(thread_pool* pool, int n, long* res)
+{
+  if (n < 2) {
+    *res = n;
+    return;
+  }
+  // waits in the workers, which run the subtasks meanwhile
+  long a, b;
+  task_group g(*pool);
+  g.run(bind(&fib, pool, n - 1, &a));
+  g.run(bind(&fib, pool, n - 2, &b));
+  g.wait();
+  *res = a + b;
+}
+
+} // namespace
+
+TEST(thread_pool, submit)
+{
+  thread_pool pool(2);
+  EXPECT_EQ(2, pool.size());
+
+  vector<future<int> > fs;
+  for (int i = 0; i < 100; i++)
+    fs.push_back(pool.submit(bind(&square, i)));
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(i * i, fs[i].get());
+
+  future<string> s = pool.submit(&answer);
+  EXPECT_EQ("42", s.get());
+  EXPECT_TRUE(s.ready());
+
+  volatile int sum = 0;
+  future<void> v = pool.submit(bind(&add, &sum, 3));
+  v.get();
+  EXPECT_EQ(3, sum);
+}
+
+TEST(thread_pool, submit_error)
+{
+  thread_pool pool(2);
+  future<int> f = pool.submit(&fail);
+  EXPECT_THROW(f.get(), task_error);
+  try {
+    f.get();
+  } catch (const task_error& e) {
+    EXPECT_EQ(string("failed"), e.what());
+  }
+}
+
+TEST(thread_pool, parallel_for)
+{
+  thread_pool pool(4);
+  for (size_t grain = 0; grain < 5; grain++) {
+    vector<int> marks(10007);
+    pool.parallel_for(0, marks.size(), bind(&mark, &marks, _1), grain);
+    for (size_t i = 0; i < marks.size(); i++)
+      ASSERT_EQ(1, marks[i]) << i;
+  }
+
+  vector<int> marks(10);
+  pool.parallel_for(5, 5, bind(&mark, &marks, _1));
+  pool.parallel_for(3, 7, bind(&mark, &marks, _1));
+  for (size_t i = 0; i < marks.size(); i++)
+    EXPECT_EQ(3 <= i && i < 7 ? 1 : 0, marks[i]) << i;
+}
+
+TEST(thread_pool, task_group)
+{
+  thread_pool pool(3);
+  long res = 0;
+  fib(&pool, 20, &res);
+  EXPECT_EQ(6765, res);
+
+  // from a task, with more waiting tasks than workers
+  future<void> f = pool.submit(bind(&fib, &pool, 18, &res));
+  f.get();
+  EXPECT_EQ(2584, res);
+
+  task_group g(pool);
+  g.run(bind(&fail));
+  g.run(bind(&fail));
+  EXPECT_THROW(g.wait(), task_error);
+  EXPECT_NO_THROW(g.wait());
+}
+
+TEST(thread_pool, drain)
+{
+  volatile int sum = 0;
+  {
+    thread_pool pool(2);
+    for (int i = 0; i < 10000; i++)
+      pool.post(bind(&add, &sum, 1));
+  }
+  EXPECT_EQ(10000, sum);
+}
+
+TEST(thread_pool, shared)
+{
+  thread_pool& pool = thread_pool::shared();
+  EXPECT_EQ(&pool, &thread_pool::shared());
+  EXPECT_LE(1, pool.size());
+  EXPECT_EQ(49, pool.submit(bind(&square, 7)).get());
+}
@@ -0,0 +1,158 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_FROZEN_STRING_MAP_H_
+#define INCLUDE_GUARD_PFI_DATA_FROZEN_STRING_MAP_H_
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace pfi{
+namespace data{
+
+// Immutable string-keyed map for read-mostly tables such as dispatch tables.
+// build() searches a hash seed for which all the keys fall into distinct
+// slots, so that a lookup is one hash and one string comparison.
+// Keys must be unique. Lookups are thread safe.
+
+template <class T>
+class frozen_string_map{
+public:
+  frozen_string_map()
+    : seed(0)
+    , mask(0){
+  }
+
+  /**
+     @brief build the table from a range of pair<string, T>
+   */
+  template <class InputIterator>
+  void build(InputIterator begin, InputIterator end){
+    entries.assign(begin, end);
+
+    size_t cap=1;
+    while(cap<entries.size()*2) cap<<=1;
+
+    for (;;){
+      for (int t=0; t<kSeedTrials; t++){
+        if (place(cap, t)) return;
+      }
+      // a sparse table with few keys always has a perfect seed;
+      // give up perfectness and probe linearly beyond this size
+      if (cap>=entries.size()*kMaxSparseness){
+        place(cap, 0);
+        return;
+      }
+      cap<<=1;
+    }
+  }
+
+  /**
+     @return the value of key, or NULL if key is not found
+   */
+  const T *find(const char *key, size_t len) const{
+    if (slots.empty()) return NULL;
+    for (uint32_t i=hash(key, len, seed)&mask; ; i=(i+1)&mask){
+      int e=slots[i];
+      if (e<0) return NULL;
+      const std::string &k=entries[e].first;
+      if (k.size()==len && std::memcmp(k.data(), key, len)==0)
+        return &entries[e].second;
+    }
+  }
+
+  const T *find(const std::string &key) const{
+    return find(key.data(), key.size());
+  }
+
+  size_t size() const{
+    return entries.size();
+  }
+
+  bool empty() const{
+    return entries.empty();
+  }
+
+  void clear(){
+    entries.clear();
+    slots.clear();
+    seed=0;
+    mask=0;
+  }
+
+  static uint32_t hash(const char *p, size_t len, uint32_t seed){
+    // FNV-1a with a seeded offset basis and a final avalanche
+    uint32_t h=2166136261u^(seed*0x9e3779b9u);
+    for (size_t i=0; i<len; i++){
+      h^=(unsigned char)p[i];
+      h*=16777619u;
+    }
+    h^=h>>16;
+    h*=0x85ebca6bu;
+    h^=h>>13;
+    return h;
+  }
+
+private:
+  static const int kSeedTrials=64;
+  static const size_t kMaxSparseness=16;
+
+  // returns true when no two keys share a slot
+  bool place(size_t cap, uint32_t s){
+    slots.assign(cap, -1);
+    seed=s;
+    mask=cap-1;
+
+    bool perfect=true;
+    for (size_t e=0; e<entries.size(); e++){
+      const std::string &k=entries[e].first;
+      uint32_t i=hash(k.data(), k.size(), seed)&mask;
+      while(slots[i]>=0){
+        perfect=false;
+        i=(i+1)&mask;
+      }
+      slots[i]=e;
+    }
+    return perfect;
+  }
+
+  std::vector<std::pair<std::string, T> > entries;
+  std::vector<int> slots;
+  uint32_t seed;
+  uint32_t mask;
+};
+
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_FROZEN_STRING_MAP_H_
@@ -0,0 +1,79 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "./frozen_string_map.h"
+
+#include <map>
+#include <string>
+
+#include "../lang/cast.h"
+
+using namespace std;
+using namespace pfi::data;
+
+TEST(frozen_string_map_test, empty) {
+  frozen_string_map<int> m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.find("foo") == NULL);
+
+  map<string, int> src;
+  m.build(src.begin(), src.end());
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.find("") == NULL);
+}
+
+TEST(frozen_string_map_test, find) {
+  map<string, int> src;
+  for (int i=0;i<1000;++i)
+    src["key"+pfi::lang::lexical_cast<string>(i)]=i;
+  src[""]=-1;
+
+  frozen_string_map<int> m;
+  m.build(src.begin(), src.end());
+  EXPECT_EQ(src.size(), m.size());
+
+  for (map<string, int>::iterator it=src.begin(); it!=src.end(); ++it){
+    const int *v=m.find(it->first);
+    ASSERT_TRUE(v != NULL);
+    EXPECT_EQ(it->second, *v);
+  }
+
+  EXPECT_TRUE(m.find("key1000") == NULL);
+  EXPECT_TRUE(m.find("key") == NULL);
+  EXPECT_TRUE(m.find("key10", 4) != NULL);
+  EXPECT_EQ(1, *m.find("key10", 4));
+
+  m.clear();
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.find("key1") == NULL);
+}
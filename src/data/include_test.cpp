@@ -12,6 +12,7 @@
 #include "suffix_array/rmq.h"
 #include "suffix_array/invsa.h"
 #include "intern.h"
+#include "frozen_string_map.h"
 #include "functional_hash.h"
 #include "encoding/base64.h"
 #include "serialization.h"
@@ -30,8 +31,12 @@
 #include "serialization/list.h"
 #include "serialization/unordered_set.h"
 #include "serialization/base.h"
+#include "serialization/chunked.h"
+#include "serialization/compact.h"
+#include "serialization/compiled.h"
 #include "serialization/pair.h"
 #include "serialization/reflect.h"
+#include "serialization/view.h"
 #include "digest/md5.h"
 #include "unordered_set.h"
 #include "lru.h"
@@ -32,8 +32,11 @@
 #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BASE_H_
 #define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_BASE_H_
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 #include "../../lang/safe_bool.h"
 #include "../../system/endian_util.h"
@@ -42,12 +45,22 @@ namespace pfi {
 namespace data {
 namespace serialization {
 
+template <class F, F>
+struct member_check {};
+
 class access {
 public:
   template<class Archive, class T>
   static void serialize(Archive& ar, T& v) {
     v.serialize(ar);
   }
+
+  // returns char when T has a member template serialize() for Archive.
+  // it is checked here, as the classes make access a friend.
+  template <class Archive, class T>
+  static char check_serialize(member_check<void (T::*)(Archive&), &T::template serialize<Archive> >*);
+  template <class Archive, class T>
+  static long check_serialize(...);
 };
 
 template <class Archive, class T>
@@ -95,6 +108,11 @@ public:
     return is;
   }
 
+  // marks the input broken, e.g. when a serializer finds it corrupt
+  void fail() {
+    is.setstate(std::ios::failbit);
+  }
+
 private:
   std::istream& is;
 };
@@ -113,8 +131,10 @@ binary_iarchive& operator>>(binary_iarchive& ar, const T& v)
   return ar;
 }
 
-#define gen_serial_binary_iarchive(tt) \
-  inline void serialize(binary_iarchive& ar, tt& n) \
+#define gen_serial_binary_iarchive(tt) gen_serial_iarchive(binary_iarchive, tt)
+
+#define gen_serial_iarchive(archive, tt) \
+  inline void serialize(archive& ar, tt& n) \
   { \
     tt tmp; \
     ar.read<sizeof(tmp)>(reinterpret_cast<char*>(&tmp)); \
@@ -187,8 +207,10 @@ binary_oarchive& operator<<(binary_oarchive& ar, const T& v)
   return ar;
 }
 
-#define gen_serial_binary_oarchive(tt) \
-    inline void serialize(binary_oarchive& ar, tt n) \
+#define gen_serial_binary_oarchive(tt) gen_serial_oarchive(binary_oarchive, tt)
+
+#define gen_serial_oarchive(archive, tt) \
+    inline void serialize(archive& ar, tt n) \
   { \
     n = pfi::system::endian::to_little(n); \
     ar.write<sizeof(n)>(reinterpret_cast<const char*>(&n)); \
@@ -212,6 +234,263 @@ gen_serial_binary_oarchive(long double);
 
 #undef gen_serial_binary_oarchive
 
+// archives over contiguous memory with the same format as
+// binary_iarchive/binary_oarchive
+
+class memory_iarchive : public pfi::lang::safe_bool<memory_iarchive> {
+  memory_iarchive(const memory_iarchive&);
+  memory_iarchive& operator=(const memory_iarchive&);
+
+public:
+  memory_iarchive(const char* p, size_t size)
+    : cur(p), end(p + size), ok(true)
+  {}
+
+  static const bool is_read = true;
+
+  template <int N>
+  memory_iarchive& read(char* p) {
+    return read(p, N);
+  }
+
+  memory_iarchive& read(char* p, size_t size) {
+    if (!ok || static_cast<size_t>(end - cur) < size) {
+      ok = false;
+      cur = end;
+      return *this;
+    }
+    std::memcpy(p, cur, size);
+    cur += size;
+    return *this;
+  }
+
+  // skips size bytes, e.g. bytes referred to by a view (see view.h)
+  memory_iarchive& skip(size_t size) {
+    if (!ok || static_cast<size_t>(end - cur) < size) {
+      ok = false;
+      cur = end;
+      return *this;
+    }
+    cur += size;
+    return *this;
+  }
+
+  // the position of the next byte to read
+  const char* pos() const {
+    return cur;
+  }
+
+  size_t remaining() const {
+    return end - cur;
+  }
+
+  bool bool_test() const {
+    return ok;
+  }
+
+  // marks the input broken, e.g. when a serializer finds it corrupt
+  void fail() {
+    ok = false;
+    cur = end;
+  }
+
+private:
+  const char* cur;
+  const char* end;
+  bool ok;
+};
+
+template <class T>
+memory_iarchive& operator>>(memory_iarchive& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+memory_iarchive& operator>>(memory_iarchive& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+// appends to a buffer
+class memory_oarchive : public pfi::lang::safe_bool<memory_oarchive> {
+  memory_oarchive(const memory_oarchive&);
+  memory_oarchive& operator=(const memory_oarchive&);
+
+public:
+  memory_oarchive(std::vector<char>& buf)
+    : buf(buf)
+  {}
+
+  static const bool is_read = false;
+
+  template <int N>
+  memory_oarchive& write(const char* p) {
+    return write(p, N);
+  }
+
+  memory_oarchive& write(const char* p, size_t size) {
+    size_t n = buf.size();
+    buf.resize(n + size);
+    std::memcpy(&buf[0] + n, p, size);
+    return *this;
+  }
+
+  void flush() {
+  }
+
+  bool bool_test() const {
+    return true;
+  }
+
+private:
+  std::vector<char>& buf;
+};
+
+template <class T>
+memory_oarchive& operator<<(memory_oarchive& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+memory_oarchive& operator<<(memory_oarchive& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+#define gen_serial_memory_archive(tt) \
+  gen_serial_iarchive(memory_iarchive, tt); \
+  gen_serial_oarchive(memory_oarchive, tt)
+
+gen_serial_memory_archive(bool);
+gen_serial_memory_archive(char);
+gen_serial_memory_archive(signed char);
+gen_serial_memory_archive(unsigned char);
+gen_serial_memory_archive(short);
+gen_serial_memory_archive(unsigned short);
+gen_serial_memory_archive(int);
+gen_serial_memory_archive(unsigned int);
+gen_serial_memory_archive(long);
+gen_serial_memory_archive(unsigned long);
+gen_serial_memory_archive(long long);
+gen_serial_memory_archive(unsigned long long);
+gen_serial_memory_archive(float);
+gen_serial_memory_archive(double);
+gen_serial_memory_archive(long double);
+
+#undef gen_serial_memory_archive
+#undef gen_serial_iarchive
+#undef gen_serial_oarchive
+
+// Sequences of arithmetic values are stored as the little-endian memory
+// images of the values, so on little-endian hosts the archives above copy
+// a whole contiguous sequence at once instead of value by value.
+
+template <class Archive>
+struct is_binary_archive { static const bool value = false; };
+
+template <> struct is_binary_archive<binary_iarchive> { static const bool value = true; };
+template <> struct is_binary_archive<binary_oarchive> { static const bool value = true; };
+template <> struct is_binary_archive<memory_iarchive> { static const bool value = true; };
+template <> struct is_binary_archive<memory_oarchive> { static const bool value = true; };
+
+// bool and long double are excluded: not every byte pattern is a valid
+// bool, and long double has padding bytes
+template <class T>
+struct is_bulk_copyable { static const bool value = false; };
+
+#define gen_bulk_copyable(tt) \
+  template <> struct is_bulk_copyable<tt> { static const bool value = true; }
+
+gen_bulk_copyable(char);
+gen_bulk_copyable(signed char);
+gen_bulk_copyable(unsigned char);
+gen_bulk_copyable(short);
+gen_bulk_copyable(unsigned short);
+gen_bulk_copyable(int);
+gen_bulk_copyable(unsigned int);
+gen_bulk_copyable(long);
+gen_bulk_copyable(unsigned long);
+gen_bulk_copyable(long long);
+gen_bulk_copyable(unsigned long long);
+gen_bulk_copyable(float);
+gen_bulk_copyable(double);
+
+#undef gen_bulk_copyable
+
+// whether a contiguous sequence of T is stored as its memory image in Archive.
+// other archives with such a format specialize this and overload
+// copy_bytes(Archive&, char*, size_t) in this namespace.
+template <class Archive, class T>
+struct is_raw_sequence {
+  static const bool value =
+    is_binary_archive<Archive>::value && is_bulk_copyable<T>::value;
+};
+
+namespace detail {
+
+// binary_iarchive/binary_oarchive take int sizes
+static const size_t max_bulk_chunk = 1 << 30;
+
+inline void copy_bytes(binary_iarchive& ar, char* p, size_t size)
+{
+  for (size_t i = 0; i < size && ar; i += max_bulk_chunk)
+    ar.read(p + i, static_cast<int>(std::min(size - i, max_bulk_chunk)));
+}
+
+inline void copy_bytes(binary_oarchive& ar, const char* p, size_t size)
+{
+  for (size_t i = 0; i < size && ar; i += max_bulk_chunk)
+    ar.write(p + i, static_cast<int>(std::min(size - i, max_bulk_chunk)));
+}
+
+inline void copy_bytes(memory_iarchive& ar, char* p, size_t size)
+{
+  ar.read(p, size);
+}
+
+inline void copy_bytes(memory_oarchive& ar, const char* p, size_t size)
+{
+  ar.write(p, size);
+}
+
+template <bool Bulk>
+struct sequence_serializer {
+  template <class Archive, class Seq>
+  static void serialize(Archive& ar, Seq& s, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      ar & s[i];
+  }
+};
+
+template <>
+struct sequence_serializer<true> {
+  template <class Archive, class Seq>
+  static void serialize(Archive& ar, Seq& s, size_t n) {
+    if (n == 0)
+      return;
+    if (!pfi::system::endian::is_little()) {
+      sequence_serializer<false>::serialize(ar, s, n);
+      return;
+    }
+    copy_bytes(ar, reinterpret_cast<char*>(&s[0]), n * sizeof(s[0]));
+  }
+};
+
+} // detail
+
+// serializes s[0], ..., s[n-1] of a contiguous sequence of T
+template <class T, class Archive, class Seq>
+void serialize_sequence(Archive& ar, Seq& s, size_t n)
+{
+  detail::sequence_serializer<is_raw_sequence<Archive, T>::value>::serialize(ar, s, n);
+}
+
 } // serialization
 } // data
 } // pfi
@@ -0,0 +1,307 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_CHUNKED_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_CHUNKED_H_
+
+#include "base.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "pair.h"
+#include "../unordered_map.h"
+#include "../unordered_set.h"
+#include "../../lang/bind.h"
+#include "../../concurrent/thread_pool.h"
+
+namespace pfi{
+namespace data{
+namespace serialization{
+
+// chunked(c) serializes a large container in a format split into chunks
+// which are encoded and decoded in parallel on thread_pool::shared():
+//
+//   ar & chunked(m);
+//
+// the container is written as the number of chunks, an index of the number
+// of elements and the byte length of each chunk, and the chunks encoded in
+// the binary format. decoded elements are inserted by the calling thread.
+// a chunk which fails to decode leaves the container empty and fails the
+// archive.
+// linking pficommon_concurrent is needed.
+
+template <class C>
+class chunked_container {
+public:
+  chunked_container(C& c, int threads, size_t chunk_size)
+    : c(c), threads(threads), chunk_size(chunk_size) {}
+
+  C& container() const { return c; }
+  int num_threads() const { return threads; }
+  size_t elements_per_chunk() const { return chunk_size; }
+
+private:
+  C& c;
+  int threads;
+  size_t chunk_size;
+};
+
+// up to threads chunks are coded at once. threads = 0 means the size of
+// the pool.
+template <class C>
+chunked_container<C> chunked(C& c, int threads = 0, size_t chunk_size = 1 << 16)
+{
+  return chunked_container<C>(c, threads, chunk_size);
+}
+
+namespace detail {
+
+// runs f(0), ..., f(n-1) on the shared pool, in up to threads tasks
+inline void parallel_for(size_t n, const pfi::lang::function<void(size_t)>& f,
+                         int threads)
+{
+  pfi::concurrent::thread_pool& pool = pfi::concurrent::thread_pool::shared();
+  if (threads <= 0)
+    threads = pool.size();
+  const size_t tasks = std::max<size_t>(threads, 1);
+  pool.parallel_for(0, n, f, (n + tasks - 1) / tasks);
+}
+
+// elements of maps are decoded as non-const pairs
+template <class T>
+struct chunk_value { typedef T type; };
+
+template <class K, class V>
+struct chunk_value<std::pair<const K, V> > { typedef std::pair<K, V> type; };
+
+template <class C>
+void reserve_for(C&, size_t) {}
+
+template <class K, class V, class H, class P, class A>
+void reserve_for(unordered_map<K, V, H, P, A>& m, size_t n) { m.reserve(n); }
+
+template <class K, class H, class P, class A>
+void reserve_for(unordered_set<K, H, P, A>& s, size_t n) { s.reserve(n); }
+
+template <class C>
+class chunk_encoder {
+public:
+  typedef typename C::iterator iterator;
+  typedef typename chunk_value<typename C::value_type>::type value_type;
+
+  chunk_encoder(const std::vector<iterator>& bounds,
+                std::vector<std::vector<char> >& bufs)
+    : bounds(bounds), bufs(bufs) {}
+
+  void encode(size_t i) {
+    memory_oarchive oa(bufs[i]);
+    for (iterator it = bounds[i]; it != bounds[i + 1]; ++it) {
+      value_type v(*it);
+      oa & v;
+    }
+  }
+
+private:
+  const std::vector<iterator>& bounds;
+  std::vector<std::vector<char> >& bufs;
+};
+
+template <class C>
+class chunk_decoder {
+public:
+  typedef typename chunk_value<typename C::value_type>::type value_type;
+
+  chunk_decoder(const std::vector<std::pair<const char*, uint64_t> >& payloads,
+                const std::vector<uint32_t>& counts,
+                std::vector<std::vector<value_type> >& values)
+    : payloads(payloads), counts(counts), values(values), failed(false) {}
+
+  void decode(size_t i) {
+    memory_iarchive ia(payloads[i].first, payloads[i].second);
+    std::vector<value_type>& vs = values[i];
+    // the count comes from the input and is not trusted for the reservation
+    vs.reserve(static_cast<size_t>(std::min<uint64_t>(counts[i], payloads[i].second)));
+    for (uint32_t j = 0; j < counts[i] && ia && !failed; j++) {
+      vs.push_back(value_type());
+      ia & vs.back();
+    }
+    if (!ia || ia.remaining() != 0)
+      failed = true;
+  }
+
+  bool fail() const { return failed; }
+
+private:
+  const std::vector<std::pair<const char*, uint64_t> >& payloads;
+  const std::vector<uint32_t>& counts;
+  std::vector<std::vector<value_type> >& values;
+  volatile bool failed;
+};
+
+// fails ar when it cannot hold size more bytes, before they are allocated
+template <class Archive>
+void check_chunks(Archive&, uint64_t) {}
+
+inline void check_chunks(memory_iarchive& ar, uint64_t size)
+{
+  if (size > ar.remaining())
+    ar.fail();
+}
+
+static const size_t read_chunk_step = 1 << 20;
+
+// returns size bytes read from ar, which are in buf or in the input of ar.
+// buf grows as the bytes are read, so that a corrupt size fails at the end
+// of the input rather than allocating it at once.
+template <class Archive>
+const char* read_chunk(Archive& ar, uint64_t size, std::vector<char>& buf)
+{
+  buf.clear();
+  for (uint64_t done = 0; done < size && ar; ) {
+    size_t n = static_cast<size_t>(std::min<uint64_t>(size - done, read_chunk_step));
+    buf.resize(static_cast<size_t>(done) + n);
+    copy_bytes(ar, &buf[static_cast<size_t>(done)], n);
+    done += n;
+  }
+  return buf.empty() ? NULL : &buf[0];
+}
+
+inline const char* read_chunk(memory_iarchive& ar, uint64_t size, std::vector<char>&)
+{
+  const char* p = ar.pos();
+  check_chunks(ar, size);
+  if (ar)
+    ar.skip(static_cast<size_t>(size));
+  return p;
+}
+
+template <bool IsRead>
+struct chunked_serializer {
+  template <class Archive, class C>
+  static void serialize(Archive& ar, const chunked_container<C>& cc) {
+    C& c = cc.container();
+    size_t chunk_size = std::max<size_t>(cc.elements_per_chunk(), 1);
+
+    std::vector<typename C::iterator> bounds;
+    size_t n = 0;
+    for (typename C::iterator it = c.begin(); it != c.end(); ++it, ++n)
+      if (n % chunk_size == 0)
+        bounds.push_back(it);
+    bounds.push_back(c.end());
+
+    uint32_t chunks = static_cast<uint32_t>(bounds.size() - 1);
+    std::vector<std::vector<char> > bufs(chunks);
+    chunk_encoder<C> enc(bounds, bufs);
+    parallel_for(chunks, pfi::lang::bind(&chunk_encoder<C>::encode, &enc, pfi::lang::_1),
+                 cc.num_threads());
+
+    ar & chunks;
+    for (uint32_t i = 0; i < chunks; i++) {
+      uint32_t count = static_cast<uint32_t>(std::min(chunk_size, n - i * chunk_size));
+      uint64_t bytes = bufs[i].size();
+      ar & count & bytes;
+    }
+    for (uint32_t i = 0; i < chunks; i++) {
+      if (!bufs[i].empty())
+        copy_bytes(ar, &bufs[i][0], bufs[i].size());
+      std::vector<char>().swap(bufs[i]);
+    }
+  }
+};
+
+template <>
+struct chunked_serializer<true> {
+  template <class Archive, class C>
+  static void serialize(Archive& ar, const chunked_container<C>& cc) {
+    typedef typename chunk_decoder<C>::value_type value_type;
+    C& c = cc.container();
+    c.clear();
+
+    uint32_t chunks = 0;
+    ar & chunks;
+    std::vector<uint32_t> counts;
+    std::vector<uint64_t> bytes;
+    size_t total = 0;
+    uint64_t payload = 0;
+    for (uint32_t i = 0; i < chunks && ar; i++) {
+      uint32_t count = 0;
+      uint64_t len = 0;
+      ar & count & len;
+      counts.push_back(count);
+      bytes.push_back(len);
+      total += count;
+      payload = len > ~payload ? ~uint64_t(0) : payload + len;
+    }
+    if (ar)
+      check_chunks(ar, payload);
+    if (!ar)
+      return;
+
+    std::vector<std::vector<char> > bufs(chunks);
+    std::vector<std::pair<const char*, uint64_t> > payloads(chunks);
+    for (uint32_t i = 0; i < chunks && ar; i++)
+      payloads[i] = std::make_pair(read_chunk(ar, bytes[i], bufs[i]), bytes[i]);
+    if (!ar)
+      return;
+
+    std::vector<std::vector<value_type> > values(chunks);
+    chunk_decoder<C> dec(payloads, counts, values);
+    parallel_for(chunks, pfi::lang::bind(&chunk_decoder<C>::decode, &dec, pfi::lang::_1),
+                 cc.num_threads());
+    if (dec.fail()) {
+      ar.fail();
+      return;
+    }
+
+    reserve_for(c, total);
+    for (uint32_t i = 0; i < chunks; i++) {
+      std::vector<char>().swap(bufs[i]);
+      for (size_t j = 0; j < values[i].size(); j++)
+        c.insert(c.end(), values[i][j]);
+      std::vector<value_type>().swap(values[i]);
+    }
+  }
+};
+
+} // detail
+
+template <class Archive, class C>
+void serialize(Archive& ar, const chunked_container<C>& cc)
+{
+  detail::chunked_serializer<Archive::is_read>::serialize(ar, cc);
+}
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_CHUNKED_H_
@@ -0,0 +1,428 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPACT_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPACT_H_
+
+#include "base.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+#include "vector.h"
+
+namespace pfi{
+namespace data{
+namespace serialization{
+
+// Archives with a compact format: integer types (and so container sizes)
+// are LEB128 varints, signed ones zigzag-encoded, so small values take one
+// byte. bool, char types and floating point values are stored as in
+// binary_oarchive. The format is not compatible with binary_oarchive.
+
+class compact_iarchive : public pfi::lang::safe_bool<compact_iarchive> {
+  compact_iarchive(const compact_iarchive&);
+  compact_iarchive& operator=(const compact_iarchive&);
+
+public:
+  compact_iarchive(std::istream& is)
+    : is(&is), sb(is.rdbuf()), cur(NULL), end(NULL), ok(true)
+  {}
+
+  // reading from memory is faster, especially for vectors of integers
+  compact_iarchive(const char* p, size_t size)
+    : is(NULL), sb(NULL), cur(p), end(p + size), ok(true)
+  {}
+
+  static const bool is_read = true;
+
+  template <int N>
+  compact_iarchive& read(char* p) {
+    return read(p, N);
+  }
+
+  compact_iarchive& read(char* p, size_t size) {
+    if (!ok)
+      return *this;
+    if (sb) {
+      if (static_cast<size_t>(sb->sgetn(p, size)) != size)
+        fail();
+    } else if (static_cast<size_t>(end - cur) < size) {
+      fail();
+    } else {
+      std::memcpy(p, cur, size);
+      cur += size;
+    }
+    return *this;
+  }
+
+  bool read_varint(uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      int c = get();
+      if (c < 0)
+        return false;
+      v |= static_cast<uint64_t>(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return true;
+    }
+    fail();
+    return false;
+  }
+
+  // decodes n varints into p
+  template <class T>
+  void read_varints(T* p, size_t n);
+
+  bool bool_test() const {
+    return ok;
+  }
+
+  // marks the input broken, e.g. when a serializer finds it corrupt
+  void fail() {
+    ok = false;
+    if (is)
+      is->setstate(std::ios::failbit);
+    cur = end;
+  }
+
+private:
+  int get() {
+    if (!ok)
+      return -1;
+    if (sb) {
+      int c = sb->sbumpc();
+      if (c == std::char_traits<char>::eof()) {
+        fail();
+        return -1;
+      }
+      return static_cast<unsigned char>(c);
+    }
+    if (cur == end) {
+      fail();
+      return -1;
+    }
+    return static_cast<unsigned char>(*cur++);
+  }
+
+  std::istream* is;
+  std::streambuf* sb;
+  const char* cur;
+  const char* end;
+  bool ok;
+};
+
+class compact_oarchive : public pfi::lang::safe_bool<compact_oarchive> {
+  compact_oarchive(const compact_oarchive&);
+  compact_oarchive& operator=(const compact_oarchive&);
+
+public:
+  compact_oarchive(std::ostream& os)
+    : os(os)
+  {}
+
+  static const bool is_read = false;
+
+  template <int N>
+  compact_oarchive& write(const char* p) {
+    return write(p, N);
+  }
+
+  compact_oarchive& write(const char* p, size_t size) {
+    os.write(p, size);
+    return *this;
+  }
+
+  void write_varint(uint64_t v) {
+    char buf[max_varint_size];
+    os.write(buf, encode_varint(buf, v));
+  }
+
+  // encodes n values at p as varints
+  template <class T>
+  void write_varints(const T* p, size_t n);
+
+  void flush() {
+    os.flush();
+  }
+
+  bool bool_test() const {
+    return os;
+  }
+
+  static const int max_varint_size = 10;
+
+  static int encode_varint(char* p, uint64_t v) {
+    int n = 0;
+    while (v >= 0x80) {
+      p[n++] = static_cast<char>(v | 0x80);
+      v >>= 7;
+    }
+    p[n++] = static_cast<char>(v);
+    return n;
+  }
+
+private:
+  std::ostream& os;
+};
+
+template <class T>
+compact_iarchive& operator>>(compact_iarchive& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+compact_iarchive& operator>>(compact_iarchive& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+compact_oarchive& operator<<(compact_oarchive& ar, T& v)
+{
+  ar & v;
+  return ar;
+}
+
+template <class T>
+compact_oarchive& operator<<(compact_oarchive& ar, const T& v)
+{
+  ar & v;
+  return ar;
+}
+
+// how an integer type is mapped to and from the unsigned varint value
+template <class T>
+struct varint_traits { static const bool is_varint = false; };
+
+#define gen_varint_unsigned(tt) \
+  template <> struct varint_traits<tt> { \
+    static const bool is_varint = true; \
+    static uint64_t encode(tt v) { return v; } \
+    static tt decode(uint64_t v) { return static_cast<tt>(v); } \
+  }
+
+#define gen_varint_signed(tt) \
+  template <> struct varint_traits<tt> { \
+    static const bool is_varint = true; \
+    static uint64_t encode(tt v) { \
+      int64_t n = v; \
+      return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63); \
+    } \
+    static tt decode(uint64_t v) { \
+      return static_cast<tt>(static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1))); \
+    } \
+  }
+
+gen_varint_signed(short);
+gen_varint_unsigned(unsigned short);
+gen_varint_signed(int);
+gen_varint_unsigned(unsigned int);
+gen_varint_signed(long);
+gen_varint_unsigned(unsigned long);
+gen_varint_signed(long long);
+gen_varint_unsigned(unsigned long long);
+
+#undef gen_varint_unsigned
+#undef gen_varint_signed
+
+template <class T>
+void compact_iarchive::read_varints(T* p, size_t n)
+{
+  size_t i = 0;
+  if (!sb) {
+    // while the next 8 bytes are all single-byte varints, they are
+    // decoded without looking for continuation bits one by one
+    static const uint64_t cont_bits = 0x8080808080808080ULL;
+    while (ok && i < n && end - cur >= 8) {
+      uint64_t w;
+      std::memcpy(&w, cur, 8);
+      if ((w & cont_bits) == 0) {
+        size_t m = n - i < 8 ? n - i : 8;
+        for (size_t k = 0; k < m; k++)
+          p[i + k] = varint_traits<T>::decode(static_cast<unsigned char>(cur[k]));
+        cur += m;
+        i += m;
+        continue;
+      }
+      uint64_t v;
+      if (!read_varint(v))
+        return;
+      p[i++] = varint_traits<T>::decode(v);
+    }
+  }
+  for (; ok && i < n; i++) {
+    uint64_t v;
+    if (!read_varint(v))
+      return;
+    p[i] = varint_traits<T>::decode(v);
+  }
+}
+
+template <class T>
+void compact_oarchive::write_varints(const T* p, size_t n)
+{
+  char buf[1024];
+  size_t len = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (len + max_varint_size > sizeof(buf)) {
+      os.write(buf, len);
+      len = 0;
+    }
+    len += encode_varint(buf + len, varint_traits<T>::encode(p[i]));
+  }
+  os.write(buf, len);
+}
+
+#define gen_serial_compact_varint(tt) \
+  inline void serialize(compact_iarchive& ar, tt& n) \
+  { \
+    uint64_t v; \
+    if (ar.read_varint(v)) n = varint_traits<tt>::decode(v); \
+  } \
+  inline void serialize(compact_oarchive& ar, tt n) \
+  { \
+    ar.write_varint(varint_traits<tt>::encode(n)); \
+  }
+
+#define gen_serial_compact_raw(tt) \
+  inline void serialize(compact_iarchive& ar, tt& n) \
+  { \
+    tt tmp; \
+    ar.read<sizeof(tmp)>(reinterpret_cast<char*>(&tmp)); \
+    if (ar) n = pfi::system::endian::from_little(tmp); \
+  } \
+  inline void serialize(compact_oarchive& ar, tt n) \
+  { \
+    n = pfi::system::endian::to_little(n); \
+    ar.write<sizeof(n)>(reinterpret_cast<const char*>(&n)); \
+  }
+
+gen_serial_compact_raw(bool);
+gen_serial_compact_raw(char);
+gen_serial_compact_raw(signed char);
+gen_serial_compact_raw(unsigned char);
+gen_serial_compact_varint(short);
+gen_serial_compact_varint(unsigned short);
+gen_serial_compact_varint(int);
+gen_serial_compact_varint(unsigned int);
+gen_serial_compact_varint(long);
+gen_serial_compact_varint(unsigned long);
+gen_serial_compact_varint(long long);
+gen_serial_compact_varint(unsigned long long);
+gen_serial_compact_raw(float);
+gen_serial_compact_raw(double);
+gen_serial_compact_raw(long double);
+
+#undef gen_serial_compact_varint
+#undef gen_serial_compact_raw
+
+// strings and vectors of chars and floating point values are copied at once
+
+template <class T>
+struct is_raw_sequence<compact_iarchive, T> {
+  static const bool value =
+    is_bulk_copyable<T>::value && !varint_traits<T>::is_varint;
+};
+
+template <class T>
+struct is_raw_sequence<compact_oarchive, T> {
+  static const bool value =
+    is_bulk_copyable<T>::value && !varint_traits<T>::is_varint;
+};
+
+inline void copy_bytes(compact_iarchive& ar, char* p, size_t size)
+{
+  ar.read(p, size);
+}
+
+inline void copy_bytes(compact_oarchive& ar, const char* p, size_t size)
+{
+  ar.write(p, size);
+}
+
+// vectors of integers are encoded and decoded in bulk
+
+namespace detail {
+
+template <bool Varint>
+struct compact_vector_serializer {
+  template <class Archive, class T, class Allocator>
+  static void serialize(Archive& ar, std::vector<T, Allocator>& v) {
+    serialization::serialize<Archive, T, Allocator>(ar, v);
+  }
+};
+
+template <>
+struct compact_vector_serializer<true> {
+  template <class T, class Allocator>
+  static void serialize(compact_iarchive& ar, std::vector<T, Allocator>& v) {
+    uint32_t size = 0;
+    ar & size;
+    if (!ar)
+      return;
+    v.resize(size);
+    if (size > 0)
+      ar.read_varints(&v[0], size);
+  }
+
+  template <class T, class Allocator>
+  static void serialize(compact_oarchive& ar, std::vector<T, Allocator>& v) {
+    uint32_t size = static_cast<uint32_t>(v.size());
+    ar & size;
+    if (size > 0)
+      ar.write_varints(&v[0], size);
+  }
+};
+
+} // detail
+
+template <class T, class Allocator>
+void serialize(compact_iarchive& ar, std::vector<T, Allocator>& v)
+{
+  detail::compact_vector_serializer<varint_traits<T>::is_varint>::serialize(ar, v);
+}
+
+template <class T, class Allocator>
+void serialize(compact_oarchive& ar, std::vector<T, Allocator>& v)
+{
+  detail::compact_vector_serializer<varint_traits<T>::is_varint>::serialize(ar, v);
+}
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPACT_H_
@@ -0,0 +1,374 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPILED_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPILED_H_
+
+#include "base.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "reflect.h"
+#include "../unordered_map.h"
+#include "../unordered_set.h"
+
+namespace pfi{
+namespace data{
+namespace serialization{
+
+// compiled(v) serializes v with a plan built at the first use for each
+// type and archive: members of nested classes are flattened into a list of
+// byte ranges of v and of members serialized as usual, such as containers.
+// adjacent integer and floating point members are copied at once.
+//
+//   ar & compiled(v);
+//
+// the plan is built by serializing a default constructed T, so serialize()
+// of the classes must only list members, independently of their values and
+// of the direction. otherwise (e.g. a temporary is serialized), v is
+// serialized as usual. archives other than binary ones always serialize v
+// as usual.
+
+template <class T>
+class compiled_value {
+public:
+  explicit compiled_value(T& v) : v(v) {}
+  T& value() const { return v; }
+
+private:
+  T& v;
+};
+
+template <class T>
+compiled_value<T> compiled(T& v)
+{
+  return compiled_value<T>(v);
+}
+
+namespace detail {
+
+// types serialized as a whole by a plan
+
+template <class T>
+struct is_plan_leaf { static const bool value = false; };
+
+template <> struct is_plan_leaf<bool> { static const bool value = true; };
+template <> struct is_plan_leaf<long double> { static const bool value = true; };
+
+template <class C, class T, class A>
+struct is_plan_leaf<std::basic_string<C, T, A> > { static const bool value = true; };
+
+template <class T, class A>
+struct is_plan_leaf<std::vector<T, A> > { static const bool value = true; };
+
+template <class T, class A>
+struct is_plan_leaf<std::deque<T, A> > { static const bool value = true; };
+
+template <class T, class A>
+struct is_plan_leaf<std::list<T, A> > { static const bool value = true; };
+
+template <class K, class C, class A>
+struct is_plan_leaf<std::set<K, C, A> > { static const bool value = true; };
+
+template <class K, class V, class C, class A>
+struct is_plan_leaf<std::map<K, V, C, A> > { static const bool value = true; };
+
+template <class K, class H, class P, class A>
+struct is_plan_leaf<unordered_set<K, H, P, A> > { static const bool value = true; };
+
+template <class K, class V, class H, class P, class A>
+struct is_plan_leaf<unordered_map<K, V, H, P, A> > { static const bool value = true; };
+
+// whether the members of T are added to a plan, rather than T as a leaf.
+// types with a serializer of their own, such as a free serialize(), are
+// leaves.
+template <class Archive, class T>
+struct has_member_serialize {
+  static const bool value =
+    sizeof(access::check_serialize<Archive, T>(0)) == sizeof(char);
+};
+
+template <class Archive>
+struct plan_op {
+  size_t offset;
+  size_t size; // bytes copied as they are, or 0 for leaf
+  void (*leaf)(Archive&, char*);
+
+  bool operator==(const plan_op& o) const {
+    return offset == o.offset && size == o.size && leaf == o.leaf;
+  }
+};
+
+template <class Archive, class T>
+void serialize_leaf(Archive& ar, char* p)
+{
+  ar & *reinterpret_cast<T*>(p);
+}
+
+template <bool Raw, bool Leaf>
+struct plan_adder;
+
+// records the members of an object into ops
+
+template <class Archive, bool IsRead>
+class plan_builder {
+public:
+  plan_builder(const char* base, size_t size)
+    : base(base), size(size), valid(true) {}
+
+  static const bool is_read = IsRead;
+
+  template <class T>
+  void add(T& v) {
+    plan_adder<is_bulk_copyable<T>::value, is_plan_leaf<T>::value>::add(*this, v);
+  }
+
+  template <class T, std::size_t N>
+  void add(T (&v)[N]) {
+    for (std::size_t i = 0; i < N; i++)
+      add(v[i]);
+  }
+
+  template <class A, class B>
+  void add(std::pair<A, B>& v) {
+    add(v.first);
+    add(v.second);
+  }
+
+  template <class T>
+  void add(named_value<T>& nv) {
+    add(nv.v);
+  }
+
+  void add(class_name&) {
+  }
+
+  // a value which is not a member
+  template <class T>
+  void add(const T&) {
+    valid = false;
+  }
+
+  template <class T>
+  void add_raw(T& v) {
+    if (!pfi::system::endian::is_little()) {
+      add_leaf(v);
+      return;
+    }
+    size_t off;
+    if (!offset_of(v, off))
+      return;
+    if (!ops.empty() && ops.back().size > 0 &&
+        ops.back().offset + ops.back().size == off) {
+      ops.back().size += sizeof(T);
+      return;
+    }
+    plan_op<Archive> op = { off, sizeof(T), NULL };
+    ops.push_back(op);
+  }
+
+  template <class T>
+  void add_leaf(T& v) {
+    size_t off;
+    if (!offset_of(v, off))
+      return;
+    plan_op<Archive> op = { off, 0, &serialize_leaf<Archive, T> };
+    ops.push_back(op);
+  }
+
+  bool is_valid() const { return valid; }
+  const std::vector<plan_op<Archive> >& get_ops() const { return ops; }
+
+private:
+  template <class T>
+  bool offset_of(T& v, size_t& off) {
+    const char* p = reinterpret_cast<const char*>(&v);
+    if (p < base || p + sizeof(T) > base + size) {
+      valid = false;
+      return false;
+    }
+    off = p - base;
+    return true;
+  }
+
+  const char* base;
+  size_t size;
+  bool valid;
+  std::vector<plan_op<Archive> > ops;
+};
+
+template <class Archive, bool IsRead, class T>
+plan_builder<Archive, IsRead>& operator&(plan_builder<Archive, IsRead>& b, T& v)
+{
+  b.add(v);
+  return b;
+}
+
+template <class Archive, bool IsRead, class T>
+plan_builder<Archive, IsRead>& operator&(plan_builder<Archive, IsRead>& b, const T& v)
+{
+  b.add(v);
+  return b;
+}
+
+template <bool Leaf>
+struct plan_adder<true, Leaf> {
+  template <class Builder, class T>
+  static void add(Builder& b, T& v) { b.add_raw(v); }
+};
+
+template <>
+struct plan_adder<false, true> {
+  template <class Builder, class T>
+  static void add(Builder& b, T& v) { b.add_leaf(v); }
+};
+
+template <bool Member>
+struct plan_member_adder {
+  template <class Builder, class T>
+  static void add(Builder& b, T& v) { access::serialize(b, v); }
+};
+
+template <>
+struct plan_member_adder<false> {
+  template <class Builder, class T>
+  static void add(Builder& b, T& v) { b.add_leaf(v); }
+};
+
+template <>
+struct plan_adder<false, false> {
+  template <class Builder, class T>
+  static void add(Builder& b, T& v) {
+    plan_member_adder<has_member_serialize<Builder, T>::value>::add(b, v);
+  }
+};
+
+template <class Archive, class T>
+class compiled_plan {
+public:
+  static const compiled_plan& get() {
+    static const compiled_plan plan;
+    return plan;
+  }
+
+  bool is_valid() const { return valid; }
+  size_t size() const { return ops.size(); }
+
+  void run(Archive& ar, T& v) const {
+    if (!valid) {
+      ar & v;
+      return;
+    }
+    char* base = reinterpret_cast<char*>(&v);
+    for (size_t i = 0; i < ops.size() && ar; i++) {
+      const plan_op<Archive>& op = ops[i];
+      if (op.leaf)
+        op.leaf(ar, base + op.offset);
+      else
+        copy_bytes(ar, base + op.offset, op.size);
+    }
+  }
+
+private:
+  compiled_plan() : valid(false) {
+    T v;
+    plan_builder<Archive, true> r(reinterpret_cast<const char*>(&v), sizeof(T));
+    plan_builder<Archive, false> w(reinterpret_cast<const char*>(&v), sizeof(T));
+    r.add(v);
+    w.add(v);
+    valid = r.is_valid() && w.is_valid() && r.get_ops() == w.get_ops();
+    if (valid)
+      ops = r.get_ops();
+  }
+
+  bool valid;
+  std::vector<plan_op<Archive> > ops;
+};
+
+template <bool Binary>
+struct compiled_serializer {
+  template <class Archive, class T>
+  static void serialize(Archive& ar, T& v) {
+    ar & v;
+  }
+};
+
+template <>
+struct compiled_serializer<true> {
+  template <class Archive, class T>
+  static void serialize(Archive& ar, T& v) {
+    compiled_plan<Archive, T>::get().run(ar, v);
+  }
+};
+
+} // detail
+
+template <class Archive, class T>
+void serialize(Archive& ar, const compiled_value<T>& cv)
+{
+  detail::compiled_serializer<is_binary_archive<Archive>::value>::serialize(ar, cv.value());
+}
+
+// the printed type of T, which changes when the layout of T serialized
+// by the binary archives changes. peers can compare fingerprints to detect
+// a mismatch of versions.
+
+template <class T>
+std::string type_signature()
+{
+  std::ostringstream os;
+  get_type<T>()->print(os);
+  return os.str();
+}
+
+template <class T>
+uint64_t type_fingerprint()
+{
+  std::string s = type_signature<T>();
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < s.size(); i++) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_COMPILED_H_
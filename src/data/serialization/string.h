@@ -49,8 +49,7 @@ void serialize(Archive &ar, std::basic_string<CharType, Traits, Allocator> &s)
   ar & length;
 
   s.resize(length);
-  for (uint32_t i=0;i<length;i++)
-    ar & s[i];
+  serialize_sequence<CharType>(ar, s, length);
 }
 
 class string_type : public type_rep {
@@ -47,8 +47,7 @@ void serialize(Archive &ar, std::vector<T, Allocator> &v)
   ar & size;
 
   v.resize(size);
-  for (uint32_t i=0;i<size;i++)
-    ar & v[i];
+  serialize_sequence<T>(ar, v, size);
 }
 
 class array_type : public type_rep {
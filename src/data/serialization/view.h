@@ -0,0 +1,218 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_VIEW_H_
+#define INCLUDE_GUARD_PFI_DATA_SERIALIZATION_VIEW_H_
+
+#include "base.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../functional_hash.h"
+#include "../../system/endian_util.h"
+
+namespace pfi{
+namespace data{
+namespace serialization{
+
+// Read-only views of serialized sequences. When read from a
+// memory_iarchive they refer to the archive's memory instead of copying,
+// e.g. to load a model from a file mapped read-only with
+// pfi::system::mmapper::mmapper, which worker processes then share:
+//
+//   mmapper m;
+//   m.open(path, false);
+//   memory_iarchive ia(m.begin(), m.size());
+//   ia >> model;  // views in model are valid while m is mapped
+//
+// They have the formats of vector<T> and string, so they are written by
+// serializing a vector<T> or string (or the view itself) with any
+// binary archive.
+
+// a view of a vector<T> of an arithmetic type T (see is_bulk_copyable).
+// elements are unaligned little-endian images, so they are read by value
+template <class T>
+class array_view{
+public:
+  typedef T value_type;
+
+  array_view()
+    : p(NULL)
+    , n(0){
+  }
+
+  array_view(const char *p, size_t n)
+    : p(p)
+    , n(n){
+  }
+
+  size_t size() const{ return n; }
+  bool empty() const{ return n==0; }
+
+  T operator[](size_t i) const{
+    T v;
+    std::memcpy(&v, p+i*sizeof(T), sizeof(T));
+    return pfi::system::endian::from_little(v);
+  }
+
+  // the raw little-endian images
+  const char *data() const{ return p; }
+
+  std::vector<T> to_vector() const{
+    std::vector<T> v(n);
+    for (size_t i=0;i<n;i++)
+      v[i]=(*this)[i];
+    return v;
+  }
+
+private:
+  const char *p;
+  size_t n;
+};
+
+// a view of a string
+class string_view{
+public:
+  string_view()
+    : p(NULL)
+    , n(0){
+  }
+
+  string_view(const char *p, size_t n)
+    : p(p)
+    , n(n){
+  }
+
+  string_view(const std::string &s)
+    : p(s.data())
+    , n(s.size()){
+  }
+
+  size_t size() const{ return n; }
+  bool empty() const{ return n==0; }
+  const char *data() const{ return p; }
+  char operator[](size_t i) const{ return p[i]; }
+
+  std::string str() const{ return std::string(p, n); }
+
+  int compare(const string_view &s) const{
+    int r=std::memcmp(p, s.p, n<s.n?n:s.n);
+    if (r!=0) return r;
+    return n<s.n?-1:n>s.n?1:0;
+  }
+
+  bool operator==(const string_view &s) const{
+    return n==s.n && std::memcmp(p, s.p, n)==0;
+  }
+  bool operator!=(const string_view &s) const{ return !(*this==s); }
+  bool operator<(const string_view &s) const{ return compare(s)<0; }
+
+private:
+  const char *p;
+  size_t n;
+};
+
+namespace detail{
+
+template <bool IsRead>
+struct view_serializer{
+  template <class Archive, class View>
+  static void serialize(Archive &ar, View &v, size_t elem_size){
+    uint32_t size=static_cast<uint32_t>(v.size());
+    ar & size;
+    // archives take int sizes
+    const size_t bytes=size*elem_size;
+    for (size_t i=0;i<bytes && ar;i+=max_bulk_chunk)
+      ar.write(v.data()+i, static_cast<int>(std::min(bytes-i, max_bulk_chunk)));
+  }
+};
+
+// views can only be read from memory
+inline void read_view(memory_iarchive &ar, const char **p, size_t size){
+  *p=ar.pos();
+  ar.skip(size);
+}
+
+template <>
+struct view_serializer<true>{
+  template <class Archive, class View>
+  static void serialize(Archive &ar, View &v, size_t elem_size){
+    uint32_t size=0;
+    ar & size;
+    if (!ar) return;
+    const char *p;
+    read_view(ar, &p, size*elem_size);
+    if (ar) v=View(p, size);
+  }
+};
+
+} // detail
+
+template <class Archive, class T>
+void serialize(Archive &ar, array_view<T> &v)
+{
+  if (!pfi::system::endian::is_little() && !Archive::is_read){
+    // the images must be swapped
+    std::vector<T> tmp=v.to_vector();
+    ar & tmp;
+    return;
+  }
+  detail::view_serializer<Archive::is_read>::serialize(ar, v, sizeof(T));
+}
+
+template <class Archive>
+void serialize(Archive &ar, string_view &v)
+{
+  detail::view_serializer<Archive::is_read>::serialize(ar, v, 1);
+}
+
+} // serialization
+
+template <>
+class hash<serialization::string_view>{
+public:
+  size_t operator()(const serialization::string_view &s) const{
+    // FNV-1a
+    size_t h=static_cast<size_t>(14695981039346656037ULL);
+    for (size_t i=0;i<s.size();i++){
+      h^=static_cast<unsigned char>(s[i]);
+      h*=static_cast<size_t>(1099511628211ULL);
+    }
+    return h;
+  }
+};
+
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_DATA_SERIALIZATION_VIEW_H_
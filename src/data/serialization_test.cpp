@@ -54,7 +54,14 @@
 #include "./unordered_set.h"
 #include "./serialization/unordered_set.h"
 
+#include "./serialization/view.h"
+#include "./serialization/compact.h"
+#include "./serialization/chunked.h"
+#include "./serialization/compiled.h"
+#include "../system/mmapper.h"
+
 #include "../lang/shared_ptr.h"
+#include "../lang/scoped_ptr.h"
 
 using namespace std;
 using namespace pfi::data::serialization;
@@ -415,3 +422,525 @@ TEST(serialization, safe_bool) {
     EXPECT_FALSE(ia);
   }
 }
+
+TEST(serialization, memory_archive) {
+  vector<float> vf;
+  vector<double> vd;
+  vector<string> vs;
+  for (size_t i=0;i<1000;++i) {
+    vf.push_back(random()/3.0f);
+    vd.push_back(random()/7.0);
+    vs.push_back(string(i%10, 'a'+i%26));
+  }
+  string s="memory archive";
+  long long ll[N];
+  for (size_t i=0;i<N;++i) ll[i]=(long long)random()*random();
+
+  vector<char> buf;
+  {
+    memory_oarchive oa(buf);
+    oa<<vf<<vd<<vs<<s<<ll<<INT_MIN;
+  }
+
+  // the same format as binary_oarchive
+  {
+    ostringstream os;
+    binary_oarchive oa(os);
+    oa<<vf<<vd<<vs<<s<<ll<<INT_MIN;
+    oa.flush();
+    EXPECT_TRUE(os.str()==string(buf.begin(), buf.end()));
+  }
+
+  {
+    vector<float> vf2;
+    vector<double> vd2;
+    vector<string> vs2;
+    string s2;
+    long long ll2[N];
+    int n=0;
+
+    memory_iarchive ia(&buf[0], buf.size());
+    ia>>vf2>>vd2>>vs2>>s2>>ll2>>n;
+    EXPECT_TRUE(ia);
+    EXPECT_EQ(0u, ia.remaining());
+
+    EXPECT_TRUE(vf==vf2);
+    EXPECT_TRUE(vd==vd2);
+    EXPECT_TRUE(vs==vs2);
+    EXPECT_EQ(s, s2);
+    for (size_t i=0;i<N;++i) EXPECT_EQ(ll[i], ll2[i]);
+    EXPECT_EQ(INT_MIN, n);
+  }
+
+  {
+    // truncated input
+    vector<float> vf2;
+    memory_iarchive ia(&buf[0], 100);
+    ia>>vf2;
+    EXPECT_FALSE(ia);
+  }
+}
+
+TEST(serialization, bulk_vector_from_stream) {
+  vector<int> v1, v2;
+  for (size_t i=0;i<100000;++i) v1.push_back(random());
+  {
+    ofstream ofs("./tmp");
+    binary_oarchive oa(ofs);
+    oa<<v1;
+  }
+  {
+    ifstream ifs("./tmp");
+    binary_iarchive ia(ifs);
+    ia>>v2;
+    EXPECT_TRUE(ia);
+  }
+  EXPECT_TRUE(v1==v2);
+
+  {
+    // truncated input
+    ifstream ifs("./tmp");
+    string head(1000, '\0');
+    ifs.read(&head[0], head.size());
+    istringstream iss(head);
+    binary_iarchive ia(iss);
+    ia>>v2;
+    EXPECT_FALSE(ia);
+  }
+}
+
+TEST(serialization, view) {
+  vector<float> vf;
+  for (size_t i=0;i<1000;++i) vf.push_back(random()/3.0f);
+  string s="view test";
+  vector<string> vs;
+  pfi::data::unordered_map<string, int> m;
+  for (size_t i=0;i<100;++i) {
+    vs.push_back(string(i%10+1, 'a'+i%26));
+    m[vs.back()]=i;
+  }
+  {
+    ofstream ofs("./tmp");
+    binary_oarchive oa(ofs);
+    oa<<vf<<s<<vs<<m<<vf;
+  }
+
+  pfi::system::mmapper::mmapper mm;
+  ASSERT_EQ(0, mm.open("./tmp", false));
+  memory_iarchive ia(mm.begin(), mm.size());
+
+  array_view<float> avf;
+  string_view sv;
+  vector<string_view> vsv;
+  pfi::data::unordered_map<string_view, int, pfi::data::hash<string_view> > msv;
+  vector<float> vf2;
+  ia>>avf>>sv>>vsv>>msv>>vf2;
+  EXPECT_TRUE(ia);
+  EXPECT_EQ(0u, ia.remaining());
+
+  ASSERT_EQ(vf.size(), avf.size());
+  for (size_t i=0;i<vf.size();++i) EXPECT_EQ(vf[i], avf[i]);
+  EXPECT_TRUE(vf==avf.to_vector());
+  EXPECT_TRUE(vf==vf2);
+
+  // views refer to the mapping
+  EXPECT_TRUE(mm.begin()<sv.data() && sv.data()<mm.end());
+  EXPECT_EQ(s, sv.str());
+
+  ASSERT_EQ(vs.size(), vsv.size());
+  for (size_t i=0;i<vs.size();++i) EXPECT_EQ(vs[i], vsv[i].str());
+
+  EXPECT_EQ(m.size(), msv.size());
+  for (pfi::data::unordered_map<string, int>::iterator it=m.begin();it!=m.end();++it) {
+    ASSERT_EQ(1u, msv.count(string_view(it->first)));
+    EXPECT_EQ(it->second, msv[string_view(it->first)]);
+  }
+
+  // views are written in the formats of the viewed types
+  vector<char> buf;
+  {
+    memory_oarchive oa(buf);
+    oa<<avf<<sv;
+  }
+  {
+    memory_iarchive ia2(&buf[0], buf.size());
+    string s2;
+    ia2>>vf2>>s2;
+    EXPECT_TRUE(ia2);
+    EXPECT_TRUE(vf==vf2);
+    EXPECT_EQ(s, s2);
+  }
+
+  {
+    // truncated input
+    memory_iarchive ia2(mm.begin(), 100);
+    ia2>>avf;
+    EXPECT_FALSE(ia2);
+  }
+}
+
+TEST(serialization, compact) {
+  vector<int> vi;
+  vector<unsigned long long> vu;
+  vector<double> vd;
+  for (size_t i=0;i<10000;++i) {
+    vi.push_back(i%3==0 ? (int)(random()%100)-50 : (int)random()-RAND_MAX/2);
+    vu.push_back(i%2 ? i : (unsigned long long)random()*random());
+    vd.push_back(random()/7.0);
+  }
+  map<string, long> m;
+  for (size_t i=0;i<100;++i) m[string(i%10+1, 'a'+i%26)]=-(long)i;
+  string s="compact archive";
+
+  ostringstream os;
+  {
+    compact_oarchive oa(os);
+    oa<<vi<<vu<<vd<<m<<s<<INT_MIN<<INT_MAX<<LLONG_MIN<<ULLONG_MAX<<(short)-1<<true<<'x'<<1.5f;
+    oa.flush();
+  }
+  string buf=os.str();
+
+  // small integers take fewer bytes than in the binary format
+  {
+    ostringstream bos;
+    binary_oarchive oa(bos);
+    oa<<vi<<vu;
+    oa.flush();
+    ostringstream cos;
+    compact_oarchive ca(cos);
+    ca<<vi<<vu;
+    ca.flush();
+    EXPECT_LT(cos.str().size(), bos.str().size());
+  }
+
+  // from a stream and from memory
+  for (int mode=0;mode<2;++mode) {
+    istringstream is(buf);
+    pfi::lang::scoped_ptr<compact_iarchive> ia(mode==0 ?
+      new compact_iarchive(is) : new compact_iarchive(buf.data(), buf.size()));
+
+    vector<int> vi2;
+    vector<unsigned long long> vu2;
+    vector<double> vd2;
+    map<string, long> m2;
+    string s2;
+    int imin=0, imax=0;
+    long long llmin=0;
+    unsigned long long ullmax=0;
+    short sh=0;
+    bool b=false;
+    char c=0;
+    float f=0;
+    *ia>>vi2>>vu2>>vd2>>m2>>s2>>imin>>imax>>llmin>>ullmax>>sh>>b>>c>>f;
+    EXPECT_TRUE(*ia);
+
+    EXPECT_TRUE(vi==vi2);
+    EXPECT_TRUE(vu==vu2);
+    EXPECT_TRUE(vd==vd2);
+    EXPECT_TRUE(m==m2);
+    EXPECT_EQ(s, s2);
+    EXPECT_EQ(INT_MIN, imin);
+    EXPECT_EQ(INT_MAX, imax);
+    EXPECT_EQ(LLONG_MIN, llmin);
+    EXPECT_EQ(ULLONG_MAX, ullmax);
+    EXPECT_EQ(-1, sh);
+    EXPECT_TRUE(b);
+    EXPECT_EQ('x', c);
+    EXPECT_EQ(1.5f, f);
+  }
+
+  {
+    // truncated input
+    vector<int> vi2;
+    compact_iarchive ia(buf.data(), 1000);
+    ia>>vi2;
+    EXPECT_FALSE(ia);
+
+    istringstream is(buf.substr(0, 1000));
+    compact_iarchive ia2(is);
+    ia2>>vi2;
+    EXPECT_FALSE(ia2);
+  }
+  {
+    // a varint longer than 10 bytes
+    string bad(11, '\xff');
+    compact_iarchive ia(bad.data(), bad.size());
+    unsigned long long n;
+    ia>>n;
+    EXPECT_FALSE(ia);
+  }
+}
+
+TEST(serialization, chunked) {
+  pfi::data::unordered_map<string, int> m;
+  for (int i=0;i<100000;++i) {
+    ostringstream os;
+    os<<random()<<'-'<<i;
+    m[os.str()]=i;
+  }
+  map<int, vector<int> > vm;
+  for (int i=0;i<1000;++i) vm[i]=vector<int>(i%7, i);
+  vector<double> v;
+
+  vector<char> buf;
+  {
+    memory_oarchive oa(buf);
+    oa<<chunked(m, 4, 1000)<<chunked(vm, 3, 100)<<chunked(v)<<INT_MAX;
+  }
+
+  // from memory and from a stream with a different number of threads
+  for (int mode=0;mode<2;++mode) {
+    pfi::data::unordered_map<string, int> m2;
+    map<int, vector<int> > vm2;
+    vector<double> v2(10);
+    int n=0;
+    if (mode==0) {
+      memory_iarchive ia(&buf[0], buf.size());
+      ia>>chunked(m2, 2)>>chunked(vm2, 8)>>chunked(v2)>>n;
+      EXPECT_TRUE(ia);
+      EXPECT_EQ(0u, ia.remaining());
+    } else {
+      istringstream is(string(buf.begin(), buf.end()));
+      binary_iarchive ia(is);
+      ia>>chunked(m2, 1)>>chunked(vm2, 1)>>chunked(v2, 1)>>n;
+      EXPECT_TRUE(ia);
+    }
+    ASSERT_EQ(m.size(), m2.size());
+    for (pfi::data::unordered_map<string, int>::iterator it=m.begin();it!=m.end();++it)
+      EXPECT_EQ(it->second, m2[it->first]);
+    EXPECT_TRUE(vm==vm2);
+    EXPECT_TRUE(v2.empty());
+    EXPECT_EQ(INT_MAX, n);
+  }
+
+  {
+    // truncated input
+    pfi::data::unordered_map<string, int> m2;
+    memory_iarchive ia(&buf[0], buf.size()/2);
+    ia>>chunked(m2);
+    EXPECT_FALSE(ia);
+    EXPECT_TRUE(m2.empty());
+  }
+
+  {
+    // a corrupt index fails without allocating what it says
+    vector<char> bad;
+    {
+      memory_oarchive oa(bad);
+      oa<<uint32_t(1)<<uint32_t(0xFFFFFFFFu)<<(uint64_t(1)<<40)<<INT_MAX;
+    }
+    pfi::data::unordered_map<string, int> m2;
+    memory_iarchive ia(&bad[0], bad.size());
+    ia>>chunked(m2);
+    EXPECT_FALSE(ia);
+    EXPECT_TRUE(m2.empty());
+
+    istringstream is(string(bad.begin(), bad.end()));
+    binary_iarchive bia(is);
+    bia>>chunked(m2);
+    EXPECT_FALSE(bia);
+    EXPECT_TRUE(m2.empty());
+
+    // a count larger than the chunk holds
+    bad.clear();
+    {
+      memory_oarchive oa(bad);
+      oa<<uint32_t(1)<<uint32_t(0xFFFFFFFFu)<<uint64_t(sizeof(int))<<INT_MAX;
+    }
+    vector<int> v2;
+    memory_iarchive ia2(&bad[0], bad.size());
+    ia2>>chunked(v2);
+    EXPECT_FALSE(ia2);
+    EXPECT_TRUE(v2.empty());
+
+    istringstream is2(string(bad.begin(), bad.end()));
+    binary_iarchive bia2(is2);
+    bia2>>chunked(v2);
+    EXPECT_FALSE(bia2);
+    EXPECT_TRUE(v2.empty());
+
+    // trailing bytes in a chunk
+    bad.clear();
+    {
+      memory_oarchive oa(bad);
+      oa<<uint32_t(1)<<uint32_t(1)<<uint64_t(2*sizeof(int))<<INT_MAX<<INT_MAX;
+    }
+    memory_iarchive ia3(&bad[0], bad.size());
+    ia3>>chunked(v2);
+    EXPECT_FALSE(ia3);
+    EXPECT_TRUE(v2.empty());
+  }
+}
+
+namespace {
+
+struct point {
+  int x, y;
+  double w;
+  template <class Ar>
+  void serialize(Ar& ar) {
+    ar & x & y & w;
+  }
+};
+
+struct shape {
+  point ps[3];
+  char tag;
+  bool closed;
+  string name;
+  vector<int> ids;
+  pair<short, long long> p;
+
+  template <class Ar>
+  void serialize(Ar& ar) {
+    ar & NAME(shape) & MEMBER(ps) & MEMBER(tag) & MEMBER(closed)
+       & MEMBER(name) & MEMBER(ids) & p;
+  }
+};
+
+// serializes a temporary, which cannot be compiled
+struct with_temporary {
+  int n;
+  template <class Ar>
+  void serialize(Ar& ar) {
+    int tmp=n;
+    ar & tmp;
+    n=tmp;
+  }
+};
+
+// serialized by a free function
+struct celsius {
+  double v;
+};
+
+template <class Ar>
+void serialize(Ar& ar, celsius& c) {
+  ar & c.v;
+}
+
+#if HAVE_TR1_UNORDERED_MAP
+struct with_free_serializers {
+  int id;
+  std::tr1::unordered_map<int, int> m;
+  celsius t;
+
+  template <class Ar>
+  void serialize(Ar& ar) {
+    ar & id & m & t;
+  }
+};
+#endif
+
+}
+
+TEST(serialization, compiled) {
+  // ps, tag are copied at once
+  EXPECT_TRUE((pfi::data::serialization::detail::compiled_plan<memory_oarchive, shape>::get().is_valid()));
+  EXPECT_EQ(6u, (pfi::data::serialization::detail::compiled_plan<memory_oarchive, shape>::get().size()));
+  EXPECT_FALSE((pfi::data::serialization::detail::compiled_plan<memory_oarchive, with_temporary>::get().is_valid()));
+
+  shape s;
+  for (int i=0;i<3;++i) {
+    s.ps[i].x=random();
+    s.ps[i].y=-i;
+    s.ps[i].w=random()/3.0;
+  }
+  s.tag='t';
+  s.closed=true;
+  s.name="triangle";
+  s.ids.push_back(1);
+  s.ids.push_back(2);
+  s.p=make_pair(-1, LLONG_MIN);
+  with_temporary wt;
+  wt.n=42;
+
+  // the same format as serialization without plans
+  vector<char> buf;
+  {
+    memory_oarchive oa(buf);
+    oa<<compiled(s)<<compiled(wt);
+  }
+  {
+    ostringstream os;
+    binary_oarchive oa(os);
+    oa<<s<<wt;
+    oa.flush();
+    EXPECT_TRUE(os.str()==string(buf.begin(), buf.end()));
+  }
+
+  for (int mode=0;mode<2;++mode) {
+    shape t;
+    with_temporary wt2;
+    if (mode==0) {
+      memory_iarchive ia(&buf[0], buf.size());
+      ia>>compiled(t)>>compiled(wt2);
+      EXPECT_TRUE(ia);
+    } else {
+      istringstream is(string(buf.begin(), buf.end()));
+      binary_iarchive ia(is);
+      ia>>compiled(t)>>compiled(wt2);
+      EXPECT_TRUE(ia);
+    }
+    for (int i=0;i<3;++i) {
+      EXPECT_EQ(s.ps[i].x, t.ps[i].x);
+      EXPECT_EQ(s.ps[i].y, t.ps[i].y);
+      EXPECT_EQ(s.ps[i].w, t.ps[i].w);
+    }
+    EXPECT_EQ(s.tag, t.tag);
+    EXPECT_EQ(s.closed, t.closed);
+    EXPECT_EQ(s.name, t.name);
+    EXPECT_TRUE(s.ids==t.ids);
+    EXPECT_TRUE(s.p==t.p);
+    EXPECT_EQ(42, wt2.n);
+  }
+
+  {
+    // truncated input
+    shape t;
+    memory_iarchive ia(&buf[0], 30);
+    ia>>compiled(t);
+    EXPECT_FALSE(ia);
+  }
+
+  EXPECT_EQ(type_fingerprint<vector<int> >(), type_fingerprint<vector<int> >());
+  EXPECT_NE(type_fingerprint<vector<int> >(), type_fingerprint<vector<unsigned int> >());
+  EXPECT_NE(type_fingerprint<vector<int> >(), (type_fingerprint<map<int, string> >()));
+}
+
+#if HAVE_TR1_UNORDERED_MAP
+TEST(serialization, compiled_free_serializer) {
+  // members without a member serialize() are serialized as a whole
+  EXPECT_TRUE((pfi::data::serialization::detail::compiled_plan<memory_oarchive, with_free_serializers>::get().is_valid()));
+  EXPECT_EQ(3u, (pfi::data::serialization::detail::compiled_plan<memory_oarchive, with_free_serializers>::get().size()));
+
+  with_free_serializers s;
+  s.id=7;
+  s.m[1]=10;
+  s.m[2]=20;
+  s.t.v=-3.5;
+
+  vector<char> buf;
+  {
+    memory_oarchive oa(buf);
+    oa<<compiled(s);
+  }
+  {
+    ostringstream os;
+    binary_oarchive oa(os);
+    oa<<s;
+    oa.flush();
+    EXPECT_TRUE(os.str()==string(buf.begin(), buf.end()));
+  }
+
+  with_free_serializers t;
+  memory_iarchive ia(&buf[0], buf.size());
+  ia>>compiled(t);
+  EXPECT_TRUE(ia);
+  EXPECT_EQ(7, t.id);
+  ASSERT_EQ(2u, t.m.size());
+  EXPECT_EQ(10, t.m[1]);
+  EXPECT_EQ(20, t.m[2]);
+  EXPECT_EQ(-3.5, t.t.v);
+}
+#endif
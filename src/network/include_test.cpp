@@ -1,6 +1,8 @@
 #include "mprpc.h"
 #include "http.h"
 #include "mprpc/caller.h"
+#include "mprpc/connection_pool.h"
+#include "mprpc/async_caller.h"
 #include "mprpc/exception.h"
 #include "mprpc/rpc_client.h"
 #include "mprpc/argument.h"
@@ -10,6 +12,7 @@
 #include "mprpc/socket.h"
 #include "mprpc/rpc_server.h"
 #include "mprpc/invoker.h"
+#include "mprpc/server_stats.h"
 #include "cgi/xhtml_cgi.h"
 #include "cgi/fcgi.h"
 #include "cgi/tags.h"
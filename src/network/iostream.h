@@ -32,6 +32,8 @@
 #ifndef INCLUDE_GUARD_PFI_NETWORK_IOSTREAM_H_
 #define INCLUDE_GUARD_PFI_NETWORK_IOSTREAM_H_
 
+#include <algorithm>
+#include <cstring>
 #include <streambuf>
 #include <stdexcept>
 #include <stdint.h>
@@ -42,20 +44,26 @@
 namespace pfi{
 namespace network{
 
+// the get and put areas are the receive and send buffers of the
+// stream_socket itself, so bulk reads and writes are plain memcpy, and
+// ones larger than the buffers go to the socket directly.
+// C must be a byte-sized character type.
 template <class C, class T = std::char_traits<C> >
 class basic_socketstreambuf : public std::basic_streambuf<C,T>{
 public:
   typedef C char_type;
+  typedef typename T::int_type int_type;
 
   basic_socketstreambuf()
-    : buf(T::eof())
-    , sock(){
+    : sock(){
   }
 
   ~basic_socketstreambuf(){
+    release();
   }
 
   bool connect(const std::string &host, uint16_t port){
+    release();
     pfi::lang::shared_ptr<stream_socket> sock(new stream_socket());
     this->sock=
       pfi::lang::shared_ptr<socket_holder>
@@ -82,6 +90,7 @@ private:
 public:
   template <class PSOCK>
   void setsock(PSOCK sock){
+    release();
     this->sock=pfi::lang::shared_ptr<socket_holder>(new socket_holder_impl<PSOCK>(sock));
   }
 
@@ -97,41 +106,113 @@ public:
   // virtual protected members
 
   std::streamsize xsputn(const char_type *s, std::streamsize n){
-    if (!sock->get()) return 0;
-    int res=sock->get()->write(s, sizeof(char_type)*n);
-    if (res<0) return 0;
-    return res;
+    if (!sock || !sock->get()) return 0;
+
+    std::streamsize done=0;
+    while(done<n){
+      std::streamsize avail=this->epptr()-this->pptr();
+      if (avail==0){
+        commit();
+        // large writes bypass the buffer
+        if (n-done>=kDirectWriteSize){
+          int res=sock->get()->write(s+done, sizeof(char_type)*(n-done));
+          if (res>0) done+=res;
+          break;
+        }
+        char *p;
+        int m=sock->get()->write_buffer(&p);
+        if (m<=0) break;
+        this->setp(reinterpret_cast<char_type*>(p), reinterpret_cast<char_type*>(p+m));
+        avail=m;
+      }
+      std::streamsize m=std::min(avail, n-done);
+      std::memcpy(this->pptr(), s+done, sizeof(char_type)*m);
+      this->pbump(m);
+      done+=m;
+    }
+    return done;
   }
 
-  int overflow(int c){
-    if (!sock->get()) return T::eof();
-    char d=static_cast<char>(c);
-    int res=sock->get()->write(&d, sizeof(char_type));
-    if (res<0) return T::eof();
-    return res==0?T::eof():0;
+  int_type overflow(int_type c){
+    if (!sock || !sock->get()) return T::eof();
+    commit();
+
+    char *p;
+    int n=sock->get()->write_buffer(&p);
+    if (n<=0) return T::eof();
+    this->setp(reinterpret_cast<char_type*>(p), reinterpret_cast<char_type*>(p+n));
+
+    if (!T::eq_int_type(c, T::eof())){
+      *this->pptr()=T::to_char_type(c);
+      this->pbump(1);
+    }
+    return T::not_eof(c);
   }
 
   int sync(){
+    if (!sock || !sock->get()) return -1;
+    commit();
     int res=sock->get()->flush();
     return res<0?0:-1;
   }
 
-  int uflow(){
-    int ret=underflow();
-    buf=T::eof();
-    return ret;
+  int_type underflow(){
+    if (this->gptr()<this->egptr())
+      return T::to_int_type(*this->gptr());
+    if (!sock || !sock->get()) return T::eof();
+
+    const char *p;
+    int n=sock->get()->take_read_buffer(&p);
+    if (n<=0){
+      this->setg(NULL, NULL, NULL);
+      return T::eof();
+    }
+    char_type *b=const_cast<char_type*>(reinterpret_cast<const char_type*>(p));
+    this->setg(b, b, b+n);
+    return T::to_int_type(*this->gptr());
   }
 
-  int underflow(){
-    if (buf==T::eof()){
-      if (!sock->get()) return T::eof();
-      buf=sock->get()->getc();
+  std::streamsize xsgetn(char_type *s, std::streamsize n){
+    std::streamsize done=0;
+    while(done<n){
+      std::streamsize avail=this->egptr()-this->gptr();
+      if (avail==0){
+        // large reads bypass the buffer
+        if (n-done>=kDirectReadSize && sock && sock->get()){
+          int res=sock->get()->read(s+done, sizeof(char_type)*(n-done));
+          if (res>0) done+=res;
+          break;
+        }
+        if (T::eq_int_type(underflow(), T::eof())) break;
+        avail=this->egptr()-this->gptr();
+      }
+      std::streamsize m=std::min(avail, n-done);
+      std::memcpy(s+done, this->gptr(), sizeof(char_type)*m);
+      this->gbump(m);
+      done+=m;
     }
-    return buf;
+    return done;
   }
 
 private:
-  int buf;
+  static const std::streamsize kDirectReadSize=4096;
+  static const std::streamsize kDirectWriteSize=8192;
+
+  // hands the written part of the put area to the socket
+  void commit(){
+    std::streamsize n=this->pptr()-this->pbase();
+    if (n>0 && sock && sock->get())
+      sock->get()->commit_write_buffer(n);
+    this->setp(NULL, NULL);
+  }
+
+  // the areas point into the socket's buffers, so they are dropped
+  // before the socket is replaced or released
+  void release(){
+    commit();
+    this->setg(NULL, NULL, NULL);
+  }
+
   pfi::lang::shared_ptr<socket_holder> sock;
 };
 
@@ -53,9 +53,11 @@
                 name() : rpc_client("",0,0) \
                 { \
                         call_##name = call<__VA_ARGS__>(#name); \
+                        call_##name##_async = call_async<__VA_ARGS__>(#name); \
                 } \
         \
                 pfi::lang::function<__VA_ARGS__> call_##name; \
+                pfi::lang::function<pfi::network::mprpc::async_signature<__VA_ARGS__>::type> call_##name##_async; \
         }; \
         }
 
@@ -73,6 +75,8 @@
         public: \
                 base##_client(const std::string& host, uint16_t port, double timeout_sec) : \
                         rpc_client(host, port, timeout_sec) { } \
+                base##_client(const std::string& host, uint16_t port, double timeout_sec, size_t pool_size) : \
+                        rpc_client(host, port, timeout_sec, pool_size) { } \
         }; \
         } \
         typedef _client_impl::base##_client base##_client;
@@ -0,0 +1,396 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_ASYNC_CALLER_H_
+#define INCLUDE_GUARD_PFI_NETWORK_MPRPC_ASYNC_CALLER_H_
+
+#include "../../lang/shared_ptr.h"
+#include "../../lang/bind.h"
+#include "../../lang/function.h"
+#include "exception.h"
+#include "rpc_stream.h"
+#include "argument.h"
+#include "caller.h"
+
+namespace pfi {
+namespace network {
+namespace mprpc {
+
+
+template <class R>
+class rpc_future {
+public:
+  rpc_future() { }
+
+  rpc_future(const pfi::lang::shared_ptr<rpc_stream>& rs, uint32_t msgid) :
+    st(new state(rs, msgid)) { }
+
+  // waits for the response and returns the result.
+  // the result can be retrieved only once.
+  R get()
+  {
+    if(!st) {
+      throw rpc_error("rpc future has no request");
+    }
+    return st->get();
+  }
+
+private:
+  struct state {
+    state(const pfi::lang::shared_ptr<rpc_stream>& rs, uint32_t msgid) :
+      rs(rs), msgid(msgid), done(false) { }
+
+    ~state()
+    {
+      if(!done) {
+        rs->forget(msgid);
+      }
+    }
+
+    R get()
+    {
+      if(done) {
+        throw rpc_error("rpc result is already retrieved");
+      }
+      done = true;
+
+      rpc_response res;
+      if(!rs->join(msgid, &res)) {
+        throw rpc_error("cannot receive rpc result");
+      }
+      if(res.is_error()) {
+        gen_exception(res);
+      }
+
+      R ret;
+      if(!res.result_as(&ret)) {
+        throw rpc_type_error("cannot recv rpc result: type error");
+      }
+      return ret;
+    }
+
+    pfi::lang::shared_ptr<rpc_stream> rs;
+    uint32_t msgid;
+    bool done;
+  };
+
+  pfi::lang::shared_ptr<state> st;
+};
+
+
+template <class T>
+struct async_signature;
+
+template <class R>
+struct async_signature<R()> {
+  typedef rpc_future<R> type();
+};
+
+template <class R, class A1>
+struct async_signature<R(A1)> {
+  typedef rpc_future<R> type(A1);
+};
+
+template <class R, class A1, class A2>
+struct async_signature<R(A1, A2)> {
+  typedef rpc_future<R> type(A1, A2);
+};
+
+template <class R, class A1, class A2, class A3>
+struct async_signature<R(A1, A2, A3)> {
+  typedef rpc_future<R> type(A1, A2, A3);
+};
+
+template <class R, class A1, class A2, class A3, class A4>
+struct async_signature<R(A1, A2, A3, A4)> {
+  typedef rpc_future<R> type(A1, A2, A3, A4);
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5>
+struct async_signature<R(A1, A2, A3, A4, A5)> {
+  typedef rpc_future<R> type(A1, A2, A3, A4, A5);
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6>
+struct async_signature<R(A1, A2, A3, A4, A5, A6)> {
+  typedef rpc_future<R> type(A1, A2, A3, A4, A5, A6);
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+struct async_signature<R(A1, A2, A3, A4, A5, A6, A7)> {
+  typedef rpc_future<R> type(A1, A2, A3, A4, A5, A6, A7);
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+struct async_signature<R(A1, A2, A3, A4, A5, A6, A7, A8)> {
+  typedef rpc_future<R> type(A1, A2, A3, A4, A5, A6, A7, A8);
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+struct async_signature<R(A1, A2, A3, A4, A5, A6, A7, A8, A9)> {
+  typedef rpc_future<R> type(A1, A2, A3, A4, A5, A6, A7, A8, A9);
+};
+
+#define DO_ASYNC_RPC(param) \
+  uint32_t msgid; \
+  if(!rs->send(name, param, &msgid)) { \
+    throw rpc_io_error("cannot send rpc request: ",errno); \
+  } \
+  \
+  return rpc_future<R>(rs, msgid);
+
+template <class R>
+class async_caller0 {
+public:
+  async_caller0(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call() {
+    GET_CONN;
+    argument0 param;
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R>
+pfi::lang::function<rpc_future<R>()> make_async_caller(const pfi::lang::function<R()> &, const method_key &name, stream_getter sg)
+{
+  async_caller0<R> c(name, sg);
+  return pfi::lang::bind(&async_caller0<R>::call, c);
+}
+
+template <class R, class A1>
+class async_caller1 {
+public:
+  async_caller1(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1) {
+    GET_CONN;
+    argument1<A1> param(a1);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1>
+pfi::lang::function<rpc_future<R>(A1)> make_async_caller(const pfi::lang::function<R(A1)> &, const method_key &name, stream_getter sg)
+{
+  async_caller1<R,A1> c(name, sg);
+  return pfi::lang::bind(&async_caller1<R,A1>::call, c, pfi::lang::_1);
+}
+
+template <class R, class A1, class A2>
+class async_caller2 {
+public:
+  async_caller2(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2) {
+    GET_CONN;
+    argument2<A1, A2> param(a1, a2);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2>
+pfi::lang::function<rpc_future<R>(A1, A2)> make_async_caller(const pfi::lang::function<R(A1, A2)> &, const method_key &name, stream_getter sg)
+{
+  async_caller2<R,A1, A2> c(name, sg);
+  return pfi::lang::bind(&async_caller2<R,A1, A2>::call, c, pfi::lang::_1, pfi::lang::_2);
+}
+
+template <class R, class A1, class A2, class A3>
+class async_caller3 {
+public:
+  async_caller3(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3) {
+    GET_CONN;
+    argument3<A1, A2, A3> param(a1, a2, a3);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3>
+pfi::lang::function<rpc_future<R>(A1, A2, A3)> make_async_caller(const pfi::lang::function<R(A1, A2, A3)> &, const method_key &name, stream_getter sg)
+{
+  async_caller3<R,A1, A2, A3> c(name, sg);
+  return pfi::lang::bind(&async_caller3<R,A1, A2, A3>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3);
+}
+
+template <class R, class A1, class A2, class A3, class A4>
+class async_caller4 {
+public:
+  async_caller4(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3, A4 a4) {
+    GET_CONN;
+    argument4<A1, A2, A3, A4> param(a1, a2, a3, a4);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3, class A4>
+pfi::lang::function<rpc_future<R>(A1, A2, A3, A4)> make_async_caller(const pfi::lang::function<R(A1, A2, A3, A4)> &, const method_key &name, stream_getter sg)
+{
+  async_caller4<R,A1, A2, A3, A4> c(name, sg);
+  return pfi::lang::bind(&async_caller4<R,A1, A2, A3, A4>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4);
+}
+
+template <class R, class A1, class A2, class A3, class A4, class A5>
+class async_caller5 {
+public:
+  async_caller5(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5) {
+    GET_CONN;
+    argument5<A1, A2, A3, A4, A5> param(a1, a2, a3, a4, a5);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5>
+pfi::lang::function<rpc_future<R>(A1, A2, A3, A4, A5)> make_async_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5)> &, const method_key &name, stream_getter sg)
+{
+  async_caller5<R,A1, A2, A3, A4, A5> c(name, sg);
+  return pfi::lang::bind(&async_caller5<R,A1, A2, A3, A4, A5>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5);
+}
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6>
+class async_caller6 {
+public:
+  async_caller6(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6) {
+    GET_CONN;
+    argument6<A1, A2, A3, A4, A5, A6> param(a1, a2, a3, a4, a5, a6);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6>
+pfi::lang::function<rpc_future<R>(A1, A2, A3, A4, A5, A6)> make_async_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6)> &, const method_key &name, stream_getter sg)
+{
+  async_caller6<R,A1, A2, A3, A4, A5, A6> c(name, sg);
+  return pfi::lang::bind(&async_caller6<R,A1, A2, A3, A4, A5, A6>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6);
+}
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+class async_caller7 {
+public:
+  async_caller7(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7) {
+    GET_CONN;
+    argument7<A1, A2, A3, A4, A5, A6, A7> param(a1, a2, a3, a4, a5, a6, a7);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+pfi::lang::function<rpc_future<R>(A1, A2, A3, A4, A5, A6, A7)> make_async_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7)> &, const method_key &name, stream_getter sg)
+{
+  async_caller7<R,A1, A2, A3, A4, A5, A6, A7> c(name, sg);
+  return pfi::lang::bind(&async_caller7<R,A1, A2, A3, A4, A5, A6, A7>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6, pfi::lang::_7);
+}
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+class async_caller8 {
+public:
+  async_caller8(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8) {
+    GET_CONN;
+    argument8<A1, A2, A3, A4, A5, A6, A7, A8> param(a1, a2, a3, a4, a5, a6, a7, a8);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+pfi::lang::function<rpc_future<R>(A1, A2, A3, A4, A5, A6, A7, A8)> make_async_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8)> &, const method_key &name, stream_getter sg)
+{
+  async_caller8<R,A1, A2, A3, A4, A5, A6, A7, A8> c(name, sg);
+  return pfi::lang::bind(&async_caller8<R,A1, A2, A3, A4, A5, A6, A7, A8>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6, pfi::lang::_7, pfi::lang::_8);
+}
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+class async_caller9 {
+public:
+  async_caller9(const method_key &name, stream_getter sg) :
+    name(name), sg(sg) { }
+  rpc_future<R> call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9) {
+    GET_CONN;
+    argument9<A1, A2, A3, A4, A5, A6, A7, A8, A9> param(a1, a2, a3, a4, a5, a6, a7, a8, a9);
+    DO_ASYNC_RPC(param);
+  }
+private:
+  method_key name;
+  stream_getter sg;
+};
+
+template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+pfi::lang::function<rpc_future<R>(A1, A2, A3, A4, A5, A6, A7, A8, A9)> make_async_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8, A9)> &, const method_key &name, stream_getter sg)
+{
+  async_caller9<R,A1, A2, A3, A4, A5, A6, A7, A8, A9> c(name, sg);
+  return pfi::lang::bind(&async_caller9<R,A1, A2, A3, A4, A5, A6, A7, A8, A9>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6, pfi::lang::_7, pfi::lang::_8, pfi::lang::_9);
+}
+
+
+
+}  // namespace mprpc
+}  // namespace network
+}  // namespace pfi
+
+#endif // #ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_ASYNC_CALLER_H_
@@ -81,7 +81,7 @@ static void gen_exception(const rpc_response& res)
 template <class R>
 class caller0 {
 public:
-  caller0(const std::string &name, stream_getter sg) :
+  caller0(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call() {
     GET_CONN;
@@ -89,12 +89,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R>
-pfi::lang::function<R()> make_caller(const pfi::lang::function<R()> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R()> make_caller(const pfi::lang::function<R()> &, const method_key &name, stream_getter sg)
 {
   caller0<R> c(name, sg);
   return pfi::lang::bind(&caller0<R>::call, c);
@@ -103,7 +103,7 @@ pfi::lang::function<R()> make_caller(const pfi::lang::function<R()> &, const std
 template <class R, class A1>
 class caller1 {
 public:
-  caller1(const std::string &name, stream_getter sg) :
+  caller1(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1) {
     GET_CONN;
@@ -111,12 +111,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1>
-pfi::lang::function<R(A1)> make_caller(const pfi::lang::function<R(A1)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1)> make_caller(const pfi::lang::function<R(A1)> &, const method_key &name, stream_getter sg)
 {
   caller1<R,A1> c(name, sg);
   return pfi::lang::bind(&caller1<R,A1>::call, c, pfi::lang::_1);
@@ -125,7 +125,7 @@ pfi::lang::function<R(A1)> make_caller(const pfi::lang::function<R(A1)> &, const
 template <class R, class A1, class A2>
 class caller2 {
 public:
-  caller2(const std::string &name, stream_getter sg) :
+  caller2(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2) {
     GET_CONN;
@@ -133,12 +133,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2>
-pfi::lang::function<R(A1, A2)> make_caller(const pfi::lang::function<R(A1, A2)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2)> make_caller(const pfi::lang::function<R(A1, A2)> &, const method_key &name, stream_getter sg)
 {
   caller2<R,A1, A2> c(name, sg);
   return pfi::lang::bind(&caller2<R,A1, A2>::call, c, pfi::lang::_1, pfi::lang::_2);
@@ -147,7 +147,7 @@ pfi::lang::function<R(A1, A2)> make_caller(const pfi::lang::function<R(A1, A2)>
 template <class R, class A1, class A2, class A3>
 class caller3 {
 public:
-  caller3(const std::string &name, stream_getter sg) :
+  caller3(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3) {
     GET_CONN;
@@ -155,12 +155,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3>
-pfi::lang::function<R(A1, A2, A3)> make_caller(const pfi::lang::function<R(A1, A2, A3)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3)> make_caller(const pfi::lang::function<R(A1, A2, A3)> &, const method_key &name, stream_getter sg)
 {
   caller3<R,A1, A2, A3> c(name, sg);
   return pfi::lang::bind(&caller3<R,A1, A2, A3>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3);
@@ -169,7 +169,7 @@ pfi::lang::function<R(A1, A2, A3)> make_caller(const pfi::lang::function<R(A1, A
 template <class R, class A1, class A2, class A3, class A4>
 class caller4 {
 public:
-  caller4(const std::string &name, stream_getter sg) :
+  caller4(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3, A4 a4) {
     GET_CONN;
@@ -177,12 +177,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3, class A4>
-pfi::lang::function<R(A1, A2, A3, A4)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3, A4)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4)> &, const method_key &name, stream_getter sg)
 {
   caller4<R,A1, A2, A3, A4> c(name, sg);
   return pfi::lang::bind(&caller4<R,A1, A2, A3, A4>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4);
@@ -191,7 +191,7 @@ pfi::lang::function<R(A1, A2, A3, A4)> make_caller(const pfi::lang::function<R(A
 template <class R, class A1, class A2, class A3, class A4, class A5>
 class caller5 {
 public:
-  caller5(const std::string &name, stream_getter sg) :
+  caller5(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5) {
     GET_CONN;
@@ -199,12 +199,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3, class A4, class A5>
-pfi::lang::function<R(A1, A2, A3, A4, A5)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3, A4, A5)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5)> &, const method_key &name, stream_getter sg)
 {
   caller5<R,A1, A2, A3, A4, A5> c(name, sg);
   return pfi::lang::bind(&caller5<R,A1, A2, A3, A4, A5>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5);
@@ -213,7 +213,7 @@ pfi::lang::function<R(A1, A2, A3, A4, A5)> make_caller(const pfi::lang::function
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6>
 class caller6 {
 public:
-  caller6(const std::string &name, stream_getter sg) :
+  caller6(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6) {
     GET_CONN;
@@ -221,12 +221,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6>
-pfi::lang::function<R(A1, A2, A3, A4, A5, A6)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3, A4, A5, A6)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6)> &, const method_key &name, stream_getter sg)
 {
   caller6<R,A1, A2, A3, A4, A5, A6> c(name, sg);
   return pfi::lang::bind(&caller6<R,A1, A2, A3, A4, A5, A6>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6);
@@ -235,7 +235,7 @@ pfi::lang::function<R(A1, A2, A3, A4, A5, A6)> make_caller(const pfi::lang::func
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
 class caller7 {
 public:
-  caller7(const std::string &name, stream_getter sg) :
+  caller7(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7) {
     GET_CONN;
@@ -243,12 +243,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
-pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7)> &, const method_key &name, stream_getter sg)
 {
   caller7<R,A1, A2, A3, A4, A5, A6, A7> c(name, sg);
   return pfi::lang::bind(&caller7<R,A1, A2, A3, A4, A5, A6, A7>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6, pfi::lang::_7);
@@ -257,7 +257,7 @@ pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7)> make_caller(const pfi::lang::
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
 class caller8 {
 public:
-  caller8(const std::string &name, stream_getter sg) :
+  caller8(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8) {
     GET_CONN;
@@ -265,12 +265,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
-pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8)> &, const method_key &name, stream_getter sg)
 {
   caller8<R,A1, A2, A3, A4, A5, A6, A7, A8> c(name, sg);
   return pfi::lang::bind(&caller8<R,A1, A2, A3, A4, A5, A6, A7, A8>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6, pfi::lang::_7, pfi::lang::_8);
@@ -279,7 +279,7 @@ pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8)> make_caller(const pfi::la
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
 class caller9 {
 public:
-  caller9(const std::string &name, stream_getter sg) :
+  caller9(const method_key &name, stream_getter sg) :
     name(name), sg(sg) { }
   R call(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9) {
     GET_CONN;
@@ -287,12 +287,12 @@ public:
     DO_RPC(param);
   }
 private:
-  std::string name;
+  method_key name;
   stream_getter sg;
 };
 
 template <class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
-pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8, A9)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8, A9)> &, const std::string &name, stream_getter sg)
+pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8, A9)> make_caller(const pfi::lang::function<R(A1, A2, A3, A4, A5, A6, A7, A8, A9)> &, const method_key &name, stream_getter sg)
 {
   caller9<R,A1, A2, A3, A4, A5, A6, A7, A8, A9> c(name, sg);
   return pfi::lang::bind(&caller9<R,A1, A2, A3, A4, A5, A6, A7, A8, A9>::call, c, pfi::lang::_1, pfi::lang::_2, pfi::lang::_3, pfi::lang::_4, pfi::lang::_5, pfi::lang::_6, pfi::lang::_7, pfi::lang::_8, pfi::lang::_9);
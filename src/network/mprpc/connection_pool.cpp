@@ -0,0 +1,239 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "connection_pool.h"
+
+#include <vector>
+#include <errno.h>
+
+#include "../../lang/bind.h"
+#include "socket.h"
+
+namespace pfi {
+namespace network {
+namespace mprpc {
+
+// slot values other than idle connections
+static rpc_stream* const EMPTY = NULL;
+static rpc_stream* const BUSY = reinterpret_cast<rpc_stream*>(1);
+
+static const double kCheckSleepSec = 0.1;
+
+
+struct connection_pool::impl {
+  impl(const std::string& host, uint16_t port, double timeout_sec,
+       size_t size, double check_interval_sec) :
+    host(host), port(port), timeout_sec(timeout_sec),
+    check_interval_sec(check_interval_sec),
+    slots(size, EMPTY), next(0), running(true) { }
+
+  ~impl()
+  {
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (slots[i] != EMPTY && slots[i] != BUSY) {
+        delete slots[i];
+      }
+    }
+  }
+
+  // takes the connection in slot i if it is in state from
+  bool take(size_t i, rpc_stream* from)
+  {
+    return __sync_bool_compare_and_swap(&slots[i], from, BUSY);
+  }
+
+  void put(size_t i, rpc_stream* rs)
+  {
+    __sync_synchronize();
+    slots[i] = rs;
+  }
+
+  // puts the connection back or evicts it if it is broken
+  void release(size_t i, rpc_stream* rs)
+  {
+    if (rs->is_connected()) {
+      put(i, rs);
+    } else {
+      delete rs;
+      put(i, EMPTY);
+    }
+  }
+
+  const std::string host;
+  const uint16_t port;
+  const double timeout_sec;
+  const double check_interval_sec;
+
+  std::vector<rpc_stream*> slots;
+  volatile size_t next;
+  volatile bool running;
+};
+
+struct connection_pool::returner {
+  returner(const pfi::lang::shared_ptr<impl>& p, size_t i) : p(p), i(i) { }
+
+  void operator()(rpc_stream* rs) const
+  {
+    p->release(i, rs);
+  }
+
+  pfi::lang::shared_ptr<impl> p;
+  size_t i;
+};
+
+
+connection_pool::connection_pool(const std::string& host, uint16_t port, double timeout_sec,
+                                 size_t size, double check_interval_sec) :
+  pimpl(new impl(host, port, timeout_sec, size, check_interval_sec)),
+  checker(pfi::lang::bind(&connection_pool::check, pimpl))
+{
+  checker.start();
+}
+
+connection_pool::~connection_pool()
+{
+  pimpl->running = false;
+  checker.join();
+}
+
+pfi::lang::shared_ptr<rpc_stream> connection_pool::get()
+{
+  impl& p = *pimpl;
+  const size_t n = p.slots.size();
+  const size_t start = __sync_fetch_and_add(&p.next, 1);
+
+  // idle connections first
+  for (size_t k = 0; k < n; k++) {
+    size_t i = (start + k) % n;
+    rpc_stream* rs = p.slots[i];
+    if (rs == EMPTY || rs == BUSY || !p.take(i, rs)) {
+      continue;
+    }
+
+    if (!rs->is_connected()) {
+      delete rs;
+      p.put(i, EMPTY);
+      continue;
+    }
+    return pfi::lang::shared_ptr<rpc_stream>(rs, returner(pimpl, i));
+  }
+
+  // then connect an empty slot
+  for (size_t k = 0; k < n; k++) {
+    size_t i = (start + k) % n;
+    if (!p.take(i, EMPTY)) {
+      continue;
+    }
+
+    rpc_stream* rs = connect(p.host, p.port, p.timeout_sec);
+    if (!rs) {
+      p.put(i, EMPTY);
+      return pfi::lang::shared_ptr<rpc_stream>();
+    }
+    return pfi::lang::shared_ptr<rpc_stream>(rs, returner(pimpl, i));
+  }
+
+  return pfi::lang::shared_ptr<rpc_stream>(connect(p.host, p.port, p.timeout_sec));
+}
+
+size_t connection_pool::size() const
+{
+  return pimpl->slots.size();
+}
+
+size_t connection_pool::idle() const
+{
+  size_t ret = 0;
+  for (size_t i = 0; i < pimpl->slots.size(); i++) {
+    rpc_stream* rs = pimpl->slots[i];
+    if (rs != EMPTY && rs != BUSY) {
+      ret++;
+    }
+  }
+  return ret;
+}
+
+rpc_stream* connection_pool::connect(const std::string& host, uint16_t port, double timeout_sec)
+{
+  socket sock;
+  if(!sock.connect(host, port)) {
+    return NULL;
+  }
+
+  if(timeout_sec > 0) {
+    if(!sock.set_timeout(timeout_sec)) {
+      return NULL;
+    }
+  }
+
+  if(!sock.set_nodelay(true)) {
+    return NULL;
+  }
+
+  rpc_stream* rs = new rpc_stream(sock.get(), timeout_sec);
+  sock.release();
+  return rs;
+}
+
+void connection_pool::check(const pfi::lang::shared_ptr<impl>& pp)
+{
+  impl& p = *pp;
+  double slept = p.check_interval_sec;
+
+  while (p.running) {
+    if (slept < p.check_interval_sec) {
+      pfi::concurrent::thread::sleep(kCheckSleepSec);
+      slept += kCheckSleepSec;
+      continue;
+    }
+    slept = 0;
+
+    for (size_t i = 0; i < p.slots.size() && p.running; i++) {
+      rpc_stream* rs = p.slots[i];
+      if (rs == BUSY) {
+        continue;
+      }
+
+      if (rs == EMPTY) {
+        if (p.take(i, EMPTY)) {
+          p.put(i, connect(p.host, p.port, p.timeout_sec));
+        }
+      } else if (p.take(i, rs)) {
+        p.release(i, rs);
+      }
+    }
+  }
+}
+
+
+}  // namespace mprpc
+}  // namespace network
+}  // namespace pfi
@@ -0,0 +1,81 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_CONNECTION_POOL_H_
+#define INCLUDE_GUARD_PFI_NETWORK_MPRPC_CONNECTION_POOL_H_
+
+#include <string>
+
+#include "../../lang/shared_ptr.h"
+#include "../../lang/noncopyable.h"
+#include "../../concurrent/thread.h"
+#include "rpc_stream.h"
+
+namespace pfi {
+namespace network {
+namespace mprpc {
+
+
+// a fixed number of connections to one server shared by many threads.
+// idle connections are checked out and returned without locks, dead ones
+// are evicted and reconnected by a background thread.
+class connection_pool : pfi::lang::noncopyable {
+public:
+  connection_pool(const std::string& host, uint16_t port, double timeout_sec,
+                  size_t size, double check_interval_sec = 1.0);
+  ~connection_pool();
+
+  // the returned stream goes back to the pool when its last reference is
+  // dropped. when all the connections are in use, a temporary connection
+  // which is not pooled is returned.
+  pfi::lang::shared_ptr<rpc_stream> get();
+
+  size_t size() const;
+  size_t idle() const;
+
+  static rpc_stream* connect(const std::string& host, uint16_t port, double timeout_sec);
+
+private:
+  struct impl;
+  struct returner;
+
+  static void check(const pfi::lang::shared_ptr<impl>& p);
+
+  pfi::lang::shared_ptr<impl> pimpl;
+  pfi::concurrent::thread checker;
+};
+
+
+}  // namespace mprpc
+}  // namespace network
+}  // namespace pfi
+
+#endif // #ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_CONNECTION_POOL_H_
@@ -34,6 +34,7 @@
 
 #include "../../lang/shared_ptr.h"
 #include "../../lang/function.h"
+#include "../../system/time_util.h"
 #include "exception.h"
 #include "rpc_stream.h"
 #include "message.h"
@@ -47,7 +48,8 @@ namespace mprpc {
 class responder {
 public:
   responder(uint32_t msgid, const pfi::lang::shared_ptr<rpc_stream>& rs) :
-    msgid(msgid), rs(rs) { }
+    msgid(msgid), rs(rs), error_sent(false),
+    decoded_at(0, 0), handled_at(0, 0) { }
 
 public:
   template <typename R>
@@ -59,18 +61,32 @@ public:
   template <typename E>
   bool send_error(const E& e)
   {
+    error_sent = true;
     return rs->send_response(msgid, msgpack::type::nil(), e);
   }
 
   template <typename E, typename R>
   bool send_error(const E& e, const R& r)
   {
+    error_sent = true;
     return rs->send_response(msgid, r, e);
   }
 
+  // phase boundaries for the server metrics, marked by the invokers
+  void decoded() { decoded_at = pfi::system::time::get_clock_time(); }
+  void handled() { handled_at = pfi::system::time::get_clock_time(); }
+
+  bool has_error() const { return error_sent; }
+  const pfi::system::time::clock_time& decoded_time() const { return decoded_at; }
+  const pfi::system::time::clock_time& handled_time() const { return handled_at; }
+
 private:
   uint32_t msgid;
   pfi::lang::shared_ptr<rpc_stream> rs;
+
+  bool error_sent;
+  pfi::system::time::clock_time decoded_at;
+  pfi::system::time::clock_time handled_at;
 };
 
 
@@ -85,9 +101,11 @@ public:
   if(!req.param_as(&param)) { \
     res.send_error((unsigned int)TYPE_MISMATCH); \
     throw rpc_type_error("cannot recv argument: type error"); \
-  }
+  } \
+  res.decoded()
 
 #define SEND_RESPONSE(res, param) \
+  res.handled(); \
   if(!res.send_result(retval)) { \
     throw rpc_io_error("cannot send return value: ",errno); \
   }
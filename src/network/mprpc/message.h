@@ -70,28 +70,54 @@ public:
 };
 
 
+// a method named by its string name or by the integer id it was
+// registered with on the server (see rpc_server::add)
+struct method_key {
+  method_key(const std::string& name) : name(name), id(-1) { }
+  method_key(const char* name) : name(name), id(-1) { }
+  explicit method_key(uint32_t id) : id(id) { }
+
+  bool has_id() const { return id >= 0; }
+
+  std::string name;
+  int64_t id;
+};
+
+
 struct rpc_request {
   rpc_request(rpc_message& msg)
   {
     reset(msg);
   }
 
-  rpc_request()
+  rpc_request() :
+    method_id(-1)
   { }
 
   void reset(rpc_message& msg)
   {
     msgid  = msg.tuple.a1;
-             msg.tuple.a2.convert(&method);
+    if(msg.tuple.a2.type == msgpack::type::POSITIVE_INTEGER) {
+      method_id = msg.tuple.a2.via.u64;
+      method.clear();
+    } else {
+      method_id = -1;
+      msg.tuple.a2.convert(&method);
+    }
     param  = msg.tuple.a3;
     zone   = msg.zone;
   }
 
   template <typename ObjectWritable, typename P>
-  static bool write(ObjectWritable& o, uint32_t msgid, const std::string& name, const P& param, double timeout_sec)
+  static bool write(ObjectWritable& o, uint32_t msgid, const method_key& key, const P& param, double timeout_sec)
   {
+    if(key.has_id()) {
+      msgpack::type::tuple<uint8_t, uint32_t, uint32_t, const P&>
+        req(0, msgid, (uint32_t)key.id, param);
+      return o.write(req, timeout_sec) > 0;
+    }
     msgpack::type::tuple<uint8_t, uint32_t, const std::string&, const P&>
-      req(0, msgid, name, param);
+      req(0, msgid, key.name, param);
     return o.write(req, timeout_sec) > 0;
   }
 
@@ -106,6 +132,8 @@ struct rpc_request {
 
   uint32_t msgid;
   std::string method;
+  // the id of the method when it is sent as an integer, otherwise -1
+  int64_t method_id;
   msgpack::object param;
   std::auto_ptr<msgpack::zone> zone;
 };
@@ -33,29 +33,36 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
 #include <errno.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
 #include "socket.h"
 #include "exception.h"
+#include "../../system/syscall.h"
 #include "../../system/time_util.h"
 
 using pfi::system::time::clock_time;
 using pfi::system::time::get_clock_time;
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
 namespace pfi {
 namespace network {
 namespace mprpc {
 
 
 object_stream::object_stream(int iofd) :
-  iofd(iofd)
+  vbuf_bytes(0), iofd(iofd), failed(false)
 { }
 
 object_stream::object_stream(const std::string& host, uint16_t port) :
-  iofd(socket::connect_sock(host, port))
+  vbuf_bytes(0), iofd(socket::connect_sock(host, port)), failed(false)
 { }
 
 object_stream::~object_stream()
@@ -69,10 +76,7 @@ int object_stream::read(msgpack::object* obj, std::auto_ptr<msgpack::zone>* zone
 {
   clock_time start = get_clock_time();
   while(true) {
-    if(unpacker.execute()) {
-      *obj = unpacker.data();
-      zone->reset( unpacker.release_zone() );
-      unpacker.reset();
+    if(read_buffered(obj, zone)) {
       return 1;
     }
 
@@ -82,12 +86,14 @@ int object_stream::read(msgpack::object* obj, std::auto_ptr<msgpack::zone>* zone
     while(true) {
       rl = ::read(iofd, unpacker.buffer(), unpacker.buffer_capacity());
       if(rl > 0) break;
-      if(rl == 0) { return -1; }
+      if(rl == 0) { failed = true; return -1; }
       if(errno == EINTR) { continue; }
       if(timeout_sec < (double)(get_clock_time() - start)){
+        failed = true;
         throw rpc_timeout_error("timeout");
       }
       if(errno == EAGAIN) { continue; }
+      failed = true;
       return -1;
     }
 
@@ -95,30 +101,120 @@ int object_stream::read(msgpack::object* obj, std::auto_ptr<msgpack::zone>* zone
   }
 }
 
+int object_stream::read_some()
+{
+  unpacker.reserve_buffer(1024);
+
+  ssize_t rl;
+  while(true) {
+    rl = ::read(iofd, unpacker.buffer(), unpacker.buffer_capacity());
+    if(rl > 0) break;
+    if(rl == 0) { failed = true; return -1; }
+    if(errno == EINTR) { continue; }
+    if(errno == EAGAIN) { return 0; }
+    failed = true;
+    return -1;
+  }
+
+  unpacker.buffer_consumed(rl);
+  return rl;
+}
+
+int object_stream::read_buffered(msgpack::object* obj, std::auto_ptr<msgpack::zone>* zone)
+{
+  if(!unpacker.execute()) {
+    return 0;
+  }
+
+  *obj = unpacker.data();
+  zone->reset( unpacker.release_zone() );
+  unpacker.reset();
+  return 1;
+}
+
+bool object_stream::is_connected() const
+{
+  if(failed) {
+    return false;
+  }
+
+  char c;
+  ssize_t rl;
+  NO_INTR(rl, ::recv(iofd, &c, 1, MSG_PEEK | MSG_DONTWAIT));
+  if(rl > 0) {
+    return true;
+  }
+  return rl < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+int object_stream::flush_queue(double timeout_sec)
+{
+  if(vbuf.vector_size() == 0) {
+    return 0;
+  }
+
+  int ret;
+  try {
+    ret = write(vbuf.vector(), vbuf.vector_size(), timeout_sec);
+  } catch (rpc_error&) {
+    vbuf.clear();
+    vbuf_bytes = 0;
+    throw;
+  }
+  vbuf.clear();
+  vbuf_bytes = 0;
+  return ret;
+}
+
 int object_stream::write(const void* data, size_t size, double timeout_sec)
 {
-  const char* p = static_cast<const char*>(data);
-  const char* const pend = p + size;
+  struct iovec vec;
+  vec.iov_base = const_cast<void*>(data);
+  vec.iov_len = size;
+  return write(&vec, 1, timeout_sec);
+}
+
+int object_stream::write(const struct iovec* vec, size_t veclen, double timeout_sec)
+{
+  size_t size = 0;
+  size_t i = 0, off = 0;
   clock_time start = get_clock_time();
-  while(p < pend) {
-    ssize_t rl = ::write(iofd, p, pend-p);
+  while(i < veclen) {
+    ssize_t rl;
+    if(off == 0) {
+      rl = ::writev(iofd, vec + i, std::min<size_t>(veclen - i, IOV_MAX));
+    } else {
+      // the rest of a partially written buffer
+      rl = ::write(iofd, static_cast<const char*>(vec[i].iov_base) + off,
+                   vec[i].iov_len - off);
+    }
     if(rl <= 0) {
       if(rl == 0) {
+        failed = true;
         return -1;
       }
       if(errno == EINTR) { continue; }
       if(timeout_sec < (double)(get_clock_time() - start)){
+        failed = true;
         throw rpc_timeout_error("timeout");
       }
       if(errno == EAGAIN) { continue; }
+      failed = true;
       return -1;
     }
-    p += rl;
+
+    size += rl;
+    size_t n = rl;
+    while(i < veclen && n >= vec[i].iov_len - off) {
+      n -= vec[i].iov_len - off;
+      off = 0;
+      i++;
+    }
+    off += n;
   }
   return size;
 }
 
-
 }  // namespace mprpc
 }  // namespace network
 }  // namespace pfi
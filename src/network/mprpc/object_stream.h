@@ -33,6 +33,7 @@
 #define INCLUDE_GUARD_PFI_NETWORK_MPRPC_OBJECT_STREAM_H_
 
 #include <memory>
+#include <sys/uio.h>
 
 #include <msgpack.hpp>
 
@@ -50,22 +51,74 @@ public:
   int read(msgpack::object* obj, std::auto_ptr<msgpack::zone>* zone,
   double timeout_sec);
 
+  // for event-driven readers: read_some() issues at most one read(2) and
+  // read_buffered() extracts an object only from data already buffered
+  int read_some();
+  int read_buffered(msgpack::object* obj, std::auto_ptr<msgpack::zone>* zone);
+
+  // large raw fields of v are not copied but referenced by the buffer and
+  // sent with writev(2), so v must not be modified by others while writing.
+  // not thread safe since the buffer is shared by all the writes
   template <typename T>
   int write(const T& v, double timeout_sec);
 
   int write(const void* data, size_t size, double timeout_sec);
+  int write(const struct iovec* vec, size_t veclen, double timeout_sec);
+
+  // for coalescing: queue() packs v after the messages queued so far, and
+  // flush_queue() sends them all with writev(2). raw fields of copy_limit
+  // bytes or more are referenced rather than copied, and then queue()
+  // returns true: the queue must be flushed before v is modified.
+  // write(v) sends the queue too.
+  template <typename T>
+  bool queue(const T& v, size_t copy_limit);
+  size_t queued_bytes() const { return vbuf_bytes; }
+  int flush_queue(double timeout_sec);
+
+  // false after an I/O error or once the peer has closed the connection
+  bool is_connected() const;
 
 private:
+  // packs into vbuf, copying pieces shorter than copy_limit
+  struct queue_writer {
+    queue_writer(object_stream& os, size_t copy_limit)
+      : os(os), copy_limit(copy_limit), referenced(false) {}
+
+    void write(const char* p, size_t n) {
+      if(n < copy_limit) {
+        os.vbuf.append_copy(p, n);
+      } else {
+        os.vbuf.append_ref(p, n);
+        referenced = true;
+      }
+      os.vbuf_bytes += n;
+    }
+
+    object_stream& os;
+    size_t copy_limit;
+    bool referenced;
+  };
+
   msgpack::unpacker unpacker;
+  msgpack::vrefbuffer vbuf;
+  size_t vbuf_bytes;
   int iofd;
+  bool failed;
 };
 
 template <typename T>
 int object_stream::write(const T& v, double timeout_sec)
 {
-  msgpack::sbuffer sbuf;
-  msgpack::pack(sbuf, v);
-  return write(sbuf.data(), sbuf.size(), timeout_sec);
+  msgpack::pack(vbuf, v);
+  return flush_queue(timeout_sec);
+}
+
+template <typename T>
+bool object_stream::queue(const T& v, size_t copy_limit)
+{
+  queue_writer w(*this, copy_limit);
+  msgpack::pack(w, v);
+  return w.referenced;
 }
 
 
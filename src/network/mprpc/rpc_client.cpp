@@ -31,47 +31,53 @@
 
 #include "rpc_client.h"
 
-#include "socket.h"
-
 namespace pfi {
 namespace network {
 namespace mprpc {
 
 
 rpc_client::rpc_client(const std::string& host, uint16_t port, double timeout_sec) :
-  host(host), port(port), timeout_sec(timeout_sec)
+  host(host), port(port), timeout_sec(timeout_sec),
+  coalesce_window_sec(0), coalesce_bytes(0), stats(new coalescing_stats())
+{ }
+
+rpc_client::rpc_client(const std::string& host, uint16_t port, double timeout_sec,
+                       size_t pool_size) :
+  host(host), port(port), timeout_sec(timeout_sec),
+  coalesce_window_sec(0), coalesce_bytes(0), stats(new coalescing_stats()),
+  pool(new connection_pool(host, port, timeout_sec, pool_size))
 { }
 
 rpc_client::~rpc_client() { }
 
 
-pfi::lang::shared_ptr<rpc_stream> rpc_client::get_connection()
+void rpc_client::set_coalescing(double window_sec, size_t max_bytes)
 {
-  if(ss) { return ss; }
-
-  for (int i=0; i < 2; i++){
-    socket sock;
-    if(!sock.connect(host, port)) {
-      continue;
-    }
+  coalesce_window_sec = window_sec;
+  coalesce_bytes = max_bytes;
+}
 
-    if(timeout_sec > 0) {
-      if(!sock.set_timeout(timeout_sec)) {
-        continue;
-      }
-    }
+coalescing_stats rpc_client::get_coalescing_stats() const
+{
+  return stats->snapshot();
+}
 
-    if(!sock.set_nodelay(true)) {
-      continue;
+pfi::lang::shared_ptr<rpc_stream> rpc_client::get_connection()
+{
+  pfi::lang::shared_ptr<rpc_stream> rs;
+  if(pool) {
+    rs = pool->get();
+  } else {
+    for (int i=0; !ss && i < 2; i++){
+      ss.reset(connection_pool::connect(host, port, timeout_sec));
     }
-
-    ss.reset( new rpc_stream(sock.get(), timeout_sec) );
-    sock.release();
-
-    break;
+    rs = ss;
   }
 
-  return ss;
+  if(rs) {
+    rs->set_coalescing(coalesce_window_sec, coalesce_bytes, stats);
+  }
+  return rs;
 }
 
 
@@ -36,6 +36,8 @@
 #include "../../lang/function.h"
 #include "../../lang/shared_ptr.h"
 #include "caller.h"
+#include "async_caller.h"
+#include "connection_pool.h"
 
 namespace pfi {
 namespace network {
@@ -45,17 +47,42 @@ namespace mprpc {
 class rpc_client {
 public:
   rpc_client(const std::string &host, uint16_t port, double timeout_sec);
+  // a client with a connection pool of pool_size connections.
+  // it can be called from many threads concurrently.
+  rpc_client(const std::string &host, uint16_t port, double timeout_sec, size_t pool_size);
   ~rpc_client();
 
   template <class T>
   pfi::lang::function<T> call(const std::string &name);
 
+  // returns a function that sends the request and returns an rpc_future
+  // without waiting for the response, e.g. call_async<int(int)> returns
+  // function<rpc_future<int>(int)>
+  template <class T>
+  pfi::lang::function<typename async_signature<T>::type> call_async(const std::string &name);
+
+  // call a method by the integer id it was registered with on the server,
+  // which saves sending and looking up its name
+  template <class T>
+  pfi::lang::function<T> call(uint32_t id);
+  template <class T>
+  pfi::lang::function<typename async_signature<T>::type> call_async(uint32_t id);
+
+  // coalesces the requests, see rpc_stream::set_coalescing.
+  // useful with call_async, which sends requests without waiting
+  void set_coalescing(double window_sec, size_t max_bytes);
+  coalescing_stats get_coalescing_stats() const;
+
 private:
   std::string host;
   uint16_t port;
   double timeout_sec;
+  double coalesce_window_sec;
+  size_t coalesce_bytes;
+  pfi::lang::shared_ptr<coalescing_stats> stats;
 
   pfi::lang::shared_ptr<rpc_stream> ss;
+  pfi::lang::shared_ptr<connection_pool> pool;
   pfi::lang::shared_ptr<rpc_stream> get_connection();
 };
 
@@ -68,6 +95,30 @@ pfi::lang::function<T> rpc_client::call(const std::string &name)
       pfi::lang::bind(&rpc_client::get_connection, this));
 }
 
+template <class T>
+pfi::lang::function<typename async_signature<T>::type> rpc_client::call_async(const std::string &name)
+{
+  return make_async_caller(
+      pfi::lang::function<T>(), name,
+      pfi::lang::bind(&rpc_client::get_connection, this));
+}
+
+template <class T>
+pfi::lang::function<T> rpc_client::call(uint32_t id)
+{
+  return make_caller(
+      pfi::lang::function<T>(), method_key(id),
+      pfi::lang::bind(&rpc_client::get_connection, this));
+}
+
+template <class T>
+pfi::lang::function<typename async_signature<T>::type> rpc_client::call_async(uint32_t id)
+{
+  return make_async_caller(
+      pfi::lang::function<T>(), method_key(id),
+      pfi::lang::bind(&rpc_client::get_connection, this));
+}
+
 
 }  // namespace mprpc
 }  // namespace network
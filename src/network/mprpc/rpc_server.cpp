@@ -31,10 +31,13 @@
 
 #include "rpc_server.h"
 
+#include <algorithm>
 #include <vector>
 #include <signal.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -42,11 +45,18 @@
 #include "../../network/socket.h"
 #include "../../system/syscall.h"
 #include "../../concurrent/thread.h"
+#include "../../concurrent/lock.h"
+#include "../../lang/cast.h"
 
 namespace pfi {
 namespace network {
 namespace mprpc {
 
+static const int kMaxEvents = 64;
+static const int kEventTimeoutMsec = 100;
+static const double kTaskTimeoutSec = 0.1;
+static const size_t kTaskQueueSize = 1024;
+
 
 basic_server::basic_server() { }
 
@@ -66,10 +76,34 @@ bool basic_server::create(uint16_t port, int backlog)
 }
 
 
+struct rpc_server::connection {
+  connection(int fd, double timeout_sec) :
+    fd(fd), rs(new rpc_stream(fd, timeout_sec)), inflight(0) { }
+
+  int fd;
+  pfi::lang::shared_ptr<rpc_stream> rs;
+  // number of requests dispatched but not answered yet in out-of-order mode
+  int inflight;
+};
+
+struct rpc_server::task {
+  pfi::lang::shared_ptr<connection> conn;
+  std::vector<pfi::lang::shared_ptr<rpc_request> > reqs;
+};
+
+
 rpc_server::rpc_server(double timeout_sec) :
   timeout_sec(timeout_sec),
-  serv_running(false)
-{ }
+  serv_running(false),
+  out_of_order(false),
+  coalesce_window_sec(0),
+  coalesce_bytes(0),
+  stats(new coalescing_stats()),
+  epfd(-1)
+{
+  add<std::map<std::string, std::map<std::string, uint64_t> >()>(
+      "__stats", pfi::lang::bind(&rpc_server::get_method_stats, this));
+}
 
 rpc_server::~rpc_server() { }
 
@@ -88,26 +122,50 @@ bool rpc_server::serv(uint16_t port, int nthreads)
   return run(nthreads);
 }
 
+bool rpc_server::serv_reactor(uint16_t port, int io_threads, int worker_threads)
+{
+  if (!basic_server::create(port))
+    return false;
+  return run_reactor(io_threads, worker_threads);
+}
+
 bool rpc_server::run(int nthreads, bool sync)
 {
-  using pfi::lang::shared_ptr;
-  using pfi::concurrent::thread;
+  if (sock.get() < 0 || serv_running)
+    return false;
 
+  build_dispatch_table();
+  serv_running = true;
+  if (!start_threads(nthreads, pfi::lang::bind(&rpc_server::process, this))) {
+    stop();
+    join();
+    return false;
+  }
+
+  if (sync)
+    join();
+
+  return true;
+}
+
+bool rpc_server::run_reactor(int io_threads, int worker_threads, bool sync)
+{
   if (sock.get() < 0 || serv_running)
     return false;
 
+  epfd = ::epoll_create(kMaxEvents);
+  if (epfd < 0)
+    return false;
+  tasks.reset(new pfi::concurrent::pcbuf<task>(kTaskQueueSize));
+
+  build_dispatch_table();
   serv_running = true;
-  serv_threads.resize(nthreads);
-  for (int i = 0; i < nthreads; i++) {
-    serv_threads[i] = shared_ptr<thread>(new thread(
-          pfi::lang::bind(&rpc_server::process, this)));
-    if (!serv_threads[i]->start()) {
-      stop();
-      for (int j = 0; j < i; j++) {
-        serv_threads[j]->join();
-      }
-      return false;
-    }
+  if (!watch(sock.get(), true) ||
+      !start_threads(worker_threads, pfi::lang::bind(&rpc_server::process_task, this)) ||
+      !start_threads(io_threads, pfi::lang::bind(&rpc_server::process_event, this))) {
+    stop();
+    join();
+    return false;
   }
 
   if (sync)
@@ -116,6 +174,20 @@ bool rpc_server::run(int nthreads, bool sync)
   return true;
 }
 
+bool rpc_server::start_threads(int nthreads, const pfi::lang::function<void()>& f)
+{
+  using pfi::lang::shared_ptr;
+  using pfi::concurrent::thread;
+
+  for (int i = 0; i < nthreads; i++) {
+    shared_ptr<thread> t(new thread(f));
+    if (!t->start())
+      return false;
+    serv_threads.push_back(t);
+  }
+  return true;
+}
+
 bool rpc_server::running() const
 {
   return serv_running;
@@ -127,11 +199,46 @@ void rpc_server::stop()
   close();
 }
 
+void rpc_server::set_out_of_order(bool on)
+{
+  out_of_order = on;
+}
+
+void rpc_server::set_coalescing(double window_sec, size_t max_bytes)
+{
+  coalesce_window_sec = window_sec;
+  coalesce_bytes = max_bytes;
+}
+
+coalescing_stats rpc_server::get_coalescing_stats() const
+{
+  return stats->snapshot();
+}
+
+std::map<std::string, std::map<std::string, uint64_t> > rpc_server::get_method_stats() const
+{
+  std::map<std::string, std::map<std::string, uint64_t> > ret;
+  for (std::map<std::string, method>::const_iterator it = funcs.begin();
+       it != funcs.end(); ++it)
+    ret[it->first] = it->second.stats->summary();
+  return ret;
+}
+
 void rpc_server::join()
 {
   for (size_t i = 0; i < serv_threads.size(); i++)
     serv_threads[i]->join();
   serv_threads.clear();
+
+  if (epfd >= 0) {
+    ::close(epfd);
+    epfd = -1;
+    tasks.reset();
+
+    pfi::concurrent::scoped_lock lock(conns_m);
+    if (lock)
+      conns.clear();
+  }
 }
 
 void rpc_server::process()
@@ -150,6 +257,7 @@ void rpc_server::process()
     }
 
     pfi::lang::shared_ptr<rpc_stream> rs(new rpc_stream(ns.get(), timeout_sec));
+    rs->set_coalescing(coalesce_window_sec, coalesce_bytes, stats);
     ns.release();
 
     while(serv_running) {
@@ -175,30 +283,258 @@ void rpc_server::process()
   }
 }
 
+void rpc_server::process_event()
+{
+  epoll_event evs[kMaxEvents];
+
+  while(serv_running) {
+    int n = ::epoll_wait(epfd, evs, kMaxEvents, kEventTimeoutMsec);
+    for (int i = 0; i < n; i++) {
+      if (evs[i].data.fd == sock.get())
+        accept_connection();
+      else
+        receive_requests(evs[i].data.fd);
+    }
+  }
+}
+
+void rpc_server::process_task()
+{
+  while(serv_running) {
+    task t;
+    if (!tasks->pop(t, kTaskTimeoutSec))
+      continue;
+
+    for (size_t i = 0; i < t.reqs.size(); i++) {
+      try {
+        process_request(*t.reqs[i], t.conn->rs);
+      } catch (rpc_error&) {
+      }
+    }
+
+    // coalesced responses are flushed by the last worker answering the connection
+    bool flush = true;
+    if (out_of_order)
+      flush = __sync_sub_and_fetch(&t.conn->inflight, (int)t.reqs.size()) == 0;
+    if (flush) {
+      bool ok;
+      try {
+        ok = t.conn->rs->flush();
+      } catch (rpc_error&) {
+        ok = false;
+      }
+      if (!ok) {
+        close_connection(t.conn->fd);
+        continue;
+      }
+    }
+
+    if (!out_of_order && !watch(t.conn->fd, false))
+      close_connection(t.conn->fd);
+  }
+}
+
+void rpc_server::accept_connection()
+{
+  int s;
+  NO_INTR(s, ::accept(sock.get(), NULL, NULL));
+  watch(sock.get(), false);
+  if (FAILED(s)) { return; }
+  socket ns(s);
+
+  ns.set_nodelay(true);
+  if(timeout_sec > 0) {
+    if(!ns.set_timeout(timeout_sec)) {
+      return;
+    }
+  }
+
+  pfi::lang::shared_ptr<connection> conn(new connection(ns.get(), timeout_sec));
+  conn->rs->set_coalescing(coalesce_window_sec, coalesce_bytes, stats);
+  ns.release();
+
+  {
+    pfi::concurrent::scoped_lock lock(conns_m);
+    if (lock)
+      conns[s] = conn;
+  }
+
+  if (!watch(s, true))
+    close_connection(s);
+}
+
+void rpc_server::receive_requests(int fd)
+{
+  pfi::lang::shared_ptr<connection> conn;
+  {
+    pfi::concurrent::scoped_lock lock(conns_m);
+    if (lock) {
+      std::map<int, pfi::lang::shared_ptr<connection> >::iterator it = conns.find(fd);
+      if (it != conns.end())
+        conn = it->second;
+    }
+  }
+  if (!conn)
+    return;
+
+  if (conn->rs->read_some() < 0) {
+    close_connection(fd);
+    return;
+  }
+
+  std::vector<pfi::lang::shared_ptr<rpc_request> > reqs;
+  while(true) {
+    rpc_message msg;
+    int ret = conn->rs->receive_buffered(&msg);
+    if (ret < 0) {
+      close_connection(fd);
+      return;
+    }
+    if (ret == 0)
+      break;
+
+    if (msg.is_request())
+      reqs.push_back(pfi::lang::shared_ptr<rpc_request>(new rpc_request(msg)));
+  }
+
+  if (reqs.empty() || out_of_order) {
+    if (!watch(fd, false)) {
+      close_connection(fd);
+      return;
+    }
+  }
+
+  if (out_of_order) {
+    // every request becomes an independent task
+    __sync_add_and_fetch(&conn->inflight, (int)reqs.size());
+    for (size_t i = 0; i < reqs.size(); i++) {
+      task t;
+      t.conn = conn;
+      t.reqs.push_back(reqs[i]);
+      while (serv_running && !tasks->push(t, kTaskTimeoutSec))
+        ;
+    }
+  } else if (!reqs.empty()) {
+    // the worker watches the connection again after it has sent all the responses,
+    // so that requests from one connection are never processed concurrently
+    task t;
+    t.conn = conn;
+    t.reqs.swap(reqs);
+    while (serv_running && !tasks->push(t, kTaskTimeoutSec))
+      ;
+  }
+}
+
+void rpc_server::close_connection(int fd)
+{
+  ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+
+  pfi::concurrent::scoped_lock lock(conns_m);
+  if (lock)
+    conns.erase(fd);
+}
+
+bool rpc_server::watch(int fd, bool add)
+{
+  epoll_event ev = {};
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.fd = fd;
+  return ::epoll_ctl(epfd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
 void rpc_server::add(const std::string &name,
                      const pfi::lang::shared_ptr<invoker_base>& invoker)
 {
-  funcs[name] = invoker;
+  method& m = funcs[name];
+  m.invoker = invoker;
+  m.stats.reset(new method_stats());
+}
+
+void rpc_server::build_dispatch_table()
+{
+  dispatch.build(funcs.begin(), funcs.end());
+
+  dispatch_by_id.clear();
+  sparse_dispatch.clear();
+  for (std::map<uint32_t, std::string>::const_iterator it = func_ids.begin();
+       it != func_ids.end(); ++it) {
+    std::map<std::string, method>::const_iterator m = funcs.find(it->second);
+    if (m == funcs.end())
+      continue;
+    if (it->first < dense_id_limit) {
+      if (dispatch_by_id.size() <= it->first)
+        dispatch_by_id.resize(it->first + 1);
+      dispatch_by_id[it->first] = m->second;
+    } else {
+      // func_ids is sorted, and so is this
+      sparse_dispatch.push_back(std::make_pair(it->first, m->second));
+    }
+  }
+}
+
+namespace {
+
+struct id_less {
+  template <class T>
+  bool operator()(const T& a, uint32_t b) const {
+    return a.first < b;
+  }
+};
+
+} // namespace
+
+const rpc_server::method* rpc_server::find_method(uint64_t id) const
+{
+  if (id < dispatch_by_id.size())
+    return dispatch_by_id[id].invoker ? &dispatch_by_id[id] : NULL;
+  if (id > 0xFFFFFFFFULL)
+    return NULL;
+
+  const uint32_t id32 = static_cast<uint32_t>(id);
+  std::vector<std::pair<uint32_t, method> >::const_iterator it =
+    std::lower_bound(sparse_dispatch.begin(), sparse_dispatch.end(), id32, id_less());
+  if (it == sparse_dispatch.end() || it->first != id32)
+    return NULL;
+  return &it->second;
 }
 
 void rpc_server::process_request(rpc_request& req, const pfi::lang::shared_ptr<rpc_stream>& rs)
 {
+  using pfi::system::time::clock_time;
+  using pfi::system::time::get_clock_time;
+
   responder res(req.msgid, rs);
 
-  std::map<std::string, pfi::lang::shared_ptr<invoker_base> >::iterator
-    fun = funcs.find(req.method);
+  const method* fun = NULL;
+  if(req.method_id < 0) {
+    fun = dispatch.find(req.method);
+  } else {
+    fun = find_method(static_cast<uint64_t>(req.method_id));
+  }
 
-  if(fun == funcs.end()) {
+  if(!fun) {
+    if(req.method_id >= 0)
+      req.method = pfi::lang::lexical_cast<std::string>(req.method_id);
     res.send_error((unsigned int)METHOD_NOT_FOUND, req.method);
     return;
   }
 
+  method_stats& st = *fun->stats;
+  st.begin();
+  clock_time start = get_clock_time();
+  bool error = false;
+
   try {
-    fun->second->invoke(req, res);
+    fun->invoker->invoke(req, res);
   } catch (rpc_error&) {
+    error = true;
   } catch (std::exception& e) {
+    error = true;
     res.send_error(std::string(e.what()));
   }
+
+  st.end(start, res.decoded_time(), res.handled_time(), get_clock_time(),
+         error || res.has_error());
 }
 
 
@@ -34,13 +34,19 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "../../lang/shared_ptr.h"
+#include "../../lang/scoped_ptr.h"
 #include "../../lang/function.h"
 #include "../../lang/bind.h"
+#include "../../data/frozen_string_map.h"
 #include "../../concurrent/thread.h"
+#include "../../concurrent/mutex.h"
+#include "../../concurrent/pcbuf.h"
 #include "socket.h"
 #include "invoker.h"
+#include "server_stats.h"
 
 namespace pfi {
 namespace network {
@@ -75,21 +81,85 @@ public:
   void join();
   void process();
 
-
+  // event-driven mode: io_threads threads multiplex all the connections with
+  // epoll and hand decoded requests to worker_threads threads, so the number
+  // of connections is no longer bounded by the number of threads.
+  // requests from one connection are still processed in order.
+  bool serv_reactor(uint16_t port, int io_threads, int worker_threads);
+  bool run_reactor(int io_threads, int worker_threads, bool sync = true);
+
+  // when enabled, requests pipelined on one connection are dispatched to
+  // the workers of run_reactor() independently and each response is sent
+  // as soon as its handler finishes, i.e. possibly out of order.
+  // must be set before the server starts.
+  void set_out_of_order(bool on);
+
+  // coalesces the responses on every connection accepted afterwards,
+  // see rpc_stream::set_coalescing
+  void set_coalescing(double window_sec, size_t max_bytes);
+  coalescing_stats get_coalescing_stats() const;
+
+  // per-method counters and latency percentiles, see method_stats::summary.
+  // also served as the built-in method "__stats"
+  std::map<std::string, std::map<std::string, uint64_t> > get_method_stats() const;
+
+  // methods are looked up in a table built when the server starts,
+  // so they must be added before run() or run_reactor().
+  // a method added with an id can also be called by the id (see
+  // rpc_client::call), which is looked up by indexing; keep ids small.
   template <class T>
   void add(const std::string &name, const pfi::lang::function<T> &f);
+  template <class T>
+  void add(const std::string &name, uint32_t id, const pfi::lang::function<T> &f);
 
 private:
+  struct connection;
+  struct task;
+
+  struct method {
+    pfi::lang::shared_ptr<invoker_base> invoker;
+    pfi::lang::shared_ptr<method_stats> stats;
+  };
+
   double timeout_sec;
   volatile bool serv_running;
+  bool out_of_order;
+  double coalesce_window_sec;
+  size_t coalesce_bytes;
+  pfi::lang::shared_ptr<coalescing_stats> stats;
   std::vector<pfi::lang::shared_ptr<pfi::concurrent::thread> > serv_threads;
 
+  int epfd;
+  pfi::lang::scoped_ptr<pfi::concurrent::pcbuf<task> > tasks;
+  std::map<int, pfi::lang::shared_ptr<connection> > conns;
+  pfi::concurrent::mutex conns_m;
+
+  bool start_threads(int nthreads, const pfi::lang::function<void()>& f);
+
   void add(const std::string &name,
            const pfi::lang::shared_ptr<invoker_base>& invoker);
+  void build_dispatch_table();
+  const method* find_method(uint64_t id) const;
 
   void process_request(rpc_request& req, const pfi::lang::shared_ptr<rpc_stream>& rs);
 
-  std::map<std::string, pfi::lang::shared_ptr<invoker_base> > funcs;
+  void process_event();
+  void process_task();
+  void accept_connection();
+  void receive_requests(int fd);
+  void close_connection(int fd);
+  bool watch(int fd, bool add);
+
+  std::map<std::string, method> funcs;
+  std::map<uint32_t, std::string> func_ids;
+
+  pfi::data::frozen_string_map<method> dispatch;
+
+  // small ids index a vector, and the others are searched in sorted order,
+  // so that a large id does not size the table
+  static const uint32_t dense_id_limit = 1024;
+  std::vector<method> dispatch_by_id;
+  std::vector<std::pair<uint32_t, method> > sparse_dispatch;
 };
 
 template <class T>
@@ -98,6 +168,13 @@ void rpc_server::add(const std::string &name, const pfi::lang::function<T> &f)
   add(name, make_invoker(f));
 }
 
+template <class T>
+void rpc_server::add(const std::string &name, uint32_t id, const pfi::lang::function<T> &f)
+{
+  add(name, make_invoker(f));
+  func_ids[id] = name;
+}
+
 
 }  // namespace mprpc
 }  // namespace network
@@ -31,14 +31,146 @@
 
 #include "rpc_stream.h"
 
+#include <map>
+
+#include "../../concurrent/condition.h"
+#include "../../concurrent/thread.h"
+#include "../../lang/bind.h"
+
 namespace pfi {
 namespace network {
 namespace mprpc {
 
+namespace {
+
+// flushes the queues of coalescing streams when their window passes, for
+// streams which would not be flushed otherwise, e.g. a client which sends
+// asynchronous calls and joins them much later or never
+class deadline_flusher : pfi::lang::noncopyable {
+public:
+  static deadline_flusher& instance() {
+    // never destroyed, as the thread runs until exit
+    static deadline_flusher* p = new deadline_flusher();
+    return *p;
+  }
+
+  void schedule(rpc_stream* rs, double deadline) {
+    {
+      pfi::concurrent::scoped_lock lock(m);
+      if(!th) {
+        th.reset(new pfi::concurrent::thread(
+            pfi::lang::bind(&deadline_flusher::run, this)));
+        th->start();
+      }
+      deadlines.insert(std::make_pair(deadline, rs));
+    }
+    cond.notify_all();
+  }
+
+  // rs is not flushed after this returns
+  void cancel(rpc_stream* rs) {
+    pfi::concurrent::scoped_lock lock(m);
+    for(std::multimap<double, rpc_stream*>::iterator it = deadlines.begin();
+        it != deadlines.end(); ) {
+      if(it->second == rs) {
+        deadlines.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+    while(flushing == rs) {
+      cond.wait(m);
+    }
+  }
+
+private:
+  deadline_flusher() : flushing(NULL) { }
+
+  void run() {
+    using pfi::system::time::get_clock_time;
+
+    m.lock();
+    while(true) {
+      if(deadlines.empty()) {
+        cond.wait(m);
+        continue;
+      }
+      const double now = static_cast<double>(get_clock_time());
+      if(now < deadlines.begin()->first) {
+        cond.wait(m, deadlines.begin()->first - now);
+        continue;
+      }
+
+      flushing = deadlines.begin()->second;
+      deadlines.erase(deadlines.begin());
+      m.unlock();
+      try {
+        flushing->flush();
+      } catch (rpc_error&) {
+      }
+      m.lock();
+      flushing = NULL;
+      cond.notify_all();
+    }
+  }
+
+  pfi::concurrent::mutex m;
+  pfi::concurrent::condition cond;
+  pfi::lang::shared_ptr<pfi::concurrent::thread> th;
+  std::multimap<double, rpc_stream*> deadlines;
+  rpc_stream* flushing;
+};
+
+} // namespace
+
+coalescing_stats::coalescing_stats() :
+  flushes(0), messages(0), bytes(0), latency_usec(0), max_latency_usec(0) { }
+
+void coalescing_stats::add(uint64_t m, uint64_t b, uint64_t l)
+{
+  __sync_fetch_and_add(&flushes, 1);
+  __sync_fetch_and_add(&messages, m);
+  __sync_fetch_and_add(&bytes, b);
+  __sync_fetch_and_add(&latency_usec, l);
+
+  uint64_t cur = max_latency_usec;
+  while(cur < l) {
+    uint64_t prev = __sync_val_compare_and_swap(&max_latency_usec, cur, l);
+    if(prev == cur) {
+      break;
+    }
+    cur = prev;
+  }
+}
+
+coalescing_stats coalescing_stats::snapshot() const
+{
+  coalescing_stats* p = const_cast<coalescing_stats*>(this);
+  coalescing_stats ret;
+  ret.flushes = __sync_fetch_and_add(&p->flushes, 0);
+  ret.messages = __sync_fetch_and_add(&p->messages, 0);
+  ret.bytes = __sync_fetch_and_add(&p->bytes, 0);
+  ret.latency_usec = __sync_fetch_and_add(&p->latency_usec, 0);
+  ret.max_latency_usec = __sync_fetch_and_add(&p->max_latency_usec, 0);
+  return ret;
+}
+
+
 rpc_stream::rpc_stream(int iofd, double timeout_sec) :
-  seqid(0), os(iofd), timeout_sec(timeout_sec) { }
+  seqid(0), os(iofd), timeout_sec(timeout_sec),
+  coalesce_window_sec(0), coalesce_bytes(0), queued(0), first_queued(0, 0),
+  flush_scheduled(false) { }
 
-rpc_stream::~rpc_stream() { }
+rpc_stream::~rpc_stream()
+{
+  if(flush_scheduled) {
+    deadline_flusher::instance().cancel(this);
+  }
+  try {
+    flush();
+  } catch (rpc_error&) {
+  }
+}
 
 
 int rpc_stream::try_receive(rpc_message* msg)
@@ -46,7 +178,17 @@ int rpc_stream::try_receive(rpc_message* msg)
   msgpack::object obj;
   std::auto_ptr<msgpack::zone> zone;
 
-  int ret = os.read(&obj, &zone, timeout_sec);
+  int ret = 0;
+  if(coalesce_bytes > 0) {
+    // flush only when we are going to wait for the peer
+    ret = os.read_buffered(&obj, &zone);
+    if(ret == 0 && !flush()) {
+      return -1;
+    }
+  }
+  if(ret == 0) {
+    ret = os.read(&obj, &zone, timeout_sec);
+  }
   if(ret <= 0) {
     return ret;
   }
@@ -67,26 +209,125 @@ bool rpc_stream::receive(rpc_message* msg)
   return true;
 }
 
+bool rpc_stream::is_connected() const
+{
+  return os.is_connected();
+}
+
+int rpc_stream::read_some()
+{
+  return os.read_some();
+}
+
+int rpc_stream::receive_buffered(rpc_message* msg)
+{
+  msgpack::object obj;
+  std::auto_ptr<msgpack::zone> zone;
+
+  try {
+    if(os.read_buffered(&obj, &zone) <= 0) {
+      return 0;
+    }
+    msg->reset(obj, zone);
+  } catch (msgpack::unpack_error&) {
+    return -1;
+  } catch (msgpack::type_error&) {
+    return -1;
+  }
+  return 1;
+}
+
 
 bool rpc_stream::join(uint32_t msgid, rpc_response* result)
 {
+  typedef std::map<uint32_t, pfi::lang::shared_ptr<rpc_message> >::iterator iterator;
+
+  iterator it = pending.find(msgid);
+  if(it != pending.end() && it->second) {
+    result->reset(*it->second);
+    pending.erase(it);
+    return true;
+  }
+
   while(true) {
-    rpc_message msg;
-    if(!receive(&msg)) {
-      return false;
+    pfi::lang::shared_ptr<rpc_message> msg(new rpc_message());
+    try {
+      if(!receive(msg.get())) {
+        pending.erase(msgid);
+        return false;
+      }
+    } catch (rpc_error&) {
+      pending.erase(msgid);
+      throw;
     }
 
-    if(!msg.is_response()) {
+    if(!msg->is_response()) {
       continue;
     }
 
-    if(msg.msgid() != msgid) {
+    if(msg->msgid() != msgid) {
+      it = pending.find(msg->msgid());
+      if(it != pending.end()) {
+        it->second = msg;
+      }
       continue;
     }
 
-    result->reset(msg);
+    result->reset(*msg);
+    pending.erase(msgid);
+    return true;
+  }
+}
+
+void rpc_stream::forget(uint32_t msgid)
+{
+  pending.erase(msgid);
+}
+
+void rpc_stream::set_coalescing(double window_sec, size_t max_bytes,
+                                const pfi::lang::shared_ptr<coalescing_stats>& st)
+{
+  coalesce_window_sec = window_sec;
+  coalesce_bytes = max_bytes;
+  stats = st;
+}
+
+bool rpc_stream::flush()
+{
+  pfi::concurrent::scoped_lock lock(write_m);
+  return flush_buffer();
+}
+
+void rpc_stream::schedule_flush()
+{
+  flush_scheduled = true;
+  deadline_flusher::instance().schedule(
+      this, static_cast<double>(first_queued) + coalesce_window_sec);
+}
+
+bool rpc_stream::flush_buffer()
+{
+  using pfi::system::time::clock_time;
+  using pfi::system::time::get_clock_time;
+
+  if(queued == 0) {
     return true;
   }
+
+  const size_t messages = queued;
+  const size_t size = os.queued_bytes();
+  queued = 0;
+  const int ret = os.flush_queue(timeout_sec);
+
+  if(ret < 0) {
+    return false;
+  }
+
+  if(stats) {
+    clock_time latency = get_clock_time() - first_queued;
+    stats->add(messages, size, latency.sec * 1000000 + latency.usec);
+  }
+  return true;
 }
 
 
@@ -32,6 +32,12 @@
 #ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_RPC_STREAM_H_
 #define INCLUDE_GUARD_PFI_NETWORK_MPRPC_RPC_STREAM_H_
 
+#include <map>
+
+#include "../../lang/shared_ptr.h"
+#include "../../concurrent/mutex.h"
+#include "../../concurrent/lock.h"
+#include "../../system/time_util.h"
 #include "object_stream.h"
 #include "message.h"
 #include "exception.h"
@@ -41,6 +47,23 @@ namespace network {
 namespace mprpc {
 
 
+// counters of coalesced writes. one instance may be shared by all the
+// streams of a server or a client, and is updated atomically.
+struct coalescing_stats {
+  coalescing_stats();
+
+  void add(uint64_t messages, uint64_t bytes, uint64_t latency_usec);
+  coalescing_stats snapshot() const;
+
+  uint64_t flushes;
+  uint64_t messages;
+  uint64_t bytes;
+  // time from queueing the first message of a write until it was written
+  uint64_t latency_usec;
+  uint64_t max_latency_usec;
+};
+
+
 class rpc_stream {
 public:
   rpc_stream(int iofd, double timeout_sec);
@@ -49,41 +72,89 @@ public:
 
 public:
   template <typename P>
-  void call(const std::string& name, const P& param, rpc_response* result);
+  void call(const method_key& name, const P& param, rpc_response* result);
 
   template <typename P>
-  bool send(const std::string& name, const P& param, uint32_t* msgid);
+  bool send(const method_key& name, const P& param, uint32_t* msgid);
 
+  // responses to other outstanding requests received while joining are
+  // kept until they are joined or forgotten, so that requests can be
+  // joined in any order
   bool join(uint32_t msgid, rpc_response* result);
+  void forget(uint32_t msgid);
 
   int try_receive(rpc_message* msg);
   bool receive(rpc_message* msg);
 
+  int read_some();
+  int receive_buffered(rpc_message* msg);
+
+  bool is_connected() const;
+
   template <typename R, typename E>
   bool send_response(uint32_t msgid, const R& retval, const E& error);
 
+  // write coalescing: when max_bytes > 0, outgoing messages are queued and
+  // sent with a single writev once max_bytes are queued or once the first
+  // queued one has waited window_sec. the window is checked when a message
+  // is queued, and otherwise by a timer thread, so a request which is
+  // never joined is still sent. queued messages are also flushed before
+  // waiting for incoming messages, so a request is never left unsent while
+  // its response is awaited. a message with a large raw field is sent at
+  // once with the queue, as the field is not copied.
+  void set_coalescing(double window_sec, size_t max_bytes,
+                      const pfi::lang::shared_ptr<coalescing_stats>& stats =
+                      pfi::lang::shared_ptr<coalescing_stats>());
+  bool flush();
+
 private:
+  friend struct rpc_request;
+  friend struct rpc_response;
+
+  template <typename T>
+  int write(const T& v, double timeout_sec);
+  bool flush_buffer();
+  void schedule_flush();
+
+  // raw fields shorter than this are copied into the queue
+  static const size_t coalesce_copy_limit = 4096;
+
   uint32_t seqid;
   object_stream os;
   double timeout_sec;
+  pfi::concurrent::mutex write_m;
+
+  double coalesce_window_sec;
+  size_t coalesce_bytes;
+  size_t queued;
+  pfi::system::time::clock_time first_queued;
+  bool flush_scheduled;
+  pfi::lang::shared_ptr<coalescing_stats> stats;
+
+  std::map<uint32_t, pfi::lang::shared_ptr<rpc_message> > pending;
 };
 
 
 template <typename P>
-bool rpc_stream::send(const std::string& name, const P& param, uint32_t* msgid)
+bool rpc_stream::send(const method_key& name, const P& param, uint32_t* msgid)
 {
   *msgid = seqid++;
 
-  if(!rpc_request::write(os, *msgid, name, param, timeout_sec)) {
-    return false;
+  {
+    // the queue may be flushed by the timer thread
+    pfi::concurrent::scoped_lock lock(write_m);
+    if(!rpc_request::write(*this, *msgid, name, param, timeout_sec)) {
+      return false;
+    }
   }
 
+  pending[*msgid].reset();
   return true;
 }
 
 
 template <typename P>
-void rpc_stream::call(const std::string& name, const P& param, rpc_response* result)
+void rpc_stream::call(const method_key& name, const P& param, rpc_response* result)
 {
   uint32_t msgid;
   if(!send(name, param, &msgid)) {
@@ -99,7 +170,35 @@ void rpc_stream::call(const std::string& name, const P& param, rpc_response* res
 template <typename R, typename E>
 bool rpc_stream::send_response(uint32_t msgid, const R& retval, const E& error)
 {
-  return rpc_response::write(os, msgid, retval, error, timeout_sec);
+  // responses to pipelined requests may be sent from several threads
+  pfi::concurrent::scoped_lock lock(write_m);
+  return rpc_response::write(*this, msgid, retval, error, timeout_sec);
+}
+
+
+template <typename T>
+int rpc_stream::write(const T& v, double timeout_sec)
+{
+  if(coalesce_bytes == 0) {
+    return os.write(v, timeout_sec);
+  }
+
+  using pfi::system::time::get_clock_time;
+  if(queued == 0) {
+    first_queued = get_clock_time();
+  }
+  const bool referenced = os.queue(v, coalesce_copy_limit);
+  queued++;
+
+  if(referenced || os.queued_bytes() >= coalesce_bytes ||
+     coalesce_window_sec <= (double)(get_clock_time() - first_queued)) {
+    if(!flush_buffer()) {
+      return -1;
+    }
+  } else if(queued == 1) {
+    schedule_flush();
+  }
+  return 1;
 }
 
 
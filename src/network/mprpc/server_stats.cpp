@@ -0,0 +1,216 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "server_stats.h"
+
+#include <cstring>
+
+namespace pfi {
+namespace network {
+namespace mprpc {
+
+namespace {
+
+int next_shard = 0;
+__thread int thread_shard = -1;
+
+int current_shard()
+{
+  if (thread_shard < 0)
+    thread_shard = __sync_fetch_and_add(&next_shard, 1) % latency_histogram::kShards;
+  return thread_shard;
+}
+
+uint64_t usec_between(const pfi::system::time::clock_time& from,
+                      const pfi::system::time::clock_time& to)
+{
+  if (to < from)
+    return 0;
+  pfi::system::time::clock_time d = to - from;
+  return d.sec * 1000000 + d.usec;
+}
+
+bool reached(const pfi::system::time::clock_time& t)
+{
+  return t.sec != 0 || t.usec != 0;
+}
+
+void put_percentiles(std::map<std::string, uint64_t>& m, const std::string& name,
+                     const latency_histogram& h)
+{
+  m[name + "_p50_usec"] = h.percentile(0.5);
+  m[name + "_p90_usec"] = h.percentile(0.9);
+  m[name + "_p99_usec"] = h.percentile(0.99);
+  m[name + "_max_usec"] = h.max();
+}
+
+} // namespace
+
+
+latency_histogram::latency_histogram() :
+  max_usec(0)
+{
+  std::memset(buckets, 0, sizeof(buckets));
+}
+
+int latency_histogram::bucket_of(uint64_t usec)
+{
+  if (usec < (uint64_t)kSubBuckets)
+    return (int)usec;
+  if (usec >> kMaxBits)
+    return kBuckets - 1;
+
+  int msb = 63 - __builtin_clzll(usec);
+  int shift = msb - kSubBits;
+  return (shift + 1) * kSubBuckets + (int)((usec >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t latency_histogram::upper_bound_of(int bucket)
+{
+  if (bucket < kSubBuckets)
+    return bucket;
+
+  int shift = bucket / kSubBuckets - 1;
+  uint64_t lower = (uint64_t)(kSubBuckets + bucket % kSubBuckets) << shift;
+  return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void latency_histogram::record(uint64_t usec)
+{
+  __sync_fetch_and_add(&buckets[current_shard()][bucket_of(usec)], 1);
+
+  uint64_t cur = max_usec;
+  while (cur < usec) {
+    uint64_t prev = __sync_val_compare_and_swap(&max_usec, cur, usec);
+    if (prev == cur)
+      break;
+    cur = prev;
+  }
+}
+
+void latency_histogram::merge(uint64_t* to) const
+{
+  for (int i = 0; i < kBuckets; i++)
+    to[i] = 0;
+  for (int s = 0; s < kShards; s++)
+    for (int i = 0; i < kBuckets; i++)
+      to[i] += buckets[s][i];
+}
+
+uint64_t latency_histogram::count() const
+{
+  uint64_t merged[kBuckets];
+  merge(merged);
+
+  uint64_t n = 0;
+  for (int i = 0; i < kBuckets; i++)
+    n += merged[i];
+  return n;
+}
+
+uint64_t latency_histogram::max() const
+{
+  return max_usec;
+}
+
+uint64_t latency_histogram::percentile(double p) const
+{
+  uint64_t merged[kBuckets];
+  merge(merged);
+
+  uint64_t n = 0;
+  for (int i = 0; i < kBuckets; i++)
+    n += merged[i];
+  if (n == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t)(p * n);
+  if (rank >= n)
+    rank = n - 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    seen += merged[i];
+    if (seen > rank) {
+      uint64_t ub = upper_bound_of(i);
+      return ub < max_usec ? ub : max_usec;
+    }
+  }
+  return max_usec;
+}
+
+
+method_stats::method_stats() :
+  calls(0), errors(0), inflight(0) { }
+
+void method_stats::begin()
+{
+  __sync_fetch_and_add(&calls, 1);
+  __sync_fetch_and_add(&inflight, 1);
+}
+
+void method_stats::end(const pfi::system::time::clock_time& start,
+                       const pfi::system::time::clock_time& decoded,
+                       const pfi::system::time::clock_time& handled,
+                       const pfi::system::time::clock_time& finished,
+                       bool error)
+{
+  __sync_fetch_and_sub(&inflight, 1);
+  if (error)
+    __sync_fetch_and_add(&errors, 1);
+
+  if (reached(decoded)) {
+    decode.record(usec_between(start, decoded));
+    if (reached(handled)) {
+      handler.record(usec_between(decoded, handled));
+      encode.record(usec_between(handled, finished));
+    }
+  }
+  total.record(usec_between(start, finished));
+}
+
+std::map<std::string, uint64_t> method_stats::summary() const
+{
+  std::map<std::string, uint64_t> m;
+  m["calls"] = calls;
+  m["errors"] = errors;
+  m["inflight"] = inflight < 0 ? 0 : inflight;
+  put_percentiles(m, "decode", decode);
+  put_percentiles(m, "handler", handler);
+  put_percentiles(m, "encode", encode);
+  put_percentiles(m, "total", total);
+  return m;
+}
+
+
+}  // namespace mprpc
+}  // namespace network
+}  // namespace pfi
@@ -0,0 +1,110 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_SERVER_STATS_H_
+#define INCLUDE_GUARD_PFI_NETWORK_MPRPC_SERVER_STATS_H_
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+#include "../../lang/noncopyable.h"
+#include "../../system/time_util.h"
+
+namespace pfi {
+namespace network {
+namespace mprpc {
+
+
+// a log-linear latency histogram in microseconds: values are kept with
+// 3 significant bits (error below 12.5%) up to 2^40 usec. record() takes
+// no lock; the counters are striped over a few shards picked per thread
+// so that workers rarely touch the same cache lines.
+class latency_histogram : pfi::lang::noncopyable {
+public:
+  latency_histogram();
+
+  void record(uint64_t usec);
+
+  uint64_t count() const;
+  uint64_t max() const;
+  // an upper bound of the p-th quantile (0 <= p <= 1)
+  uint64_t percentile(double p) const;
+
+  static const int kSubBits = 3;
+  static const int kSubBuckets = 1 << kSubBits;
+  static const int kMaxBits = 40;
+  static const int kBuckets = (kMaxBits - kSubBits + 1) * kSubBuckets;
+  static const int kShards = 8;
+
+  static int bucket_of(uint64_t usec);
+  static uint64_t upper_bound_of(int bucket);
+
+private:
+  void merge(uint64_t* to) const;
+
+  uint64_t buckets[kShards][kBuckets];
+  uint64_t max_usec;
+};
+
+
+// counters of one rpc method
+class method_stats : pfi::lang::noncopyable {
+public:
+  method_stats();
+
+  void begin();
+  // a phase whose time is 0 was not reached
+  void end(const pfi::system::time::clock_time& start,
+           const pfi::system::time::clock_time& decoded,
+           const pfi::system::time::clock_time& handled,
+           const pfi::system::time::clock_time& finished,
+           bool error);
+
+  // calls, errors, inflight and {decode,handler,encode,total}_{p50,p90,p99,max}_usec
+  std::map<std::string, uint64_t> summary() const;
+
+  uint64_t calls;
+  uint64_t errors;
+  int64_t inflight;
+
+  latency_histogram decode;   // converting the arguments
+  latency_histogram handler;  // the registered function
+  latency_histogram encode;   // packing and sending the result
+  latency_histogram total;
+};
+
+
+}  // namespace mprpc
+}  // namespace network
+}  // namespace pfi
+
+#endif // #ifndef INCLUDE_GUARD_PFI_NETWORK_MPRPC_SERVER_STATS_H_
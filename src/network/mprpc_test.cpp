@@ -168,10 +168,367 @@ TEST(mprpc, mprpc_nonblock_serv_test)
   ser.join();
 }
 
+TEST(mprpc, mprpc_reactor_test)
+{
+  testrpc_server ser(kServerTimeout);
+  ASSERT_TRUE(ser.create(kTestRPCPort));
+
+  ser.set_test_str(&test_str);
+  ser.set_test_vec(&test_vec);
+  ASSERT_TRUE(ser.run_reactor(1, 1, false));
+  EXPECT_TRUE(ser.running());
+
+  {
+    // idle connections must not occupy the server threads
+    vector<shared_ptr<pfi::network::mprpc::socket> > idles;
+    for (int i = 0; i < kServThreads; i++) {
+      idles.push_back(shared_ptr<pfi::network::mprpc::socket>(
+          new pfi::network::mprpc::socket()));
+      ASSERT_TRUE(idles.back()->connect(kLocalhost, kTestRPCPort));
+    }
+
+    testrpc_client cln1(kLocalhost, kTestRPCPort, kClientTimeout);
+    testrpc_client cln2(kLocalhost, kTestRPCPort, kClientTimeout);
+    for (int t = 0; t < 100; t++) {
+      string v, r;
+      for (int i = 0; i < 10; i++)
+        v += '0' + (rand() % 10);
+      EXPECT_NO_THROW({ r = (t % 2 ? cln1 : cln2).call_test_str(v); });
+      EXPECT_EQ(v, r);
+
+      vector<int> vv(t, t), rv;
+      EXPECT_NO_THROW({ rv = cln1.call_test_vec(vv); });
+      EXPECT_EQ(vv, rv);
+    }
+  }
+
+  ser.stop();
+  ser.join();
+  EXPECT_FALSE(ser.running());
+}
+
+static int test_sleep(int msec)
+{
+  thread::sleep(msec / 1000.0);
+  return msec;
+}
+
+TEST(mprpc, mprpc_reactor_out_of_order_test)
+{
+  testrpc_server ser(kServerTimeout);
+  ASSERT_TRUE(ser.create(kTestRPCPort));
+
+  ser.set_test_str(&test_str);
+  ser.add<int(int)>("test_sleep", &test_sleep);
+  ser.set_out_of_order(true);
+  ASSERT_TRUE(ser.run_reactor(1, 2, false));
+
+  {
+    pfi::network::mprpc::socket sock;
+    ASSERT_TRUE(sock.connect(kLocalhost, kTestRPCPort));
+    pfi::network::mprpc::rpc_stream rs(sock.release(), kClientTimeout);
+
+    // the fast call pipelined behind the slow one is answered first
+    uint32_t slow_id, fast_id;
+    ASSERT_TRUE(rs.send("test_sleep",
+                        pfi::network::mprpc::argument1<int>(500), &slow_id));
+    ASSERT_TRUE(rs.send("test_str",
+                        pfi::network::mprpc::argument1<string>("fast"), &fast_id));
+
+    pfi::network::mprpc::rpc_response res;
+    ASSERT_TRUE(rs.join(fast_id, &res));
+    string r;
+    EXPECT_TRUE(res.result_as(&r));
+    EXPECT_EQ("fast", r);
+
+    pfi::network::mprpc::rpc_message msg;
+    ASSERT_TRUE(rs.receive(&msg));
+    ASSERT_TRUE(msg.is_response());
+    EXPECT_EQ(slow_id, msg.msgid());
+  }
+
+  ser.stop();
+  ser.join();
+}
+
+TEST(mprpc, mprpc_async_call_test)
+{
+  testrpc_server ser(kServerTimeout);
+  ASSERT_TRUE(ser.create(kTestRPCPort));
+
+  ser.set_test_str(&test_str);
+  ser.add<int(int)>("test_sleep", &test_sleep);
+  ser.set_out_of_order(true);
+  ASSERT_TRUE(ser.run_reactor(1, 4, false));
+
+  {
+    testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout);
+    pfi::lang::function<pfi::network::mprpc::rpc_future<int>(int)> sleep_async =
+      cln.call_async<int(int)>("test_sleep");
+
+    // requests are in flight at the same time and joined in any order
+    clock_time start = get_clock_time();
+    vector<pfi::network::mprpc::rpc_future<int> > fs;
+    for (int i = 1; i <= 3; i++)
+      fs.push_back(sleep_async(200 + i));
+    pfi::network::mprpc::rpc_future<string> fstr = cln.call_test_str_async("async");
+
+    EXPECT_EQ("async", fstr.get());
+    for (int i = 3; i >= 1; i--)
+      EXPECT_EQ(200 + i, fs[i - 1].get());
+    EXPECT_GT(0.6, get_clock_time() - start);
+
+    EXPECT_THROW(fs[0].get(), pfi::network::mprpc::rpc_error);
+
+    // abandoned futures do not disturb later calls
+    sleep_async(10);
+    EXPECT_EQ("sync", cln.call_test_str("sync"));
+  }
+
+  ser.stop();
+  ser.join();
+}
+
+TEST(mprpc, mprpc_coalescing_test)
+{
+  for (int reactor = 0; reactor < 2; reactor++) {
+    testrpc_server ser(kServerTimeout);
+    ASSERT_TRUE(ser.create(kTestRPCPort));
+    ser.set_test_str(&test_str);
+    ser.set_coalescing(1.0, 64 * 1024);
+    if (reactor)
+      ASSERT_TRUE(ser.run_reactor(1, 2, false));
+    else
+      ASSERT_TRUE(ser.run(kServThreads, false));
+
+    {
+      testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout);
+      cln.set_coalescing(1.0, 64 * 1024);
+
+      // pipelined requests are sent at once when the first one is joined
+      vector<pfi::network::mprpc::rpc_future<string> > fs;
+      for (int i = 0; i < 10; i++)
+        fs.push_back(cln.call_test_str_async(string(i + 1, 'a')));
+      for (int i = 0; i < 10; i++)
+        EXPECT_EQ(string(i + 1, 'a'), fs[i].get());
+
+      pfi::network::mprpc::coalescing_stats st = cln.get_coalescing_stats();
+      EXPECT_EQ(1u, st.flushes);
+      EXPECT_EQ(10u, st.messages);
+      EXPECT_LT(0u, st.bytes);
+      EXPECT_GE(st.latency_usec, st.max_latency_usec);
+
+      // synchronous calls are never delayed by the window
+      clock_time start = get_clock_time();
+      EXPECT_EQ("sync", cln.call_test_str("sync"));
+      EXPECT_GT(0.5, get_clock_time() - start);
+      EXPECT_EQ(2u, cln.get_coalescing_stats().flushes);
+    }
+
+    {
+      testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout);
+      cln.set_coalescing(0.05, 64 * 1024);
+
+      // a request which is not joined is sent when the window passes
+      pfi::network::mprpc::rpc_future<string> f = cln.call_test_str_async("late");
+      EXPECT_EQ(0u, cln.get_coalescing_stats().flushes);
+      sleep(1);
+      EXPECT_EQ(1u, cln.get_coalescing_stats().flushes);
+      EXPECT_EQ("late", f.get());
+
+      // a large argument is sent at once, not copied into the queue
+      string large(100000, 'l');
+      EXPECT_EQ(large, cln.call_test_str_async(large).get());
+      EXPECT_EQ(2u, cln.get_coalescing_stats().flushes);
+    }
+
+    ser.stop();
+    ser.join();
+
+    pfi::network::mprpc::coalescing_stats st = ser.get_coalescing_stats();
+    EXPECT_EQ(13u, st.messages);
+    EXPECT_GE(13u, st.flushes);
+    EXPECT_LE(2u, st.flushes);
+  }
+}
+
+TEST(mprpc, latency_histogram_test)
+{
+  using pfi::network::mprpc::latency_histogram;
+
+  for (uint64_t v = 0; v < 100000; v = v * 3 / 2 + 1) {
+    int b = latency_histogram::bucket_of(v);
+    EXPECT_LE(v, latency_histogram::upper_bound_of(b));
+    EXPECT_GE(v + v / 8, latency_histogram::upper_bound_of(b));
+    if (b > 0) {
+      EXPECT_GT(v, latency_histogram::upper_bound_of(b - 1));
+    }
+  }
+
+  latency_histogram h;
+  EXPECT_EQ(0u, h.percentile(0.99));
+  for (uint64_t v = 1; v <= 1000; v++)
+    h.record(v);
+  EXPECT_EQ(1000u, h.count());
+  EXPECT_EQ(1000u, h.max());
+  EXPECT_LE(500u, h.percentile(0.5));
+  EXPECT_GE(500u * 9 / 8, h.percentile(0.5));
+  EXPECT_LE(990u, h.percentile(0.99));
+  EXPECT_EQ(1000u, h.percentile(1.0));
+}
+
+TEST(mprpc, mprpc_method_stats_test)
+{
+  typedef map<string, map<string, uint64_t> > stats_type;
+
+  testrpc_server ser(kServerTimeout);
+  ASSERT_TRUE(ser.create(kTestRPCPort));
+  ser.set_test_str(&test_str);
+  ser.add<int(int)>("test_sleep", &test_sleep);
+  ASSERT_TRUE(ser.run(kServThreads, false));
+
+  {
+    testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout);
+    for (int i = 0; i < 5; i++)
+      EXPECT_EQ("stats", cln.call_test_str("stats"));
+    EXPECT_EQ(20, cln.call<int(int)>("test_sleep")(20));
+    // type mismatch
+    EXPECT_THROW(cln.call<int(string)>("test_sleep")("x"), pfi::network::mprpc::rpc_error);
+
+    stats_type st;
+    EXPECT_NO_THROW({ st = cln.call<stats_type()>("__stats")(); });
+    ASSERT_EQ(1u, st.count("test_str"));
+    EXPECT_EQ(5u, st["test_str"]["calls"]);
+    EXPECT_EQ(0u, st["test_str"]["errors"]);
+    EXPECT_EQ(2u, st["test_sleep"]["calls"]);
+    EXPECT_EQ(1u, st["test_sleep"]["errors"]);
+    EXPECT_LE(20000u, st["test_sleep"]["handler_max_usec"]);
+    EXPECT_LE(st["test_sleep"]["handler_max_usec"], st["test_sleep"]["total_max_usec"]);
+    EXPECT_LE(st["test_str"]["total_p50_usec"], st["test_str"]["total_p99_usec"]);
+    // the call being served
+    EXPECT_EQ(1u, st["__stats"]["inflight"]);
+    EXPECT_EQ(0u, st["test_str"]["inflight"]);
+  }
+
+  ser.stop();
+  ser.join();
+}
+
+TEST(mprpc, mprpc_method_id_test)
+{
+  testrpc_server ser(kServerTimeout);
+  ASSERT_TRUE(ser.create(kTestRPCPort));
+  ser.set_test_str(&test_str);
+  ser.add<int(int)>("test_sleep", 3, &test_sleep);
+  // large ids do not size the dispatch table
+  ser.add<int(int)>("test_sleep_2", 1u << 31, &test_sleep);
+  ser.add<int(int)>("test_sleep_3", 0xFFFFFFFFu, &test_sleep);
+  ASSERT_TRUE(ser.run(kServThreads, false));
+
+  {
+    testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout);
+    EXPECT_EQ(1, cln.call<int(int)>(3)(1));
+    EXPECT_EQ(2, cln.call<int(int)>("test_sleep")(2));
+    EXPECT_EQ(3, cln.call_async<int(int)>(3)(3).get());
+    EXPECT_EQ("by name", cln.call_test_str("by name"));
+    EXPECT_EQ(4, cln.call<int(int)>(1u << 31)(4));
+    EXPECT_EQ(5, cln.call<int(int)>(0xFFFFFFFFu)(5));
+
+    EXPECT_THROW(cln.call<int(int)>(4)(1), pfi::network::mprpc::method_not_found);
+    EXPECT_THROW(cln.call<int(int)>(0xFFFFFFFEu)(1), pfi::network::mprpc::method_not_found);
+    EXPECT_THROW(cln.call<int(int)>(0)(1), pfi::network::mprpc::method_not_found);
+    EXPECT_THROW(cln.call<int(int)>("no_such_method")(1), pfi::network::mprpc::method_not_found);
+  }
+
+  ser.stop();
+  ser.join();
+}
+
+static void pooled_client_thread(testrpc_client* cln, int* failures)
+{
+  for (int t = 0; t < 100; t++) {
+    string v, r;
+    for (int i = 0; i < 10; i++)
+      v += '0' + (rand() % 10);
+    try {
+      r = cln->call_test_str(v);
+    } catch (pfi::network::mprpc::rpc_error&) {
+    }
+    if (r != v)
+      ++*failures;
+  }
+}
+
+TEST(mprpc, mprpc_connection_pool_test)
+{
+  const size_t pool_size = 4;
+  testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout, pool_size);
+
+  for (int round = 0; round < 2; round++) {
+    // connections to the previous server are evicted
+    testrpc_server ser(kServerTimeout);
+    ASSERT_TRUE(ser.create(kTestRPCPort));
+    ser.set_test_str(&test_str);
+    ASSERT_TRUE(ser.run_reactor(1, 4, false));
+
+    // the client is shared by the threads without locks
+    const int nthreads = 8;
+    vector<int> failures(nthreads);
+    vector<shared_ptr<thread> > ths;
+    for (int i = 0; i < nthreads; i++) {
+      ths.push_back(shared_ptr<thread>(new thread(
+          pfi::lang::bind(&pooled_client_thread, &cln, &failures[i]))));
+      ASSERT_TRUE(ths.back()->start());
+    }
+    for (int i = 0; i < nthreads; i++) {
+      ths[i]->join();
+      EXPECT_EQ(0, failures[i]);
+    }
+
+    ser.stop();
+    ser.join();
+  }
+}
+
+static vector<string> test_strs(const vector<string>& v){ return v; }
+
+TEST(mprpc, mprpc_large_message_test)
+{
+  testrpc_server ser(kServerTimeout);
+  ASSERT_TRUE(ser.create(kTestRPCPort));
+  ser.set_test_str(&test_str);
+  ser.add<vector<string>(vector<string>)>("test_strs", &test_strs);
+  ASSERT_TRUE(ser.run(kServThreads, false));
+
+  {
+    testrpc_client cln(kLocalhost, kTestRPCPort, kClientTimeout);
+
+    // a blob much larger than the socket buffer
+    string v(4 * 1024 * 1024, '\0'), r;
+    for (size_t i = 0; i < v.size(); i++)
+      v[i] = rand();
+    EXPECT_NO_THROW({ r = cln.call_test_str(v); });
+    EXPECT_TRUE(v == r);
+
+    // more referenced buffers than a single writev(2) accepts
+    vector<string> vs(5000), rs;
+    for (size_t i = 0; i < vs.size(); i++)
+      vs[i] = string(40 + i % 10, 'a' + i % 26);
+    pfi::lang::function<vector<string>(vector<string>)> call_test_strs =
+      cln.call<vector<string>(vector<string>)>("test_strs");
+    EXPECT_NO_THROW({ rs = call_test_strs(vs); });
+    EXPECT_TRUE(vs == rs);
+  }
+
+  ser.stop();
+  ser.join();
+}
+
 TEST(mprpc, mprpc_nonblock_uninitialied_test)
 {
   testrpc_server ser(kTestTimeout);
   ASSERT_FALSE(ser.run(kServThreads));
+  ASSERT_FALSE(ser.run_reactor(1, kServThreads));
 }
 
 TEST(mprpc, mprpc_server_timeout_test)
@@ -70,6 +70,8 @@ bool rpc_server::serv(uint16_t port, int nthreads)
   if (!ssock->create(port))
     return false;
 
+  dispatch.build(funcs.begin(), funcs.end());
+
   vector<pfi::lang::shared_ptr<thread> > ths(nthreads);
   for (int i=0; i<nthreads; i++){
       ths[i]=pfi::lang::shared_ptr<thread>(new thread(bind(&rpc_server::process, this, ssock)));
@@ -104,7 +106,8 @@ void rpc_server::process(const pfi::lang::shared_ptr<server_socket>& ssock)
         continue;
       }
 
-      if (funcs.count(name)==0){
+      const pfi::lang::shared_ptr<invoker_base> *f=dispatch.find(name);
+      if (!f){
         string msg(string("NotFound ")+name);
         oa<<msg;
         oa.flush();
@@ -120,7 +123,7 @@ void rpc_server::process(const pfi::lang::shared_ptr<server_socket>& ssock)
       }
 
       try{
-        funcs[name]->invoke(ia,oa);
+        (*f)->invoke(ia,oa);
       }
       catch(const rpc_error &){
       }
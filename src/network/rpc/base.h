@@ -41,6 +41,7 @@
 #include "../../lang/shared_ptr.h"
 #include "../../concurrent/thread.h"
 #include "../../data/serialization.h"
+#include "../../data/frozen_string_map.h"
 #include "../../network/socket.h"
 #include "../../network/iostream.h"
 #include "invoker.h"
@@ -73,6 +74,8 @@ private:
   void process(const pfi::lang::shared_ptr<server_socket>& sock);
 
   std::map<std::string, pfi::lang::shared_ptr<invoker_base> > funcs;
+  // built from funcs in serv(), so methods must be added before it
+  pfi::data::frozen_string_map<pfi::lang::shared_ptr<invoker_base> > dispatch;
 
   const int version;
 };
@@ -132,6 +132,24 @@ TEST(rpc, rpc_test)
       }
     }
   }
+
+  // larger than the socket buffers
+  {
+    string v;
+    for (int i=0;i<1000000;i++)
+      v+=(char)rand();
+    string r;
+    EXPECT_NO_THROW({ r = cln.call_test_str(v); });
+    EXPECT_TRUE(r == v);
+  }
+  {
+    vector<int> v;
+    for (int i=0;i<100000;i++)
+      v.push_back(rand());
+    vector<int> r;
+    EXPECT_NO_THROW({ r = cln.call_test_vec(v); });
+    EXPECT_TRUE(r == v);
+  }
 }
 
 // test for struct and empty vector
@@ -245,8 +245,10 @@ int stream_socket::write(const void *dat, int size)
   const unsigned char *p=st, *q=p+size;
 
   // write to buffer
-  while(wrbuf_size<buf_size && p<q)
-    wrbuf[wrbuf_size++]=*(p++);
+  int n=min<int>(q-p, buf_size-wrbuf_size);
+  memcpy(&wrbuf[0]+wrbuf_size, p, n);
+  wrbuf_size+=n;
+  p+=n;
 
   // if buffer is full, flush buffer.
   if (wrbuf_size==buf_size){
@@ -261,8 +263,8 @@ int stream_socket::write(const void *dat, int size)
     return p-st+send_all(p, q-p);
 
   // otherwise, write to buffer
-  while(p<q)
-    wrbuf[wrbuf_size++]=*(p++);
+  memcpy(&wrbuf[0]+wrbuf_size, p, q-p);
+  wrbuf_size+=q-p;
 
   return q-st;
 }
@@ -317,6 +319,28 @@ bool stream_socket::puts(const string &str)
   return writesize==(int)str.length();
 }
 
+int stream_socket::take_read_buffer(const char **p)
+{
+  if (buf_elem()==0) fill_buf();
+  int n=buf_elem();
+  *p=(const char*)&rdbuf[0]+rdbuf_p;
+  rdbuf_p=rdbuf_end;
+  return n;
+}
+
+int stream_socket::write_buffer(char **p)
+{
+  if (wrbuf_size==buf_size && flush()>=0)
+    return 0;
+  *p=(char*)&wrbuf[0]+wrbuf_size;
+  return buf_size-wrbuf_size;
+}
+
+void stream_socket::commit_write_buffer(int n)
+{
+  wrbuf_size+=n;
+}
+
 bool stream_socket::set_timeout(double sec)
 {
   return
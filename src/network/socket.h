@@ -73,6 +73,17 @@ public:
   bool getline(std::string &str, int limit=-1);
   bool puts(const std::string &str);
 
+  // direct access to the internal buffers, for stream buffers.
+  // take_read_buffer() returns the buffered bytes at *p, receiving once
+  // when nothing is buffered, and marks them as read. they are valid
+  // until the next read. it returns 0 at EOF or on error.
+  // write_buffer() returns the free space of the write buffer at *p,
+  // flushing it first when it is full, and returns 0 when that fails.
+  // commit_write_buffer(n) appends the first n bytes of the space.
+  int take_read_buffer(const char **p);
+  int write_buffer(char **p);
+  void commit_write_buffer(int n);
+
   bool set_timeout(double sec);
   bool set_recv_timeout(double sec);
   bool set_send_timeout(double sec);
@@ -43,10 +43,10 @@ namespace pfi {
 namespace system {
 namespace mmapper {
 
-int mmapper::open(const std::string& filename)
+int mmapper::open(const std::string& filename, bool writable)
 {
   mmapper tmp;
-  NO_INTR(tmp.fd, ::open(filename.c_str(), O_RDWR));
+  NO_INTR(tmp.fd, ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY));
   if (FAILED(tmp.fd))
     return -1;
 
@@ -57,7 +57,7 @@ int mmapper::open(const std::string& filename)
     return -1;
   tmp.length = st_buf.st_size;
 
-  const int prot = PROT_WRITE | PROT_READ;
+  const int prot = writable ? PROT_WRITE | PROT_READ : PROT_READ;
   void* p;
   NO_INTR(p, mmap(NULL, tmp.length, prot, MAP_SHARED, tmp.fd, 0));
   if (p == MAP_FAILED)
@@ -60,7 +60,8 @@ public:
   size_t size() const { return length; }
   bool is_open() const { return ptr; }
 
-  int open(const std::string& filename);
+  // a read-only mapping can be shared by processes mapping the same file
+  int open(const std::string& filename, bool writable = true);
   int close();
 
   void swap(mmapper& other) {
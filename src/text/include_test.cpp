@@ -1,6 +1,11 @@
 #include "json/cast.h"
 #include "json/parser.h"
 #include "json/serialization.h"
+#include "json/document.h"
+#include "json/lazy.h"
+#include "json/ndjson.h"
+#include "json/number.h"
+#include "json/stream_archive.h"
 #include "json/base.h"
 #include "xhtml.h"
 #include "json.h"
@@ -36,4 +36,8 @@
 #include "json/parser.h"
 #include "json/cast.h"
 #include "json/serialization.h"
+#include "json/document.h"
+#include "json/lazy.h"
+#include "json/ndjson.h"
+#include "json/stream_archive.h"
 #endif // #ifndef INCLUDE_GUARD_PFI_TEXT_JSON_H_
@@ -45,6 +45,7 @@
 #include "../../lang/shared_ptr.h"
 #include "../../data/string/ustring.h"
 #include "../../data/unordered_map.h"
+#include "number.h"
 
 namespace pfi {
 namespace text {
@@ -232,7 +233,8 @@ public:
   int64_t get() const { return dat; }
 
   void print(std::ostream& os, bool /* escape */) const {
-    os << dat;
+    char buf[int_chars_size];
+    os.write(buf, format_int(dat, buf));
   }
 
 private:
@@ -253,16 +255,10 @@ public:
 
   double get() const { return dat; }
 
+  // the shortest digits which are read back to the value
   void print(std::ostream& os, bool /* escape */) const {
-    const std::streamsize prec = os.precision();
-    try {
-      os << std::setprecision(12)
-         << dat;
-    } catch (...) {
-      os << std::setprecision(prec);
-      throw;
-    }
-    os << std::setprecision(prec);
+    char buf[double_chars_size];
+    os.write(buf, format_double(dat, buf));
   }
 
 private:
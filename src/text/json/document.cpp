@@ -0,0 +1,397 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "document.h"
+
+#include <algorithm>
+#include <new>
+
+#include "parser.h"
+
+namespace pfi {
+namespace text {
+namespace json {
+
+namespace {
+const size_t min_block_size = 4096;
+}
+
+json_document::json_document()
+  : cur(NULL), left(0), allocated(0)
+{
+  root_ = make_null();
+}
+
+json_document::json_document(const json& j)
+  : cur(NULL), left(0), allocated(0)
+{
+  assign(j);
+}
+
+json_document::~json_document()
+{
+  clear();
+}
+
+void json_document::clear()
+{
+  for (size_t i = 0; i < blocks.size(); i++)
+    free(blocks[i]);
+  blocks.clear();
+  cur = NULL;
+  left = 0;
+  allocated = 0;
+  root_ = make_null();
+}
+
+void* json_document::allocate(size_t size)
+{
+  size = (size + 7) & ~static_cast<size_t>(7);
+  if (size > left) {
+    // blocks grow with the document
+    size_t n = std::max(std::max(size, min_block_size), allocated);
+    char* p = static_cast<char*>(malloc(n));
+    if (!p)
+      throw std::bad_alloc();
+    blocks.push_back(p);
+    cur = p;
+    left = n;
+    allocated += n;
+  }
+  void* ret = cur;
+  cur += size;
+  left -= size;
+  return ret;
+}
+
+json_doc_value json_document::make_null()
+{
+  json_doc_value v;
+  v.type_ = json::Null;
+  v.size_ = 0;
+  v.u.i = 0;
+  return v;
+}
+
+json_doc_value json_document::make_bool(bool b)
+{
+  json_doc_value v;
+  v.type_ = json::Bool;
+  v.size_ = 0;
+  v.u.i = b;
+  return v;
+}
+
+json_doc_value json_document::make_integer(int64_t n)
+{
+  json_doc_value v;
+  v.type_ = json::Integer;
+  v.size_ = 0;
+  v.u.i = n;
+  return v;
+}
+
+json_doc_value json_document::make_float(double d)
+{
+  json_doc_value v;
+  v.type_ = json::Float;
+  v.size_ = 0;
+  v.u.f = d;
+  return v;
+}
+
+json_doc_value json_document::make_string(const char* p, size_t len)
+{
+  json_doc_value v;
+  v.type_ = json::String;
+  v.size_ = len;
+  if (len <= sizeof(v.u.small)) {
+    std::memcpy(v.u.small, p, len);
+  } else {
+    char* s = static_cast<char*>(allocate(len));
+    std::memcpy(s, p, len);
+    v.u.str = s;
+  }
+  return v;
+}
+
+json_doc_value json_document::make_array(const json_doc_value* vs, size_t n)
+{
+  json_doc_value v;
+  v.type_ = json::Array;
+  v.size_ = n;
+  json_doc_value* arr = static_cast<json_doc_value*>(allocate(n * sizeof(json_doc_value)));
+  std::copy(vs, vs + n, arr);
+  v.u.arr = arr;
+  return v;
+}
+
+json_doc_value json_document::make_object(const json_doc_member* ms, size_t n)
+{
+  json_doc_value v;
+  v.type_ = json::Object;
+  v.size_ = n;
+  json_doc_member* obj = static_cast<json_doc_member*>(allocate(n * sizeof(json_doc_member)));
+  std::copy(ms, ms + n, obj);
+  v.u.obj = obj;
+  return v;
+}
+
+// values are built on stacks, and arrays and objects are moved to the
+// arena when they end
+class json_document::builder : public json_parser::callback {
+public:
+  explicit builder(json_document& doc) : doc(doc) {}
+
+  const json_doc_value& get() const {
+    if (stk.size() != 1)
+      throw pfi::lang::parse_error();
+    return stk[0];
+  }
+
+  void null() {
+    stk.push_back(doc.make_null());
+  }
+
+  void boolean(bool val) {
+    stk.push_back(doc.make_bool(val));
+  }
+
+  void integer(int64_t val) {
+    stk.push_back(doc.make_integer(val));
+  }
+
+  void number(double val) {
+    stk.push_back(doc.make_float(val));
+  }
+
+  void string(const char* val, size_t len) {
+    stk.push_back(doc.make_string(val, len));
+  }
+
+  void start_object() {
+    ixs.push_back(stk.size());
+  }
+  void object_key(const char* val, size_t len) {
+    keys.push_back(doc.make_string(val, len));
+  }
+  void end_object() {
+    size_t ix = ixs.back();
+    size_t sz = stk.size() - ix;
+    members.resize(sz);
+    for (size_t i = 0; i < sz; i++) {
+      members[i].key = keys[keys.size() - sz + i];
+      members[i].value = stk[ix + i];
+    }
+    json_doc_value obj = doc.make_object(sz ? &members[0] : NULL, sz);
+    stk.resize(ix);
+    keys.resize(keys.size() - sz);
+    stk.push_back(obj);
+    ixs.pop_back();
+  }
+
+  void start_array() {
+    ixs.push_back(stk.size());
+  }
+  void end_array() {
+    size_t ix = ixs.back();
+    size_t sz = stk.size() - ix;
+    json_doc_value arr = doc.make_array(sz ? &stk[ix] : NULL, sz);
+    stk.resize(ix);
+    stk.push_back(arr);
+    ixs.pop_back();
+  }
+
+private:
+  json_document& doc;
+  std::vector<json_doc_value> stk;
+  std::vector<json_doc_value> keys;
+  std::vector<json_doc_member> members;
+  std::vector<size_t> ixs;
+};
+
+void json_document::parse(const char* p, size_t size)
+{
+  clear();
+  builder b(*this);
+  json_parser(p, size).parse_stream(b);
+  root_ = b.get();
+}
+
+void json_document::parse(std::istream& is)
+{
+  clear();
+  builder b(*this);
+  json_parser(is).parse_stream(b);
+  root_ = b.get();
+}
+
+void json_document::assign(const json& j)
+{
+  clear();
+  root_ = convert(j);
+}
+
+json_doc_value json_document::convert(const json& j)
+{
+  switch (j.type()) {
+  case json::Null:
+    return make_null();
+  case json::Integer:
+    return make_integer(static_cast<const json_integer*>(j.get())->get());
+  case json::Float:
+    return make_float(static_cast<const json_float*>(j.get())->get());
+  case json::Bool:
+    return make_bool(static_cast<const json_bool*>(j.get())->get());
+  case json::String: {
+    const std::string& s = static_cast<const json_string*>(j.get())->get();
+    return make_string(s.data(), s.size());
+  }
+  case json::Array: {
+    std::vector<json_doc_value> vs(j.size());
+    for (size_t i = 0; i < vs.size(); i++)
+      vs[i] = convert(j[i]);
+    return make_array(vs.empty() ? NULL : &vs[0], vs.size());
+  }
+  case json::Object: {
+    std::vector<json_doc_member> ms;
+    ms.reserve(j.size());
+    for (json::const_iterator it = j.begin(); it != j.end(); ++it) {
+      json_doc_member m;
+      m.key = make_string(it->first.data(), it->first.size());
+      m.value = convert(it->second);
+      ms.push_back(m);
+    }
+    return make_object(ms.empty() ? NULL : &ms[0], ms.size());
+  }
+  }
+  return make_null();
+}
+
+json json_doc_value::to_json() const
+{
+  switch (type_) {
+  case json::Integer:
+    return json(new json_integer(u.i));
+  case json::Float:
+    return json(new json_float(u.f));
+  case json::Bool:
+    return json(new json_bool(u.i != 0));
+  case json::String:
+    return json(new json_string(get_string()));
+  case json::Array: {
+    json arr(new json_array());
+    for (size_t i = 0; i < size_; i++)
+      arr.add(u.arr[i].to_json());
+    return arr;
+  }
+  case json::Object: {
+    json obj(new json_object());
+    for (size_t i = 0; i < size_; i++)
+      obj.add(u.obj[i].key.get_string(), u.obj[i].value.to_json());
+    return obj;
+  }
+  default:
+    return json(new json_null());
+  }
+}
+
+void json_doc_value::print(std::ostream& os, bool escape) const
+{
+  switch (type_) {
+  case json::Integer:
+    json_integer(u.i).print(os, escape);
+    break;
+  case json::Float:
+    json_float(u.f).print(os, escape);
+    break;
+  case json::Bool:
+    json_bool(u.i != 0).print(os, escape);
+    break;
+  case json::String:
+    json_string::print(os, get_string(), escape);
+    break;
+  case json::Array:
+    os << '[';
+    for (size_t i = 0; i < size_; i++) {
+      if (i > 0)
+        os << ',';
+      u.arr[i].print(os, escape);
+    }
+    os << ']';
+    break;
+  case json::Object:
+    os << '{';
+    for (size_t i = 0; i < size_; i++) {
+      if (i > 0)
+        os << ',';
+      json_string::print(os, u.obj[i].key.get_string(), escape);
+      os << ':';
+      u.obj[i].value.print(os, escape);
+    }
+    os << '}';
+    break;
+  default:
+    os << "null";
+  }
+}
+
+void json_doc_value::pretty(std::ostream& os, int level, bool escape) const
+{
+  if (type_ != json::Array && type_ != json::Object) {
+    print(os, escape);
+    return;
+  }
+
+  os << (type_ == json::Array ? '[' : '{');
+  for (size_t i = 0; i < size_; i++) {
+    if (i > 0)
+      os << ',';
+    os << std::endl;
+    for (int j = 0; j < (level+1)*2; j++)
+      os << ' ';
+    if (type_ == json::Array) {
+      u.arr[i].pretty(os, level+1, escape);
+    } else {
+      json_string::print(os, u.obj[i].key.get_string(), escape);
+      os << ": ";
+      u.obj[i].value.pretty(os, level+1, escape);
+    }
+  }
+  os << std::endl;
+  for (int i = 0; i < level*2; i++)
+    os << ' ';
+  os << (type_ == json::Array ? ']' : '}');
+}
+
+} // json
+} // text
+} // pfi
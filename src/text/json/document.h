@@ -0,0 +1,350 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_TEXT_JSON_DOCUMENT_H_
+#define INCLUDE_GUARD_PFI_TEXT_JSON_DOCUMENT_H_
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "../../lang/noncopyable.h"
+#include "base.h"
+#include "cast.h"
+
+namespace pfi {
+namespace text {
+namespace json {
+
+class json_document;
+struct json_doc_member;
+
+// a read-only json value in the arena of a json_document. a value is 16
+// bytes: strings of up to 8 bytes are stored in the value itself, and
+// arrays and objects are flat arrays of values and of key/value pairs.
+class json_doc_value {
+public:
+  typedef const json_doc_member* const_iterator;
+
+  json::json_type_t type() const {
+    return static_cast<json::json_type_t>(type_);
+  }
+
+  // the value of the last member named name. throws std::out_of_range
+  // when there is no such member.
+  const json_doc_value& operator[](const std::string& name) const;
+  const json_doc_value& operator[](size_t ix) const;
+
+  // returns NULL when there is no such member
+  const json_doc_value* find(const char* name, size_t len) const;
+
+  size_t count(const std::string& name) const {
+    return find(name.data(), name.size()) ? 1 : 0;
+  }
+
+  // the number of elements of an array or members of an object
+  size_t size() const;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  int64_t get_integer() const;
+  double get_float() const;
+  bool get_bool() const;
+
+  // string data, not null-terminated
+  const char* data() const;
+  size_t length() const;
+  std::string get_string() const;
+
+  json to_json() const;
+
+  void print(std::ostream& os, bool escape) const;
+  void pretty(std::ostream& os, bool escape) const;
+
+private:
+  friend class json_document;
+
+  void pretty(std::ostream& os, int level, bool escape) const;
+  const json_doc_value* as(json::json_type_t t, const char* msg) const;
+
+  uint8_t type_;
+  uint32_t size_;
+  union {
+    int64_t i;
+    double f;
+    char small[8];
+    const char* str;
+    const json_doc_value* arr;
+    const json_doc_member* obj;
+  } u;
+};
+
+struct json_doc_member {
+  json_doc_value key;
+  json_doc_value value;
+};
+
+// a json document whose values are allocated in one arena, which is freed
+// at once by clear() and by the destructor. documents are much cheaper to
+// build and drop than json, which allocates a node for each value.
+class json_document : pfi::lang::noncopyable {
+public:
+  json_document();
+  explicit json_document(const json& j);
+  ~json_document();
+
+  // parses one json value, replacing the document
+  void parse(const char* p, size_t size);
+  void parse(std::istream& is);
+
+  void assign(const json& j);
+  void clear();
+
+  const json_doc_value& root() const { return root_; }
+
+  const json_doc_value& operator[](const std::string& name) const {
+    return root_[name];
+  }
+  const json_doc_value& operator[](size_t ix) const {
+    return root_[ix];
+  }
+
+  // bytes allocated for the arena
+  size_t capacity() const { return allocated; }
+
+private:
+  class builder;
+
+  void* allocate(size_t size);
+
+  json_doc_value make_null();
+  json_doc_value make_bool(bool b);
+  json_doc_value make_integer(int64_t n);
+  json_doc_value make_float(double d);
+  json_doc_value make_string(const char* p, size_t len);
+  json_doc_value make_array(const json_doc_value* vs, size_t n);
+  json_doc_value make_object(const json_doc_member* ms, size_t n);
+  json_doc_value convert(const json& j);
+
+  std::vector<char*> blocks;
+  char* cur;
+  size_t left;
+  size_t allocated;
+
+  json_doc_value root_;
+};
+
+inline const json_doc_value* json_doc_value::as(json::json_type_t t, const char* msg) const
+{
+  if (type_ != t)
+    throw json_bad_cast<json_doc_value>(msg);
+  return this;
+}
+
+inline const json_doc_value& json_doc_value::operator[](const std::string& name) const
+{
+  if (const json_doc_value* v = find(name.data(), name.size()))
+    return *v;
+  throw std::out_of_range("json_doc_value::operator[]");
+}
+
+inline const json_doc_value& json_doc_value::operator[](size_t ix) const
+{
+  as(json::Array, "failed to use json as array.");
+  if (ix >= size_)
+    throw std::out_of_range("json_doc_value::operator[]");
+  return u.arr[ix];
+}
+
+inline const json_doc_value* json_doc_value::find(const char* name, size_t len) const
+{
+  as(json::Object, "failed to use json as object.");
+  for (size_t i = size_; i-- > 0; ) {
+    const json_doc_value& k = u.obj[i].key;
+    if (k.size_ == len && std::memcmp(k.data(), name, len) == 0)
+      return &u.obj[i].value;
+  }
+  return NULL;
+}
+
+inline size_t json_doc_value::size() const
+{
+  if (type_ != json::Array && type_ != json::Object)
+    throw json_bad_cast<size_t>("You failed to use the json as an array or an object.");
+  return size_;
+}
+
+inline json_doc_value::const_iterator json_doc_value::begin() const
+{
+  return as(json::Object, "failed to use json as object.")->u.obj;
+}
+
+inline json_doc_value::const_iterator json_doc_value::end() const
+{
+  return as(json::Object, "failed to use json as object.")->u.obj + size_;
+}
+
+inline int64_t json_doc_value::get_integer() const
+{
+  return as(json::Integer, "failed to use json as integer.")->u.i;
+}
+
+inline double json_doc_value::get_float() const
+{
+  if (type_ == json::Integer)
+    return static_cast<double>(u.i);
+  return as(json::Float, "failed to use json as float.")->u.f;
+}
+
+inline bool json_doc_value::get_bool() const
+{
+  return as(json::Bool, "failed to use json as bool.")->u.i != 0;
+}
+
+inline const char* json_doc_value::data() const
+{
+  as(json::String, "failed to use json as string.");
+  return size_ <= sizeof(u.small) ? u.small : u.str;
+}
+
+inline size_t json_doc_value::length() const
+{
+  return as(json::String, "failed to use json as string.")->size_;
+}
+
+inline std::string json_doc_value::get_string() const
+{
+  return std::string(data(), size_);
+}
+
+inline void json_doc_value::pretty(std::ostream& os, bool escape) const
+{
+  pretty(os, 0, escape);
+  os << std::endl;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const json_doc_value& v)
+{
+  gen_print(os, v, false, true);
+  return os;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const json_document& d)
+{
+  return os << d.root();
+}
+
+inline json to_json(const json_doc_value& v)
+{
+  return v.to_json();
+}
+
+// json_cast of values of documents. scalars are converted directly, and
+// other types through json.
+
+template <class T>
+T json_cast(const json_doc_value& v)
+{
+  return json_cast<T>(v.to_json());
+}
+
+namespace detail {
+template <class T>
+T json_doc_cast_integer(const json_doc_value& v)
+{
+  if (v.type() != json::Integer)
+    throw json_bad_cast<T>("Failed json_cast of json_doc_value to integer.");
+  return static_cast<T>(v.get_integer());
+}
+
+template <class T>
+T json_doc_cast_float(const json_doc_value& v)
+{
+  if (v.type() != json::Integer && v.type() != json::Float)
+    throw json_bad_cast<T>("Failed json_cast of json_doc_value to float.");
+  return static_cast<T>(v.get_float());
+}
+} // detail
+
+template <>
+inline int json_cast(const json_doc_value& v)
+{
+  return detail::json_doc_cast_integer<int>(v);
+}
+
+template <>
+inline long json_cast(const json_doc_value& v)
+{
+  return detail::json_doc_cast_integer<long>(v);
+}
+
+template <>
+inline long long json_cast(const json_doc_value& v)
+{
+  return detail::json_doc_cast_integer<long long>(v);
+}
+
+template <>
+inline float json_cast(const json_doc_value& v)
+{
+  return detail::json_doc_cast_float<float>(v);
+}
+
+template <>
+inline double json_cast(const json_doc_value& v)
+{
+  return detail::json_doc_cast_float<double>(v);
+}
+
+template <>
+inline bool json_cast(const json_doc_value& v)
+{
+  if (v.type() != json::Bool)
+    throw json_bad_cast<bool>("Failed json_cast of json_doc_value to bool.");
+  return v.get_bool();
+}
+
+template <>
+inline std::string json_cast(const json_doc_value& v)
+{
+  if (v.type() != json::String)
+    throw json_bad_cast<std::string>("Failed json_cast of json_doc_value to string.");
+  return v.get_string();
+}
+
+} // json
+} // text
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_TEXT_JSON_DOCUMENT_H_
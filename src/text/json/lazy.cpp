@@ -0,0 +1,522 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lazy.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../../lang/exception.h"
+#include "parser.h"
+
+namespace pfi {
+namespace text {
+namespace json {
+
+namespace {
+
+// returns the first '"', '{', '}', '[' or ']' in [p, end)
+const char* find_bracket(const char* p, const char* end)
+{
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('\"');
+  const __m128i lbrace = _mm_set1_epi8('{');
+  const __m128i rbrace = _mm_set1_epi8('}');
+  const __m128i lbracket = _mm_set1_epi8('[');
+  const __m128i rbracket = _mm_set1_epi8(']');
+  for (; end - p >= 16; p += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i m = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, lbrace)),
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, rbrace), _mm_cmpeq_epi8(x, lbracket)),
+                   _mm_cmpeq_epi8(x, rbracket)));
+    if (int mask = _mm_movemask_epi8(m))
+      return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p != end; ++p) {
+    switch (*p) {
+    case '\"': case '{': case '}': case '[': case ']':
+      return p;
+    }
+  }
+  return p;
+}
+
+// returns the first '"' or '\\' in [p, end)
+const char* find_quote(const char* p, const char* end)
+{
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('\"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  for (; end - p >= 16; p += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, bslash));
+    if (int mask = _mm_movemask_epi8(m))
+      return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p != end; ++p)
+    if (*p == '\"' || *p == '\\')
+      return p;
+  return p;
+}
+
+bool is_delimiter(char c)
+{
+  switch (c) {
+  case ',': case ']': case '}':
+  case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+    return true;
+  }
+  return false;
+}
+
+void throw_end_of_data()
+{
+  throw pfi::lang::end_of_data("lazy_json reached end of data");
+}
+
+} // namespace
+
+lazy_json::lazy_json(const char* p, size_t size)
+  : begin(p), cur(p), end(p + size)
+{
+  cur = skip_ws(cur);
+}
+
+lazy_json::lazy_json(const std::string& s)
+  : begin(s.data()), cur(s.data()), end(s.data() + s.size())
+{
+  cur = skip_ws(cur);
+}
+
+json::json_type_t lazy_json::type() const
+{
+  if (cur == end)
+    throw_end_of_data();
+
+  switch (*cur) {
+  case '{':
+    return json::Object;
+  case '[':
+    return json::Array;
+  case '\"':
+    return json::String;
+  case 't': case 'f':
+    return json::Bool;
+  case 'n':
+    return json::Null;
+  case '-':
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    for (const char* p = cur; p != end && !is_delimiter(*p); ++p)
+      if (*p == '.' || *p == 'e' || *p == 'E')
+        return json::Float;
+    return json::Integer;
+  }
+
+  error(cur, "invalid char");
+  return json::Null;
+}
+
+lazy_json lazy_json::operator[](const std::string& name) const
+{
+  if (const char* p = find(name.data(), name.size()))
+    return lazy_json(begin, p, end);
+  throw std::out_of_range("lazy_json::operator[]");
+}
+
+lazy_json lazy_json::operator[](size_t ix) const
+{
+  if (type() != json::Array)
+    throw json_bad_cast<lazy_json>("failed to use json as array.");
+
+  const char* p = skip_ws(cur + 1);
+  if (p != end && *p == ']')
+    throw std::out_of_range("lazy_json::operator[]");
+
+  for (size_t i = 0; ; i++) {
+    if (i == ix)
+      return lazy_json(begin, p, end);
+    p = skip_ws(skip_value(p));
+    if (p == end)
+      throw_end_of_data();
+    if (*p == ']')
+      throw std::out_of_range("lazy_json::operator[]");
+    expect(p, ',');
+    p = skip_ws(p + 1);
+  }
+}
+
+size_t lazy_json::count(const std::string& name) const
+{
+  return find(name.data(), name.size()) ? 1 : 0;
+}
+
+size_t lazy_json::size() const
+{
+  json::json_type_t t = type();
+  if (t != json::Array && t != json::Object)
+    throw json_bad_cast<size_t>("You failed to use the json as an array or an object.");
+
+  const char close = t == json::Array ? ']' : '}';
+  const char* p = skip_ws(cur + 1);
+  if (p != end && *p == close)
+    return 0;
+
+  for (size_t n = 1; ; n++) {
+    if (t == json::Object) {
+      p = skip_ws(skip_string(p));
+      expect(p, ':');
+      p = skip_ws(p + 1);
+    }
+    p = skip_ws(skip_value(p));
+    if (p == end)
+      throw_end_of_data();
+    if (*p == close)
+      return n;
+    expect(p, ',');
+    p = skip_ws(p + 1);
+  }
+}
+
+void lazy_json::members(std::vector<std::pair<std::string, lazy_json> >& ms) const
+{
+  if (type() != json::Object)
+    throw json_bad_cast<lazy_json>("failed to use json as object.");
+
+  ms.clear();
+  const char* p = skip_ws(cur + 1);
+  if (p != end && *p == '}')
+    return;
+
+  for (;;) {
+    std::string key;
+    p = skip_ws(read_key(p, key));
+    expect(p, ':');
+    p = skip_ws(p + 1);
+    ms.push_back(std::make_pair(key, lazy_json(begin, p, end)));
+    p = skip_ws(skip_value(p));
+    if (p == end)
+      throw_end_of_data();
+    if (*p == '}')
+      return;
+    expect(p, ',');
+    p = skip_ws(p + 1);
+  }
+}
+
+void lazy_json::elements(std::vector<lazy_json>& es) const
+{
+  if (type() != json::Array)
+    throw json_bad_cast<lazy_json>("failed to use json as array.");
+
+  es.clear();
+  const char* p = skip_ws(cur + 1);
+  if (p != end && *p == ']')
+    return;
+
+  for (;;) {
+    es.push_back(lazy_json(begin, p, end));
+    p = skip_ws(skip_value(p));
+    if (p == end)
+      throw_end_of_data();
+    if (*p == ']')
+      return;
+    expect(p, ',');
+    p = skip_ws(p + 1);
+  }
+}
+
+// reads the key at p, and returns the char after it
+const char* lazy_json::read_key(const char* p, std::string& key) const
+{
+  const char* key_end = skip_string(p);
+  if (std::memchr(p + 1, '\\', key_end - p - 2))
+    key = json_cast<std::string>(json_parser(p, key_end - p).parse());
+  else
+    key.assign(p + 1, key_end - 1);
+  return key_end;
+}
+
+json lazy_json::get() const
+{
+  return json_parser(cur, end - cur).parse();
+}
+
+size_t lazy_json::length() const
+{
+  return skip_value(cur) - cur;
+}
+
+lazy_json lazy_json::next() const
+{
+  const char* p = skip_ws(skip_value(cur));
+  if (p == end)
+    throw_end_of_data();
+  return lazy_json(begin, p, end);
+}
+
+const char* lazy_json::find(const char* name, size_t len) const
+{
+  if (type() != json::Object)
+    throw json_bad_cast<lazy_json>("failed to use json as object.");
+
+  const char* p = skip_ws(cur + 1);
+  if (p != end && *p == '}')
+    return NULL;
+
+  // the rest is scanned after a match, as the last duplicate wins
+  const char* found = NULL;
+  for (;;) {
+    expect(p, '\"');
+    const char* key_end = skip_string(p);
+    const char* key = p + 1;
+    size_t key_len = key_end - 1 - key;
+
+    bool matched;
+    if (std::memchr(key, '\\', key_len)) {
+      std::string k = json_cast<std::string>(json_parser(p, key_end - p).parse());
+      matched = k.size() == len && std::memcmp(k.data(), name, len) == 0;
+    } else {
+      matched = key_len == len && std::memcmp(key, name, len) == 0;
+    }
+
+    p = skip_ws(key_end);
+    expect(p, ':');
+    p = skip_ws(p + 1);
+    if (matched)
+      found = p;
+
+    p = skip_ws(skip_value(p));
+    if (p == end)
+      throw_end_of_data();
+    if (*p == '}')
+      return found;
+    expect(p, ',');
+    p = skip_ws(p + 1);
+  }
+}
+
+const char* lazy_json::skip_ws(const char* p) const
+{
+  while (p != end) {
+    switch (*p) {
+    case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+      ++p;
+      continue;
+    }
+    break;
+  }
+  return p;
+}
+
+const char* lazy_json::skip_value(const char* p) const
+{
+  if (p == end)
+    throw_end_of_data();
+
+  switch (*p) {
+  case '\"':
+    return skip_string(p);
+
+  case '{':
+  case '[': {
+    int depth = 0;
+    for (;;) {
+      p = find_bracket(p, end);
+      if (p == end)
+        throw_end_of_data();
+      switch (*p) {
+      case '\"':
+        p = skip_string(p);
+        continue;
+      case '{': case '[':
+        depth++;
+        break;
+      default:
+        depth--;
+        break;
+      }
+      ++p;
+      if (depth == 0)
+        return p;
+    }
+  }
+
+  default:
+    while (p != end && !is_delimiter(*p))
+      ++p;
+    return p;
+  }
+}
+
+// returns the char after the string at p
+const char* lazy_json::skip_string(const char* p) const
+{
+  expect(p, '\"');
+  ++p;
+  for (;;) {
+    p = find_quote(p, end);
+    if (p == end)
+      throw_end_of_data();
+    if (*p == '\"')
+      return p + 1;
+    // an escaped char
+    p += 2;
+    if (p > end)
+      throw_end_of_data();
+  }
+}
+
+void lazy_json::expect(const char* p, char c) const
+{
+  if (p == end)
+    throw_end_of_data();
+  if (*p != c)
+    error(p, std::string("\'")+c+"\' is required but got \'"+*p+"\'");
+}
+
+void lazy_json::error(const char* p, const std::string& msg) const
+{
+  int lineno = 1, charno = 1;
+  for (const char* q = begin; q != p; ++q) {
+    if (*q == '\n') {
+      lineno++;
+      charno = 1;
+    } else if ((*q & 0xC0) != 0x80) {
+      charno++;
+    }
+  }
+  throw pfi::lang::parse_error("<buffer>", lineno, charno, msg);
+}
+
+namespace {
+
+class scalar_reader : public json_parser::callback {
+public:
+  void boolean(bool val) { b = val; }
+  void integer(int64_t val) { i = val; d = val; }
+  void number(double val) { d = val; }
+  void string(const char* val, size_t len) { s.assign(val, len); }
+
+  bool b;
+  int64_t i;
+  double d;
+  std::string s;
+};
+
+void read_scalar(const lazy_json& v, scalar_reader& r)
+{
+  json_parser(v.data(), v.length()).parse_stream(r);
+}
+
+template <class T>
+T read_integer(const lazy_json& v)
+{
+  if (v.type() != json::Integer)
+    throw json_bad_cast<T>("Failed json_cast of lazy_json to integer.");
+  scalar_reader r;
+  read_scalar(v, r);
+  return static_cast<T>(r.i);
+}
+
+template <class T>
+T read_float(const lazy_json& v)
+{
+  json::json_type_t t = v.type();
+  if (t != json::Integer && t != json::Float)
+    throw json_bad_cast<T>("Failed json_cast of lazy_json to float.");
+  scalar_reader r;
+  read_scalar(v, r);
+  return static_cast<T>(r.d);
+}
+
+} // namespace
+
+template <>
+int json_cast(const lazy_json& v)
+{
+  return read_integer<int>(v);
+}
+
+template <>
+long json_cast(const lazy_json& v)
+{
+  return read_integer<long>(v);
+}
+
+template <>
+long long json_cast(const lazy_json& v)
+{
+  return read_integer<long long>(v);
+}
+
+template <>
+float json_cast(const lazy_json& v)
+{
+  return read_float<float>(v);
+}
+
+template <>
+double json_cast(const lazy_json& v)
+{
+  return read_float<double>(v);
+}
+
+template <>
+bool json_cast(const lazy_json& v)
+{
+  if (v.type() != json::Bool)
+    throw json_bad_cast<bool>("Failed json_cast of lazy_json to bool.");
+  scalar_reader r;
+  read_scalar(v, r);
+  return r.b;
+}
+
+template <>
+std::string json_cast(const lazy_json& v)
+{
+  if (v.type() != json::String)
+    throw json_bad_cast<std::string>("Failed json_cast of lazy_json to string.");
+  scalar_reader r;
+  read_scalar(v, r);
+  return r.s;
+}
+
+} // json
+} // text
+} // pfi
@@ -0,0 +1,131 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INCLUDE_GUARD_PFI_TEXT_JSON_LAZY_H_
+#define INCLUDE_GUARD_PFI_TEXT_JSON_LAZY_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "base.h"
+#include "cast.h"
+
+namespace pfi {
+namespace text {
+namespace json {
+
+// a cursor to a json value in a buffer, which is parsed only when it is
+// read. operator[] skips the members and elements before the one looked up
+// by matching brackets, without building values or validating them:
+//
+//   lazy_json doc(buf, size);
+//   int64_t id = json_cast<int64_t>(doc["user"]["id"]);
+//
+// the buffer must outlive cursors. errors in skipped values may not be
+// detected.
+class lazy_json {
+public:
+  lazy_json(const char* p, size_t size);
+  explicit lazy_json(const std::string& s);
+
+  json::json_type_t type() const;
+
+  // throws std::out_of_range when there is no such member or element. of
+  // duplicated names, the last member is looked up as json does.
+  lazy_json operator[](const std::string& name) const;
+  lazy_json operator[](size_t ix) const;
+
+  size_t count(const std::string& name) const;
+
+  // the number of elements of an array or members of an object
+  size_t size() const;
+
+  // the members of an object and the elements of an array in order,
+  // found in one pass
+  void members(std::vector<std::pair<std::string, lazy_json> >& ms) const;
+  void elements(std::vector<lazy_json>& es) const;
+
+  // parses the value
+  json get() const;
+
+  // true when only whitespace is left at the cursor
+  bool empty() const { return cur == end; }
+
+  // the text of the value
+  const char* data() const { return cur; }
+  size_t length() const;
+
+  // the cursor to the value following this one in the buffer, e.g. the
+  // next record of concatenated json values. throws end_of_data at the
+  // end of the buffer.
+  lazy_json next() const;
+
+private:
+  lazy_json(const char* begin, const char* cur, const char* end)
+    : begin(begin), cur(cur), end(end) {}
+
+  // returns the last member named name, or NULL
+  const char* find(const char* name, size_t len) const;
+  const char* read_key(const char* p, std::string& key) const;
+
+  const char* skip_ws(const char* p) const;
+  const char* skip_value(const char* p) const;
+  const char* skip_string(const char* p) const;
+  void expect(const char* p, char c) const;
+  void error(const char* p, const std::string& msg) const;
+
+  const char* begin;
+  const char* cur;
+  const char* end;
+};
+
+template <class T>
+T json_cast(const lazy_json& v)
+{
+  return json_cast<T>(v.get());
+}
+
+// scalars are read without building json
+template <> int json_cast(const lazy_json& v);
+template <> long json_cast(const lazy_json& v);
+template <> long long json_cast(const lazy_json& v);
+template <> float json_cast(const lazy_json& v);
+template <> double json_cast(const lazy_json& v);
+template <> bool json_cast(const lazy_json& v);
+template <> std::string json_cast(const lazy_json& v);
+
+} // json
+} // text
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_TEXT_JSON_LAZY_H_
@@ -0,0 +1,279 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "ndjson.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../concurrent/lock.h"
+#include "../../lang/bind.h"
+#include "../../lang/exception.h"
+#include "parser.h"
+
+using pfi::concurrent::scoped_lock;
+using pfi::lang::shared_ptr;
+
+namespace pfi {
+namespace text {
+namespace json {
+
+ndjson_reader::ndjson_reader(bool ordered, int threads, size_t chunk_size)
+  : ordered(ordered), threads(threads), chunk_size(chunk_size),
+    begin(NULL), end(NULL),
+    pool(pfi::concurrent::thread_pool::shared()), tasks(pool),
+    next_chunk(0), outstanding(0), running(0), stopping(false),
+    consumed(0), pos(0),
+    error_pos(0)
+{
+  if (this->threads <= 0)
+    this->threads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+  if (this->threads <= 0)
+    this->threads = 1;
+  if (this->chunk_size == 0)
+    this->chunk_size = 1;
+}
+
+ndjson_reader::~ndjson_reader()
+{
+  close();
+}
+
+int ndjson_reader::open(const std::string& filename)
+{
+  close();
+  pfi::system::mmapper::mmapper tmp;
+  if (tmp.open(filename, false) < 0) {
+    // an empty file cannot be mapped
+    struct stat st;
+    if (stat(filename.c_str(), &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_size != 0 || access(filename.c_str(), R_OK) < 0)
+      return -1;
+  }
+  file.swap(tmp);
+  begin = file.begin();
+  end = file.end();
+  start(filename);
+  return 0;
+}
+
+void ndjson_reader::open(const char* p, size_t size)
+{
+  close();
+  begin = p;
+  end = p + size;
+  start("<buffer>");
+}
+
+void ndjson_reader::close()
+{
+  {
+    scoped_lock lock(m);
+    stopping = true;
+  }
+  try {
+    tasks.wait();
+  } catch (const pfi::concurrent::task_error&) {
+  }
+
+  ready.clear();
+  bounds.clear();
+  cur.reset();
+  file.close();
+  begin = end = NULL;
+}
+
+bool ndjson_reader::next(json& j)
+{
+  for (;;) {
+    if (cur) {
+      if (error_pos < cur->errors.size() && cur->errors[error_pos].value == pos)
+        throw_error(*cur, cur->errors[error_pos++]);
+      if (pos < cur->values.size()) {
+        j = cur->values[pos++];
+        return true;
+      }
+      cur.reset();
+    }
+
+    if (bounds.empty() || consumed == bounds.size() - 1)
+      return false;
+
+    for (;;) {
+      {
+        scoped_lock lock(m);
+        if (!ready.empty() && (!ordered || ready.begin()->first == consumed)) {
+          cur = ready.begin()->second;
+          ready.erase(ready.begin());
+          consumed++;
+          outstanding--;
+          schedule();
+          break;
+        }
+      }
+
+      // the chunk may be queued behind other tasks, so this thread helps
+      if (!pool.run_one()) {
+        scoped_lock lock(m);
+        if (ready.empty() || (ordered && ready.begin()->first != consumed))
+          cond.wait(m);
+      }
+    }
+    pos = 0;
+    error_pos = 0;
+  }
+}
+
+void ndjson_reader::start(const std::string& name)
+{
+  this->name = name;
+
+  // chunks end at newlines
+  bounds.push_back(begin);
+  for (const char* p = begin; p != end; ) {
+    if (static_cast<size_t>(end - p) <= chunk_size) {
+      p = end;
+    } else {
+      const void* nl = std::memchr(p + chunk_size, '\n', end - p - chunk_size);
+      p = nl ? static_cast<const char*>(nl) + 1 : end;
+    }
+    bounds.push_back(p);
+  }
+
+  next_chunk = 0;
+  outstanding = 0;
+  running = 0;
+  stopping = false;
+  consumed = 0;
+  pos = 0;
+  error_pos = 0;
+
+  scoped_lock lock(m);
+  schedule();
+}
+
+// called with m locked
+void ndjson_reader::schedule()
+{
+  // parsed chunks which are not returned yet are limited
+  const size_t window = 2 * static_cast<size_t>(threads);
+
+  while (!stopping && running < static_cast<size_t>(threads) &&
+         outstanding < window && next_chunk < bounds.size() - 1) {
+    running++;
+    outstanding++;
+    tasks.run(pfi::lang::bind(&ndjson_reader::parse, this, next_chunk++));
+  }
+}
+
+void ndjson_reader::parse(size_t index)
+{
+  shared_ptr<chunk> c(new chunk());
+  c->index = index;
+  bool skip;
+  {
+    scoped_lock lock(m);
+    skip = stopping;
+  }
+  if (!skip)
+    parse_chunk(*c);
+
+  {
+    scoped_lock lock(m);
+    ready[index] = c;
+    running--;
+    schedule();
+  }
+  cond.notify_all();
+}
+
+void ndjson_reader::parse_chunk(chunk& c) const
+{
+  const char* p = bounds[c.index];
+  const char* chunk_end = bounds[c.index + 1];
+
+  for (size_t line = 0; p != chunk_end; line++) {
+    const void* nl = std::memchr(p, '\n', chunk_end - p);
+    const char* line_end = nl ? static_cast<const char*>(nl) : chunk_end;
+
+    const char* q = p;
+    while (q != line_end && (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\v' || *q == '\f'))
+      ++q;
+
+    if (q != line_end) {
+      try {
+        json_parser jp(p, line_end - p);
+        json v = jp.parse();
+        bool more = true;
+        try {
+          jp.parse();
+        } catch (const pfi::lang::end_of_data&) {
+          more = false;
+        }
+        if (more)
+          add_error(c, line, 0, "more than one value in a line");
+        else
+          c.values.push_back(v);
+      } catch (const pfi::lang::parse_error& e) {
+        add_error(c, line, e.pos(), e.msg());
+      } catch (const pfi::lang::end_of_data&) {
+        add_error(c, line, 0, "unexpected end of line");
+      }
+    }
+
+    p = nl ? line_end + 1 : chunk_end;
+  }
+}
+
+void ndjson_reader::add_error(chunk& c, size_t line, int pos,
+                              const std::string& msg)
+{
+  error e;
+  e.value = c.values.size();
+  e.line = line;
+  e.pos = pos;
+  e.msg = msg;
+  c.errors.push_back(e);
+}
+
+void ndjson_reader::throw_error(const chunk& c, const error& e) const
+{
+  const size_t lines = std::count(begin, bounds[c.index], '\n');
+  throw pfi::lang::parse_error(name, static_cast<int>(lines + e.line + 1),
+                               e.pos, e.msg);
+}
+
+} // json
+} // text
+} // pfi
@@ -0,0 +1,145 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef INCLUDE_GUARD_PFI_TEXT_JSON_NDJSON_H_
+#define INCLUDE_GUARD_PFI_TEXT_JSON_NDJSON_H_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base.h"
+#include "../../concurrent/condition.h"
+#include "../../concurrent/mutex.h"
+#include "../../concurrent/thread_pool.h"
+#include "../../lang/noncopyable.h"
+#include "../../lang/shared_ptr.h"
+#include "../../system/mmapper.h"
+
+namespace pfi {
+namespace text {
+namespace json {
+
+// reads newline-delimited json, one value in a line, which is split into
+// chunks of lines parsed on thread_pool::shared():
+//
+//   ndjson_reader r;
+//   if (r.open("log.json") < 0) ...
+//   json j;
+//   while (r.next(j)) ...
+//
+// values are returned in the order of the input when ordered is true, and
+// as chunks are parsed otherwise. blank lines are skipped. an error in a
+// line is thrown from next() as parse_error with the line number in the
+// input, after the values of the lines before it in the chunk, and the
+// reader continues with the next line.
+class ndjson_reader : pfi::lang::noncopyable {
+public:
+  // up to threads chunks are parsed at once. threads = 0 means the number
+  // of online processors.
+  explicit ndjson_reader(bool ordered = true, int threads = 0,
+                         size_t chunk_size = 1 << 20);
+  ~ndjson_reader();
+
+  // maps the file. returns -1 when it cannot be mapped, except that an
+  // empty file is read as an empty input.
+  int open(const std::string& filename);
+
+  // reads [p, p + size), which must outlive the reader
+  void open(const char* p, size_t size);
+
+  // waits for the chunks being parsed
+  void close();
+
+  // returns false at the end of the input
+  bool next(json& j);
+
+private:
+  // an error in a line counted from the chunk, which is thrown before
+  // values[value] of the chunk
+  struct error {
+    size_t value;
+    size_t line;
+    int pos;
+    std::string msg;
+  };
+
+  struct chunk {
+    size_t index;
+    std::vector<json> values;
+    std::vector<error> errors;
+  };
+
+  void start(const std::string& name);
+  void schedule();
+  void parse(size_t index);
+  void parse_chunk(chunk& c) const;
+  static void add_error(chunk& c, size_t line, int pos, const std::string& msg);
+  void throw_error(const chunk& c, const error& e) const;
+
+  bool ordered;
+  int threads;
+  size_t chunk_size;
+
+  pfi::system::mmapper::mmapper file;
+  std::string name;
+  const char* begin;
+  const char* end;
+
+  // chunk i is [bounds[i], bounds[i + 1])
+  std::vector<const char*> bounds;
+
+  pfi::concurrent::thread_pool& pool;
+  pfi::concurrent::task_group tasks;
+
+  // the state shared with tasks. outstanding chunks are scheduled and not
+  // returned yet, and running ones are being parsed.
+  pfi::concurrent::mutex m;
+  pfi::concurrent::condition cond;
+  size_t next_chunk;
+  size_t outstanding;
+  size_t running;
+  bool stopping;
+  std::map<size_t, pfi::lang::shared_ptr<chunk> > ready;
+
+  // the chunk being returned
+  size_t consumed;
+  pfi::lang::shared_ptr<chunk> cur;
+  size_t pos;
+  size_t error_pos;
+};
+
+} // json
+} // text
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_TEXT_JSON_NDJSON_H_
@@ -0,0 +1,537 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "number.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace pfi {
+namespace text {
+namespace json {
+
+namespace {
+
+const char digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+const uint32_t pow10_32[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// writes n backward from the end of buf, and returns the first char
+char* format_uint_backward(uint64_t n, char* end)
+{
+  char* p = end;
+  while (n >= 100) {
+    const unsigned i = static_cast<unsigned>(n % 100) * 2;
+    n /= 100;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  }
+  if (n >= 10) {
+    const unsigned i = static_cast<unsigned>(n) * 2;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  } else {
+    *--p = static_cast<char>('0' + n);
+  }
+  return p;
+}
+
+// the code from here to the end of grisu2() is derived from diyfp.h and
+// dtoa.h of RapidJSON (https://github.com/Tencent/rapidjson), and is
+// distributed under the following license:
+//
+// Copyright (C) 2011 Milo Yip
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip.
+// All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// the shortest digits are found by grisu2 (Florian Loitsch, "Printing
+// floating-point numbers quickly and accurately with integers", PLDI 2010),
+// which finds them for almost all values, and a few more digits which are
+// still read back to the value for the others.
+
+struct diy_fp {
+  diy_fp() : f(0), e(0) {}
+  diy_fp(uint64_t f, int e) : f(f), e(e) {}
+
+  explicit diy_fp(double d) {
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    const int biased_e = static_cast<int>((bits >> 52) & 0x7FF);
+    const uint64_t significand = bits & frac_mask;
+    if (biased_e != 0) {
+      f = significand | hidden_bit;
+      e = biased_e - exponent_bias;
+    } else {
+      f = significand;
+      e = 1 - exponent_bias;
+    }
+  }
+
+  diy_fp operator-(const diy_fp& r) const {
+    return diy_fp(f - r.f, e);
+  }
+
+  // the upper 64 bits of the product, rounded
+  diy_fp operator*(const diy_fp& r) const {
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    const uint64_t a = f >> 32, b = f & m32, c = r.f >> 32, d = r.f & m32;
+    const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    tmp += 1U << 31;
+    return diy_fp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + r.e + 64);
+  }
+
+  diy_fp normalize() const {
+    const int s = __builtin_clzll(f);
+    return diy_fp(f << s, e - s);
+  }
+
+  diy_fp normalize_boundary() const {
+    diy_fp res = *this;
+    while (!(res.f & (hidden_bit << 1))) {
+      res.f <<= 1;
+      res.e--;
+    }
+    res.f <<= 64 - 52 - 2;
+    res.e -= 64 - 52 - 2;
+    return res;
+  }
+
+  // the boundaries of the values which are rounded to this
+  void normalized_boundaries(diy_fp& minus, diy_fp& plus) const {
+    diy_fp pl = diy_fp((f << 1) + 1, e - 1).normalize_boundary();
+    diy_fp mi = (f == hidden_bit) ? diy_fp((f << 2) - 1, e - 2) : diy_fp((f << 1) - 1, e - 1);
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    plus = pl;
+    minus = mi;
+  }
+
+  static const uint64_t frac_mask = 0x000FFFFFFFFFFFFFULL;
+  static const uint64_t hidden_bit = 0x0010000000000000ULL;
+  static const int exponent_bias = 0x3FF + 52;
+
+  uint64_t f;
+  int e;
+};
+
+// 10^-348, 10^-340, ..., 10^340
+const uint64_t cached_powers_f[] = {
+  0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+  0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+  0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+  0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+  0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+  0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+  0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+  0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+  0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+  0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+  0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+  0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+  0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+  0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+  0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+  0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+  0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+  0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+  0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+  0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+  0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+  0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+  0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+  0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+  0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+  0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+  0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+  0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+  0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL,
+};
+
+const int16_t cached_powers_e[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+  -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+  -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+  -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+  -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+  109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+  641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+// returns 10^-k, for the k which makes the exponent of the product with a
+// number of the binary exponent e in [-60, -32]
+diy_fp get_cached_power(int e, int& k)
+{
+  const double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = static_cast<int>(dk);
+  if (dk - ik > 0.0)
+    ik++;
+  const unsigned index = static_cast<unsigned>((ik >> 3) + 1);
+  k = -(-348 + static_cast<int>(index << 3));
+  return diy_fp(cached_powers_f[index], cached_powers_e[index]);
+}
+
+void grisu_round(char* buf, int len, uint64_t delta, uint64_t rest,
+                 uint64_t ten_kappa, uint64_t wp_w)
+{
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+int count_digits(uint32_t n)
+{
+  int d = 1;
+  while (d < 10 && n >= pow10_32[d])
+    d++;
+  return d;
+}
+
+void digit_gen(const diy_fp& w, const diy_fp& mp, uint64_t delta,
+               char* buf, int& len, int& k)
+{
+  const diy_fp one(1ULL << -mp.e, mp.e);
+  const diy_fp wp_w = mp - w;
+  uint32_t p1 = static_cast<uint32_t>(mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = count_digits(p1);
+  len = 0;
+
+  while (kappa > 0) {
+    const uint32_t d = p1 / pow10_32[kappa - 1];
+    p1 %= pow10_32[kappa - 1];
+    if (d || len)
+      buf[len++] = static_cast<char>('0' + d);
+    kappa--;
+    const uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      k += kappa;
+      grisu_round(buf, len, delta, rest,
+                  static_cast<uint64_t>(pow10_32[kappa]) << -one.e, wp_w.f);
+      return;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    const char d = static_cast<char>(p2 >> -one.e);
+    if (d || len)
+      buf[len++] = static_cast<char>('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      k += kappa;
+      const int index = -kappa;
+      grisu_round(buf, len, delta, p2, one.f,
+                  wp_w.f * (index < 9 ? pow10_32[index] : 0));
+      return;
+    }
+  }
+}
+
+// writes the digits of d > 0 at buf, where d = digits * 10^k
+void grisu2(double d, char* buf, int& len, int& k)
+{
+  const diy_fp v(d);
+  diy_fp w_m, w_p;
+  v.normalized_boundaries(w_m, w_p);
+
+  const diy_fp c_mk = get_cached_power(w_p.e, k);
+  const diy_fp w = v.normalize() * c_mk;
+  diy_fp wp = w_p * c_mk;
+  diy_fp wm = w_m * c_mk;
+  wm.f++;
+  wp.f--;
+  digit_gen(w, wp, wp.f - wm.f, buf, len, k);
+}
+
+// the end of the code derived from RapidJSON
+
+char* write_exponent(int e, char* p)
+{
+  if (e < 0) {
+    *p++ = '-';
+    e = -e;
+  } else {
+    *p++ = '+';
+  }
+  if (e < 10)
+    *p++ = '0';
+  char tmp[8];
+  char* end = tmp + sizeof(tmp);
+  char* q = format_uint_backward(static_cast<uint64_t>(e), end);
+  std::memcpy(p, q, end - q);
+  return p + (end - q);
+}
+
+bool is_digit(char c)
+{
+  return '0' <= c && c <= '9';
+}
+
+bool strtod_range(const char* p, const char* end, double& d)
+{
+  char tmp[64];
+  std::string s;
+  const char* src;
+  const size_t len = end - p;
+  if (len < sizeof(tmp)) {
+    std::memcpy(tmp, p, len);
+    tmp[len] = '\0';
+    src = tmp;
+  } else {
+    s.assign(p, end);
+    src = s.c_str();
+  }
+
+  errno = 0;
+  d = std::strtod(src, NULL);
+  return errno != ERANGE;
+}
+
+// 10^i which are exact in double
+const double exact_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+  1e21, 1e22
+};
+
+} // namespace
+
+size_t format_int(int64_t n, char* buf)
+{
+  char tmp[int_chars_size];
+  char* end = tmp + sizeof(tmp);
+  char* p;
+  if (n < 0) {
+    p = format_uint_backward(-static_cast<uint64_t>(n), end);
+    *--p = '-';
+  } else {
+    p = format_uint_backward(static_cast<uint64_t>(n), end);
+  }
+  std::memcpy(buf, p, end - p);
+  return end - p;
+}
+
+size_t format_double(double d, char* buf)
+{
+  char* p = buf;
+
+  if (d != d) {
+    std::memcpy(p, "nan", 3);
+    return 3;
+  }
+  uint64_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  if (bits >> 63) {
+    *p++ = '-';
+    d = -d;
+  }
+  if (d == 0.0) {
+    *p++ = '0';
+    return p - buf;
+  }
+  if (d > 1.7976931348623157e308) {
+    std::memcpy(p, "inf", 3);
+    return p + 3 - buf;
+  }
+
+  char digits[32];
+  int len, k;
+  grisu2(d, digits, len, k);
+
+  // the decimal exponent of the first digit
+  const int x = len + k - 1;
+
+  if (x < -4 || 17 <= x) {
+    // d.ddde+xx
+    *p++ = digits[0];
+    if (len > 1) {
+      *p++ = '.';
+      std::memcpy(p, digits + 1, len - 1);
+      p += len - 1;
+    }
+    *p++ = 'e';
+    p = write_exponent(x, p);
+  } else if (x < 0) {
+    // 0.000ddd
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = -1; i > x; --i)
+      *p++ = '0';
+    std::memcpy(p, digits, len);
+    p += len;
+  } else if (len <= x + 1) {
+    // ddd000
+    std::memcpy(p, digits, len);
+    p += len;
+    for (int i = len; i <= x; ++i)
+      *p++ = '0';
+  } else {
+    // ddd.ddd
+    std::memcpy(p, digits, x + 1);
+    p += x + 1;
+    *p++ = '.';
+    std::memcpy(p, digits + x + 1, len - x - 1);
+    p += len - x - 1;
+  }
+  return p - buf;
+}
+
+bool parse_int(const char* p, const char* end, int64_t& n)
+{
+  const bool neg = p != end && *p == '-';
+  if (neg)
+    ++p;
+
+  const uint64_t limit = neg ? static_cast<uint64_t>(LLONG_MAX) + 1 : LLONG_MAX;
+  uint64_t v = 0;
+  for (; p != end && is_digit(*p); ++p) {
+    const unsigned d = *p - '0';
+    if (v > (limit - d) / 10) {
+      n = neg ? LLONG_MIN : LLONG_MAX;
+      return false;
+    }
+    v = v * 10 + d;
+  }
+
+  n = neg ? static_cast<int64_t>(-v) : static_cast<int64_t>(v);
+  return true;
+}
+
+bool parse_double(const char* p, const char* end, double& d)
+{
+  const char* begin = p;
+  const bool neg = p != end && *p == '-';
+  if (neg)
+    ++p;
+
+  // the significant digits, and the decimal exponent
+  uint64_t m = 0;
+  int n = 0;
+  int e = 0;
+  for (; p != end && is_digit(*p); ++p) {
+    m = m * 10 + (*p - '0');
+    if (m)
+      n++;
+  }
+  if (p != end && *p == '.') {
+    for (++p; p != end && is_digit(*p); ++p) {
+      m = m * 10 + (*p - '0');
+      if (m)
+        n++;
+      e--;
+    }
+  }
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool eneg = false;
+    if (p != end && (*p == '+' || *p == '-'))
+      eneg = *p++ == '-';
+    int x = 0;
+    for (; p != end && is_digit(*p); ++p)
+      if (x < 100000)
+        x = x * 10 + (*p - '0');
+    e += eneg ? -x : x;
+  }
+
+  if (n == 0) {
+    d = neg ? -0.0 : 0.0;
+    return true;
+  }
+
+#if defined(__FLT_EVAL_METHOD__) && __FLT_EVAL_METHOD__ == 0
+  // both m and 10^|e| are exact, so the result is rounded once (Clinger's
+  // fast path)
+  const uint64_t max_exact = 1ULL << 53;
+  if (n <= 19 && m <= max_exact) {
+    // moves the zeros of large exponents to m, when it is still exact
+    while (e > 22 && m * 10 <= max_exact) {
+      m *= 10;
+      e--;
+    }
+    if (-22 <= e && e <= 22) {
+      double r = static_cast<double>(m);
+      if (e < 0)
+        r /= exact_pow10[-e];
+      else
+        r *= exact_pow10[e];
+      d = neg ? -r : r;
+      return true;
+    }
+  }
+#endif
+
+  return strtod_range(begin, end, d);
+}
+
+} // json
+} // text
+} // pfi
@@ -0,0 +1,68 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef INCLUDE_GUARD_PFI_TEXT_JSON_NUMBER_H_
+#define INCLUDE_GUARD_PFI_TEXT_JSON_NUMBER_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace pfi {
+namespace text {
+namespace json {
+
+// conversions between numbers and their json text, without iostreams or
+// the locale.
+
+// the buffer sizes which are large enough for format_int and format_double
+const size_t int_chars_size = 24;
+const size_t double_chars_size = 32;
+
+// writes n at buf, and returns the length. buf is not terminated.
+size_t format_int(int64_t n, char* buf);
+
+// writes a short text which is read back to d, in the way of printf
+// "%.17g" except for the number of digits, e.g. "0.1", "1e+100" and "123".
+// the digits are the shortest ones for almost all values. returns the
+// length, and buf is not terminated.
+size_t format_double(double d, char* buf);
+
+// read a number in the json syntax from [p, end). they return false when
+// it is out of the range, leaving the result of strtoll() or strtod() at
+// n or d.
+bool parse_int(const char* p, const char* end, int64_t& n);
+bool parse_double(const char* p, const char* end, double& d);
+
+} // json
+} // text
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_TEXT_JSON_NUMBER_H_
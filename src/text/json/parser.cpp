@@ -41,7 +41,12 @@
 #include <cstdio>
 #include <cstdlib>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "../../lang/exception.h"
+#include "number.h"
 
 namespace pfi {
 namespace text {
@@ -116,7 +121,17 @@ public:
 };
 
 json_parser::json_parser(std::istream& is)
-  : is(is), it(is), end(), lineno(1), charno(1), cbuf(-1)
+  : it(is), end(), mem_begin(NULL), mem_cur(NULL), mem_end(NULL),
+    lineno(1), charno(1), cbuf(-1)
+{
+  buf_len = 256;
+  if ((buf = static_cast<char*>(malloc(buf_len))) == 0)
+    throw std::bad_alloc();
+}
+
+json_parser::json_parser(const char* p, size_t size)
+  : it(), end(), mem_begin(p), mem_cur(p), mem_end(p + size),
+    lineno(1), charno(1), cbuf(-1)
 {
   buf_len = 256;
   if ((buf = static_cast<char*>(malloc(buf_len))) == 0)
@@ -137,6 +152,12 @@ json json_parser::parse()
 
 void json_parser::parse_stream(callback& cb)
 {
+  if (mem_begin) {
+    mem_ss();
+    mem_peek();
+    return mem_parse_impl(cb);
+  }
+
   ss();
   if (cbuf < 0 && it == end)
     throw lang::end_of_data("json_parser reached end of data");
@@ -234,7 +255,8 @@ void json_parser::parse_array(callback& cb)
 
 void json_parser::parse_number(callback& cb)
 {
-  std::string src;
+  std::string& src = num_buf;
+  src.clear();
   bool is_frac = false;
 
   if (peek() == '-') {
@@ -276,13 +298,14 @@ void json_parser::parse_number(callback& cb)
     incr();
   }
 
-  const char* srcptr = src.c_str();
-  char* endptr;
+  parse_number_chars(cb, src.data(), src.data() + src.size(), is_frac);
+}
 
+void json_parser::parse_number_chars(callback& cb, const char* p, const char* end, bool is_frac)
+{
   if (is_frac) {
-    errno = 0;
-    double num = strtod(srcptr, &endptr);
-    if (errno == ERANGE) {
+    double num;
+    if (!parse_double(p, end, num)) {
       if (num == HUGE_VALF || num == HUGE_VALL)
         error("strtod overflow range over. Too huge value for double.");
       else if (num == 0.0)
@@ -291,15 +314,9 @@ void json_parser::parse_number(callback& cb)
     }
     cb.number(num);
   } else {
-    errno = 0;
-    int64_t num = strtoll(srcptr, &endptr, 10);
-    if (errno == ERANGE) {
-      if (num == LLONG_MAX || num == LLONG_MIN)
-        error("strtoll overflow range over. Too huge value for int64_t.");
-      else if (num == 0)
-        error("strtoll underflow range over.");
-      error("strtoll range over.");
-    }
+    int64_t num;
+    if (!parse_int(p, end, num))
+      error("strtoll overflow range over. Too huge value for int64_t.");
     cb.integer(num);
   }
 }
@@ -415,10 +432,357 @@ void json_parser::parse_true(callback& cb)
   cb.boolean(true);
 }
 
+// the buffer mode
+
+namespace {
+
+// returns the first '"', '\\', control or non-ASCII char in [p, end)
+const char* find_special(const char* p, const char* end)
+{
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('\"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i ctrl = _mm_set1_epi8(0x1f);
+  for (; end - p >= 16; p += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote),
+                                          _mm_cmpeq_epi8(x, bslash)),
+                             _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl));
+    // the sign bits of x are the non-ASCII chars
+    int mask = _mm_movemask_epi8(m) | _mm_movemask_epi8(x);
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p != end; ++p) {
+    unsigned char c = *p;
+    if (c == '\"' || c == '\\' || c < 0x20 || c >= 0x80)
+      break;
+  }
+  return p;
+}
+
+bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+void json_parser::mem_parse_impl(callback& cb)
+{
+  switch(mem_speek()) {
+  case '{':
+    mem_parse_object(cb);
+    return;
+
+  case '[':
+    mem_parse_array(cb);
+    return;
+
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+  case '-':
+    mem_parse_number(cb);
+    return;
+
+  case '\"': {
+    const char* str;
+    int len = 0;
+    mem_parse_string_prim(str, len);
+    cb.string(str, len);
+    return;
+  }
+
+  case 'f':
+    mem_parse_literal("false");
+    cb.boolean(false);
+    return;
+  case 'n':
+    mem_parse_literal("null");
+    cb.null();
+    return;
+  case 't':
+    mem_parse_literal("true");
+    cb.boolean(true);
+    return;
+
+  default:
+    mem_invalid_char("invalid char", mem_cur);
+  }
+}
+
+void json_parser::mem_parse_object(callback& cb)
+{
+  cb.start_object();
+
+  mem_smatch('{');
+
+  for (int i = 0; ; i++) {
+    if (mem_speek() == '}')
+      break;
+    if (i > 0)
+      mem_smatch(',');
+
+    mem_ss();
+    const char* key;
+    int len = 0;
+    mem_parse_string_prim(key, len);
+    cb.object_key(key, len);
+    mem_smatch(':');
+    mem_parse_impl(cb);
+  }
+
+  mem_smatch('}');
+
+  cb.end_object();
+}
+
+void json_parser::mem_parse_array(callback& cb)
+{
+  cb.start_array();
+
+  mem_smatch('[');
+
+  for (int i = 0; ; i++) {
+    if (mem_speek() == ']')
+      break;
+    if (i > 0)
+      mem_smatch(',');
+
+    mem_parse_impl(cb);
+  }
+
+  mem_smatch(']');
+
+  cb.end_array();
+}
+
+void json_parser::mem_parse_number(callback& cb)
+{
+  const char* p = mem_cur;
+  const char* begin = p;
+  bool is_frac = false;
+
+  if (*p == '-')
+    ++p;
+  while (p != mem_end && is_digit(*p))
+    ++p;
+
+  if (p != mem_end && *p == '.') {
+    is_frac = true;
+    ++p;
+    while (p != mem_end && is_digit(*p))
+      ++p;
+  }
+
+  if (p != mem_end && (*p == 'e' || *p == 'E')) {
+    is_frac = true;
+    ++p;
+
+    if (p == mem_end) {
+      mem_cur = p;
+      error("after exp, digit required.");
+    }
+
+    if (*p == '+' || *p == '-')
+      ++p;
+  }
+
+  while (p != mem_end && is_digit(*p))
+    ++p;
+
+  mem_cur = p;
+  parse_number_chars(cb, begin, p, is_frac);
+}
+
+void json_parser::mem_parse_literal(const char* lit)
+{
+  for (; *lit; ++lit)
+    mem_match(*lit);
+}
+
+void json_parser::mem_parse_string_prim(const char*& str, int& str_len)
+{
+  mem_match('\"');
+
+  // chars are copied to buf only after an escape
+  const char* seg = mem_cur;
+  char* p = NULL;
+
+  for (;;) {
+    mem_cur = find_special(mem_cur, mem_end);
+    int c = mem_peek();
+
+    if (c == '\"')
+      break;
+
+    if (c >= 0x80) {
+      mem_cur = mem_parse_utf8(mem_cur);
+      continue;
+    }
+
+    if (c != '\\')
+      mem_invalid_char("unexpected unescaped char", mem_cur);
+
+    size_t n = mem_cur - seg;
+    p = reserve_buf(p ? p : buf, n);
+    memcpy(p, seg, n);
+    p += n;
+
+    ++mem_cur;
+    const char* esc = mem_cur;
+    c = mem_peek();
+    ++mem_cur;
+
+    switch (c) {
+    case '\"': *p++ = '\"'; break;
+    case '\\': *p++ = '\\'; break;
+    case '/':  *p++ = '/';  break;
+    case 'b':  *p++ = '\b'; break;
+    case 'f':  *p++ = '\f'; break;
+    case 'n':  *p++ = '\n'; break;
+    case 'r':  *p++ = '\r'; break;
+    case 't':  *p++ = '\t'; break;
+
+    case 'u': {
+      int a = mem_parse_hex();
+      int b = mem_parse_hex();
+      int c = mem_parse_hex();
+      int d = mem_parse_hex();
+      pfi::data::string::uchar_to_chars((a<<12)|(b<<8)|(c<<4)|d, p);
+      break;
+    }
+
+    default:
+      mem_invalid_char("unexpected unescaped char", esc);
+    }
+
+    seg = mem_cur;
+  }
+
+  if (p) {
+    size_t n = mem_cur - seg;
+    p = reserve_buf(p, n);
+    memcpy(p, seg, n);
+    p += n;
+    str = buf;
+    str_len = p - buf;
+  } else {
+    str = seg;
+    str_len = mem_cur - seg;
+  }
+
+  ++mem_cur;
+}
+
+// validates the UTF-8 sequence at p, and returns the next char
+const char* json_parser::mem_parse_utf8(const char* p)
+{
+  const unsigned char* q = reinterpret_cast<const unsigned char*>(p);
+  int n;
+  unsigned int c;
+  if (q[0] >= 0xC2 && q[0] <= 0xDF) {
+    n = 2;
+    c = q[0] & 0x1F;
+  } else if (q[0] >= 0xE0 && q[0] <= 0xEF) {
+    n = 3;
+    c = q[0] & 0x0F;
+  } else if (q[0] >= 0xF0 && q[0] <= 0xF4) {
+    n = 4;
+    c = q[0] & 0x07;
+  } else {
+    mem_cur = p;
+    error("invalid UTF-8");
+    return p;
+  }
+
+  if (mem_end - p < n) {
+    mem_cur = mem_end;
+    mem_peek();
+  }
+
+  for (int i = 1; i < n; i++) {
+    if ((q[i] & 0xC0) != 0x80) {
+      mem_cur = p;
+      error("invalid UTF-8");
+    }
+    c = (c << 6) | (q[i] & 0x3F);
+  }
+
+  // overlong forms, surrogates and chars over U+10FFFF
+  if ((n == 3 && c < 0x800) || (n == 4 && c < 0x10000) ||
+      (c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+    mem_cur = p;
+    error("invalid UTF-8");
+  }
+
+  return p + n;
+}
+
+int json_parser::mem_parse_hex()
+{
+  int c = mem_peek();
+  ++mem_cur;
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+
+  error(std::string("hex required but got \'")+(char)c+"\'");
+  return 0;
+}
+
+void json_parser::mem_invalid_char(const char* what, const char* p)
+{
+  mem_cur = p;
+  int c = pfi::data::string::chars_to_uchar(p, mem_end);
+  char err_msg[64];
+  snprintf(err_msg, sizeof(err_msg),
+           "%s: \'%s\' (U+%04X)",
+           what, pfi::data::string::uchar_to_string(c).c_str(), c);
+  error(err_msg);
+}
+
+// returns p moved with buf grown to have n more bytes (and a few for an
+// escape) after p
+char* json_parser::reserve_buf(char* p, size_t n)
+{
+  size_t used = p - buf;
+  size_t len = buf_len;
+  while (used + n + 8 > len)
+    len *= 2;
+  if (len == static_cast<size_t>(buf_len))
+    return p;
+
+  if (char* newbuf = static_cast<char*>(realloc(buf, len)))
+    buf = newbuf;
+  else
+    throw std::bad_alloc();
+  buf_len = len;
+  return buf + used;
+}
+
 void json_parser::error(const std::string& msg)
 {
   std::string filename="<istream>";
-  
+
+  if (mem_begin) {
+    lineno = 1;
+    charno = 1;
+    for (const char* p = mem_begin; p != mem_cur; ++p) {
+      if (*p == '\n') {
+        lineno++;
+        charno = 1;
+      } else if ((*p & 0xC0) != 0x80) {
+        charno++;
+      }
+    }
+    filename = "<buffer>";
+  }
+
   throw pfi::lang::parse_error(filename, lineno, charno, msg);
 }
 
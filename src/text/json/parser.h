@@ -46,6 +46,12 @@ namespace json {
 class json_parser {
 public:
   json_parser(std::istream& is);
+
+  // parses the contiguous buffer [p, p+size), which must outlive the
+  // parser. strings without escapes are passed to callbacks as pointers
+  // into the buffer, and are much faster to parse than from a stream.
+  json_parser(const char* p, size_t size);
+
   ~json_parser();
 
   json parse();
@@ -81,6 +87,48 @@ private:
   void parse_true(callback& cb);
 
   void parse_string_prim(char*& buf, int& buf_len, int& str_len);
+  void parse_number_chars(callback& cb, const char* p, const char* end, bool is_frac);
+
+  // the buffer mode
+  void mem_parse_impl(callback& cb);
+  void mem_parse_object(callback& cb);
+  void mem_parse_array(callback& cb);
+  void mem_parse_number(callback& cb);
+  void mem_parse_literal(const char* lit);
+  void mem_parse_string_prim(const char*& str, int& str_len);
+  const char* mem_parse_utf8(const char* p);
+  int mem_parse_hex();
+  void mem_invalid_char(const char* what, const char* p);
+  char* reserve_buf(char* p, size_t n);
+
+  int mem_peek() {
+    if (mem_cur == mem_end)
+      throw pfi::lang::end_of_data("json_parser reached end of data");
+    return static_cast<unsigned char>(*mem_cur);
+  }
+  void mem_ss() {
+    while (mem_cur != mem_end) {
+      switch (*mem_cur) {
+      case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+        ++mem_cur;
+        continue;
+      }
+      break;
+    }
+  }
+  void mem_match(char c) {
+    if (mem_peek() != static_cast<unsigned char>(c))
+      error(std::string("\'")+c+"\' is required but got \'"+*mem_cur+"\'");
+    ++mem_cur;
+  }
+  int mem_speek() {
+    mem_ss();
+    return mem_peek();
+  }
+  void mem_smatch(char c) {
+    mem_ss();
+    mem_match(c);
+  }
 
   int parse_hex() {
     int c = incr();
@@ -152,14 +200,21 @@ private:
 
   void error(const std::string& msg);
 
-  std::istream& is;
   std::istreambuf_iterator<char> it, end;
 
+  // the buffer mode when mem_begin is not NULL
+  const char* mem_begin;
+  const char* mem_cur;
+  const char* mem_end;
+
   int lineno, charno;
   int cbuf;
 
   char* buf;
   int buf_len;
+
+  // the chars of a number in the stream mode, which is reused
+  std::string num_buf;
 };
 
 inline std::istream& operator>>(std::istream& is, json& j)
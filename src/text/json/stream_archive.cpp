@@ -0,0 +1,277 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "stream_archive.h"
+
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+#include "../../data/string/ustring.h"
+#include "number.h"
+
+using pfi::text::json::json;
+using pfi::text::json::lazy_json;
+
+namespace pfi {
+namespace data {
+namespace serialization {
+
+namespace {
+
+const size_t flush_size = 64 * 1024;
+
+char tohex(int c)
+{
+  if (c <= 9)
+    return '0' + c;
+  return 'A' + c - 10;
+}
+
+// whether c is written as is by json_string::print
+bool is_plain(unsigned char c)
+{
+  return c >= 0x20 && c < 0x7F && c != '\"' && c != '\\' && c != '/';
+}
+
+void append_escaped(std::string& buf, char c)
+{
+  switch (c) {
+  case '\"': buf += "\\\""; return;
+  case '\\': buf += "\\\\"; return;
+  case '/':  buf += "\\/"; return;
+  case '\b': buf += "\\b"; return;
+  case '\f': buf += "\\f"; return;
+  case '\n': buf += "\\n"; return;
+  case '\r': buf += "\\r"; return;
+  case '\t': buf += "\\t"; return;
+  }
+  if (iscntrl(c)) {
+    buf += "\\u00";
+    buf += tohex((c>>4) & 0xf);
+    buf += tohex(c & 0xf);
+    return;
+  }
+  buf += c;
+}
+
+} // namespace
+
+json_stream_oarchive::json_stream_oarchive(std::ostream& os, bool escape)
+  : os(os), escape(escape), after_key(false)
+{
+}
+
+void json_stream_oarchive::begin_object()
+{
+  separator();
+  buf += '{';
+  first.push_back(1);
+}
+
+void json_stream_oarchive::end_object()
+{
+  buf += '}';
+  first.pop_back();
+}
+
+void json_stream_oarchive::begin_array()
+{
+  separator();
+  buf += '[';
+  first.push_back(1);
+}
+
+void json_stream_oarchive::end_array()
+{
+  buf += ']';
+  first.pop_back();
+}
+
+void json_stream_oarchive::key(const std::string& k)
+{
+  separator();
+  append_string(k);
+  buf += ':';
+  after_key = true;
+}
+
+void json_stream_oarchive::write_null()
+{
+  separator();
+  buf += "null";
+}
+
+void json_stream_oarchive::write_bool(bool b)
+{
+  separator();
+  buf += b ? "true" : "false";
+}
+
+void json_stream_oarchive::write_int(long long n)
+{
+  separator();
+  char tmp[pfi::text::json::int_chars_size];
+  buf.append(tmp, pfi::text::json::format_int(n, tmp));
+}
+
+void json_stream_oarchive::write_float(double d)
+{
+  separator();
+  char tmp[pfi::text::json::double_chars_size];
+  buf.append(tmp, pfi::text::json::format_double(d, tmp));
+}
+
+void json_stream_oarchive::write_string(const std::string& s)
+{
+  separator();
+  append_string(s);
+}
+
+void json_stream_oarchive::write_json(const json& js)
+{
+  separator();
+  std::ostringstream oss;
+  js.print(oss, escape);
+  buf += oss.str();
+}
+
+void json_stream_oarchive::flush()
+{
+  os.write(buf.data(), buf.size());
+  buf.clear();
+}
+
+void json_stream_oarchive::separator()
+{
+  if (after_key) {
+    after_key = false;
+    return;
+  }
+  if (first.empty()) {
+    if (buf.size() >= flush_size)
+      flush();
+    return;
+  }
+  if (first.back())
+    first.back() = 0;
+  else
+    buf += ',';
+  if (buf.size() >= flush_size)
+    flush();
+}
+
+// escapes s as json_string::print does, copying runs of plain chars at once
+void json_stream_oarchive::append_string(const std::string& s)
+{
+  buf += '\"';
+  const char* p = s.c_str();
+  const char* end = p + s.size();
+  while (*p) {
+    const char* q = p;
+    while (is_plain(*q))
+      ++q;
+    buf.append(p, q);
+    p = q;
+    if (!*p)
+      break;
+
+    if (escape && static_cast<unsigned char>(*p) > 0x7F) {
+      pfi::data::string::uchar u = pfi::data::string::chars_to_uchar(p, end);
+      buf += "\\u";
+      buf += tohex((u>>12) & 0xf);
+      buf += tohex((u>>8) & 0xf);
+      buf += tohex((u>>4) & 0xf);
+      buf += tohex((u>>0) & 0xf);
+    } else {
+      append_escaped(buf, *p++);
+    }
+  }
+  buf += '\"';
+}
+
+json_stream_iarchive::json_stream_iarchive(const char* p, size_t size)
+  : cur(p, size), depth(0)
+{
+}
+
+json_stream_iarchive::json_stream_iarchive(std::istream& is)
+  : dat(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()),
+    cur(dat), depth(0)
+{
+}
+
+void json_stream_iarchive::enter_object()
+{
+  if (frames.size() == depth)
+    frames.push_back(members_type());
+  cur.members(frames[depth]);
+  depth++;
+}
+
+void json_stream_iarchive::leave_object()
+{
+  depth--;
+}
+
+const lazy_json* json_stream_iarchive::find_member(const std::string& name) const
+{
+  const members_type& ms = frames[depth - 1];
+  for (size_t i = ms.size(); i > 0; --i)
+    if (ms[i - 1].first == name)
+      return &ms[i - 1].second;
+  return NULL;
+}
+
+void json_stream_iarchive::advance()
+{
+  try {
+    cur = cur.next();
+  } catch (const pfi::lang::end_of_data&) {
+    cur = lazy_json(NULL, 0);
+  }
+}
+
+// moves past a value which failed to be read, or to the end when the
+// rest can not be parsed
+void json_stream_iarchive::skip()
+{
+  try {
+    advance();
+  } catch (...) {
+    cur = lazy_json(NULL, 0);
+  }
+}
+
+} // serialization
+} // data
+} // pfi
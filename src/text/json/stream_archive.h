@@ -0,0 +1,434 @@
+// Copyright (c)2008-2011, Preferred Infrastructure Inc.
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+// 
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials provided
+//       with the distribution.
+// 
+//     * Neither the name of Preferred Infrastructure nor the names of other
+//       contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef INCLUDE_GUARD_PFI_TEXT_JSON_STREAM_ARCHIVE_H_
+#define INCLUDE_GUARD_PFI_TEXT_JSON_STREAM_ARCHIVE_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base.h"
+#include "lazy.h"
+#include "../../data/optional.h"
+#include "../../data/serialization.h"
+#include "../../data/unordered_map.h"
+#include "../../lang/exception.h"
+#include "../../lang/noncopyable.h"
+#include "../../lang/safe_bool.h"
+
+namespace pfi {
+namespace data {
+namespace serialization {
+
+// json archives which write and read serialize()d values directly,
+// without building json values. the output is the same as json_oarchive
+// except for the order of object members, which is the order of
+// serialize(). e.g.
+//
+//   json_stream_oarchive oa(os);
+//   oa << v;
+//
+//   json_stream_iarchive ia(buf, size);
+//   ia >> v;
+//
+// values are written one per line, and read one after another.
+
+class json_stream_oarchive : public pfi::lang::safe_bool<json_stream_oarchive> {
+public:
+  explicit json_stream_oarchive(std::ostream& os, bool escape = true);
+
+  static const bool is_read = false;
+
+  template <class T>
+  void put(const T& v) {
+    serialize(*this, const_cast<T&>(v));
+    buf += '\n';
+    flush();
+  }
+
+  bool bool_test() const { return !os.fail(); }
+
+  // tokens, which are used by serialize()
+  void begin_object();
+  void end_object();
+  void begin_array();
+  void end_array();
+  void key(const std::string& k);
+
+  void write_null();
+  void write_bool(bool b);
+  void write_int(long long n);
+  void write_float(double d);
+  void write_string(const std::string& s);
+  void write_json(const pfi::text::json::json& js);
+
+  void flush();
+
+private:
+  void separator();
+  void append_string(const std::string& s);
+
+  std::ostream& os;
+  bool escape;
+  std::string buf;
+
+  // whether the current array or object has no value yet
+  std::vector<char> first;
+  bool after_key;
+};
+
+template <class T>
+json_stream_oarchive& operator<<(json_stream_oarchive& ar, const T& v)
+{
+  ar.put(v);
+  return ar;
+}
+
+template <class T>
+inline json_stream_oarchive& operator&(json_stream_oarchive& ar, T& v)
+{
+  serialize(ar, v);
+  return ar;
+}
+
+template <class T>
+inline void serialize(json_stream_oarchive& ar, T& v)
+{
+  ar.begin_object();
+  access::serialize(ar, v);
+  ar.end_object();
+}
+
+template <class T>
+inline void serialize(json_stream_oarchive& ar, named_value<T>& v)
+{
+  ar.key(v.name);
+  ar & v.v;
+}
+
+inline void serialize(json_stream_oarchive&, class_name&)
+{
+}
+
+// unsigned values are written as int64_t, as json_integer holds them
+#define PFI_JSON_STREAM_OARCHIVE_INT(type)                              \
+  inline void serialize(json_stream_oarchive& ar, type& n)              \
+  {                                                                     \
+    ar.write_int(static_cast<long long>(n));                            \
+  }
+
+PFI_JSON_STREAM_OARCHIVE_INT(int)
+PFI_JSON_STREAM_OARCHIVE_INT(long)
+PFI_JSON_STREAM_OARCHIVE_INT(long long)
+PFI_JSON_STREAM_OARCHIVE_INT(unsigned)
+PFI_JSON_STREAM_OARCHIVE_INT(unsigned long)
+PFI_JSON_STREAM_OARCHIVE_INT(unsigned long long)
+
+#undef PFI_JSON_STREAM_OARCHIVE_INT
+
+inline void serialize(json_stream_oarchive& ar, float& d)
+{
+  ar.write_float(d);
+}
+
+inline void serialize(json_stream_oarchive& ar, double& d)
+{
+  ar.write_float(d);
+}
+
+inline void serialize(json_stream_oarchive& ar, bool& b)
+{
+  ar.write_bool(b);
+}
+
+inline void serialize(json_stream_oarchive& ar, std::string& s)
+{
+  ar.write_string(s);
+}
+
+inline void serialize(json_stream_oarchive& ar, pfi::text::json::json& js)
+{
+  ar.write_json(js);
+}
+
+template <class T, class A>
+inline void serialize(json_stream_oarchive& ar, std::vector<T, A>& v)
+{
+  ar.begin_array();
+  for (size_t i = 0; i < v.size(); ++i)
+    ar & v[i];
+  ar.end_array();
+}
+
+template <class T, class C, class A>
+inline void serialize(json_stream_oarchive& ar, std::map<std::string, T, C, A>& v)
+{
+  ar.begin_object();
+  for (typename std::map<std::string, T, C, A>::iterator it = v.begin(); it != v.end(); ++it) {
+    ar.key(it->first);
+    ar & it->second;
+  }
+  ar.end_object();
+}
+
+template <class V, class H, class P, class A>
+inline void serialize(json_stream_oarchive& ar, pfi::data::unordered_map<std::string, V, H, P, A>& v)
+{
+  typedef pfi::data::unordered_map<std::string, V, H, P, A> map_type;
+  ar.begin_object();
+  for (typename map_type::iterator it = v.begin(); it != v.end(); ++it) {
+    ar.key(it->first);
+    ar & it->second;
+  }
+  ar.end_object();
+}
+
+template <class T>
+inline void serialize(json_stream_oarchive& ar, pfi::data::optional<T>& v)
+{
+  if (v)
+    ar & *v;
+  else
+    ar.write_null();
+}
+
+class json_stream_iarchive : public pfi::lang::safe_bool<json_stream_iarchive> {
+public:
+  json_stream_iarchive(const char* p, size_t size);
+
+  // reads the rest of is first
+  explicit json_stream_iarchive(std::istream& is);
+
+  static const bool is_read = true;
+
+  // throws end_of_data when there are no more values. a value which fails
+  // to be read is skipped, so that the next call reads the next one.
+  template <class T>
+  void get(T& v) {
+    if (cur.empty())
+      throw pfi::lang::end_of_data("json_stream_iarchive reached end of data");
+    depth = 0;
+    try {
+      serialize(*this, v);
+    } catch (...) {
+      skip();
+      throw;
+    }
+    advance();
+  }
+
+  // false when all values are read
+  bool bool_test() const { return !cur.empty(); }
+
+  // the value which is being read, which is used by serialize()
+  const pfi::text::json::lazy_json& current() const { return cur; }
+  void set_current(const pfi::text::json::lazy_json& v) { cur = v; }
+
+  // indexes the members of the current object, to look them up by name
+  void enter_object();
+  void leave_object();
+
+  // returns the last member named name of the innermost object, or NULL
+  const pfi::text::json::lazy_json* find_member(const std::string& name) const;
+
+private:
+  typedef std::vector<std::pair<std::string, pfi::text::json::lazy_json> > members_type;
+
+  void advance();
+  void skip();
+
+  std::string dat;
+  pfi::text::json::lazy_json cur;
+
+  // the members of the objects being read, innermost last. the vectors
+  // are kept to reuse them.
+  std::vector<members_type> frames;
+  size_t depth;
+};
+
+namespace detail {
+
+// restores the current value of ar at the end of the scope, also when
+// serialize() throws
+class json_stream_current_guard : pfi::lang::noncopyable {
+public:
+  explicit json_stream_current_guard(json_stream_iarchive& ar)
+    : ar(ar), saved(ar.current()) {}
+  ~json_stream_current_guard() { ar.set_current(saved); }
+
+private:
+  json_stream_iarchive& ar;
+  const pfi::text::json::lazy_json saved;
+};
+
+} // detail
+
+template <class T>
+json_stream_iarchive& operator>>(json_stream_iarchive& ar, T& v)
+{
+  ar.get(v);
+  return ar;
+}
+
+template <class T>
+inline json_stream_iarchive& operator&(json_stream_iarchive& ar, T& v)
+{
+  serialize(ar, v);
+  return ar;
+}
+
+template <class T>
+inline void serialize(json_stream_iarchive& ar, T& v)
+{
+  ar.enter_object();
+  access::serialize(ar, v);
+  ar.leave_object();
+}
+
+template <class T>
+inline void serialize(json_stream_iarchive& ar, named_value<T>& v)
+{
+  static const char null[] = "null";
+
+  detail::json_stream_current_guard guard(ar);
+  const pfi::text::json::lazy_json* m = ar.find_member(v.name);
+  ar.set_current(m ? *m : pfi::text::json::lazy_json(null, sizeof(null) - 1));
+  ar & v.v;
+}
+
+inline void serialize(json_stream_iarchive&, class_name&)
+{
+}
+
+#define PFI_JSON_STREAM_IARCHIVE_CAST(type, via)                        \
+  inline void serialize(json_stream_iarchive& ar, type& v)              \
+  {                                                                     \
+    v = static_cast<type>(pfi::text::json::json_cast<via>(ar.current())); \
+  }
+
+PFI_JSON_STREAM_IARCHIVE_CAST(int, int)
+PFI_JSON_STREAM_IARCHIVE_CAST(long, long)
+PFI_JSON_STREAM_IARCHIVE_CAST(long long, long long)
+PFI_JSON_STREAM_IARCHIVE_CAST(unsigned, long long)
+PFI_JSON_STREAM_IARCHIVE_CAST(unsigned long, long long)
+PFI_JSON_STREAM_IARCHIVE_CAST(unsigned long long, long long)
+PFI_JSON_STREAM_IARCHIVE_CAST(float, float)
+PFI_JSON_STREAM_IARCHIVE_CAST(double, double)
+PFI_JSON_STREAM_IARCHIVE_CAST(bool, bool)
+PFI_JSON_STREAM_IARCHIVE_CAST(std::string, std::string)
+
+#undef PFI_JSON_STREAM_IARCHIVE_CAST
+
+inline void serialize(json_stream_iarchive& ar, pfi::text::json::json& js)
+{
+  js = ar.current().get();
+}
+
+template <class T, class A>
+inline void serialize(json_stream_iarchive& ar, std::vector<T, A>& v)
+{
+  using pfi::text::json::lazy_json;
+
+  if (ar.current().type() != pfi::text::json::json::Array)
+    throw pfi::text::json::json_bad_cast<std::vector<T, A> >("attempted to convert to vector<T> from other than json_array.");
+
+  std::vector<lazy_json> es;
+  ar.current().elements(es);
+
+  std::vector<T, A> tmp(es.size());
+  detail::json_stream_current_guard guard(ar);
+  for (size_t i = 0; i < es.size(); ++i) {
+    ar.set_current(es[i]);
+    ar & tmp[i];
+  }
+
+  using std::swap;
+  swap(v, tmp);
+}
+
+namespace detail {
+
+template <class Map>
+inline void read_json_stream_object(json_stream_iarchive& ar, Map& v)
+{
+  using pfi::text::json::lazy_json;
+
+  if (ar.current().type() != pfi::text::json::json::Object)
+    throw pfi::text::json::json_bad_cast<Map>("attempted to convert to map from other than json_object.");
+
+  std::vector<std::pair<std::string, lazy_json> > ms;
+  ar.current().members(ms);
+
+  Map tmp;
+  json_stream_current_guard guard(ar);
+  for (size_t i = 0; i < ms.size(); ++i) {
+    ar.set_current(ms[i].second);
+    ar & tmp[ms[i].first];
+  }
+
+  using std::swap;
+  swap(v, tmp);
+}
+
+} // detail
+
+template <class T, class C, class A>
+inline void serialize(json_stream_iarchive& ar, std::map<std::string, T, C, A>& v)
+{
+  detail::read_json_stream_object(ar, v);
+}
+
+template <class V, class H, class P, class A>
+inline void serialize(json_stream_iarchive& ar, pfi::data::unordered_map<std::string, V, H, P, A>& v)
+{
+  detail::read_json_stream_object(ar, v);
+}
+
+template <class T>
+inline void serialize(json_stream_iarchive& ar, pfi::data::optional<T>& v)
+{
+  if (ar.current().type() == pfi::text::json::json::Null) {
+    v = pfi::data::optional<T>();
+  } else {
+    T t;
+    ar & t;
+    v = t;
+  }
+}
+
+} // serialization
+} // data
+} // pfi
+#endif // #ifndef INCLUDE_GUARD_PFI_TEXT_JSON_STREAM_ARCHIVE_H_
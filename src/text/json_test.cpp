@@ -37,6 +37,8 @@
 #include <iostream>
 #include <cmath>
 #include <climits>
+#include <algorithm>
+#include <unistd.h>
 
 #include "../lang/bind.h"
 #include "../lang/cast.h"
@@ -1208,3 +1210,623 @@ TEST(json, invalid_json_num)
     EXPECT_THROW(iss>>j, pfi::lang::parse_error);
   }
 }
+
+namespace {
+
+json parse_buffer(const string& s)
+{
+  return json_parser(s.data(), s.size()).parse();
+}
+
+string json_to_string(const json& j)
+{
+  ostringstream os;
+  os<<j;
+  return os.str();
+}
+
+struct string_collector : public json_parser::callback {
+  void string(const char* p, size_t len) {
+    ptrs.push_back(p);
+    strs.push_back(std::string(p, len));
+  }
+  vector<const char*> ptrs;
+  vector<std::string> strs;
+};
+
+}
+
+TEST(json, parse_buffer)
+{
+  const char* srcs[] = {
+    "1", "-123", "0", "1.234567e-10", "-1E+5", "36893488147419103233e0",
+    "-9223372036854775808", "999999999999999999",
+    "\"hello, \\u0022json!\\\"\"", "\"\\b\\f\\n\\r\\t\\/\\\\\"",
+    "false", "null", "true", "[]", "{}", " [ 1 , [2, {\"a\" :\"b\"}] ]\n",
+    "{\"title\": \"坊ちゃん\", \"long\": \"0123456789abcdefghijklmnopqrstuvwxyz\\n坊ちゃん\"}",
+  };
+  for (size_t i=0;i<sizeof(srcs)/sizeof(srcs[0]);++i) {
+    istringstream iss(srcs[i]);
+    json j; iss>>j;
+    EXPECT_EQ(json_to_string(j), json_to_string(parse_buffer(srcs[i]))) << srcs[i];
+  }
+
+  {
+    // not null terminated
+    string s="123456";
+    EXPECT_EQ(123, json_cast<int>(json_parser(s.data(), 3).parse()));
+  }
+
+  {
+    // strings without escapes point into the buffer
+    string s="[\"abc\", \"d\\ne\", \"0123456789abcdef0123456789\"]";
+    json_parser parser(s.data(), s.size());
+    string_collector sc;
+    parser.parse_stream(sc);
+    ASSERT_EQ(3U, sc.strs.size());
+    EXPECT_EQ("abc", sc.strs[0]);
+    EXPECT_EQ("d\ne", sc.strs[1]);
+    EXPECT_EQ("0123456789abcdef0123456789", sc.strs[2]);
+    EXPECT_EQ(s.data()+2, sc.ptrs[0]);
+    EXPECT_EQ(s.data()+s.find("0123"), sc.ptrs[2]);
+  }
+
+  {
+    string s="{\"a\":\"b\"}\n\n[1,2,3] 4\n";
+    json_parser parser(s.data(), s.size());
+    EXPECT_EQ("b", json_cast<string>(parser.parse()["a"]));
+    EXPECT_EQ(3U, json_cast<vector<int> >(parser.parse()).size());
+    EXPECT_EQ(4, json_cast<int>(parser.parse()));
+    EXPECT_THROW(parser.parse(), pfi::lang::end_of_data);
+  }
+
+  const char* invalids[] = {
+    "[}", "{\"a\":1,}", "tru", "\"\\x\"", "\"\x01\"", "9223372036854775808",
+    "-9223372036854775809", "\"\xff\"", "\"\xc0\xaf\"", "\"\xed\xa0\x80\"",
+    "\"\xf4\x90\x80\x80\"", "\"\xe3\x81\"", "[1,", "\"abc",
+  };
+  for (size_t i=0;i<sizeof(invalids)/sizeof(invalids[0]);++i)
+    EXPECT_ANY_THROW(parse_buffer(invalids[i])) << invalids[i];
+
+  try {
+    parse_buffer("{\n  \"a\": [1, 2 3]\n}");
+    FAIL();
+  } catch (const pfi::lang::parse_error& e) {
+    EXPECT_EQ(2, e.lineno());
+    EXPECT_EQ(14, e.pos());
+  }
+}
+
+TEST(json, document)
+{
+  string s=
+    "{\"id\": 12, \"name\": \"a long name with \\\"escapes\\\"\", \"short\": \"abc\",\n"
+    " \"ratio\": 0.5, \"ok\": true, \"none\": null, \"tags\": [\"x\", \"yy\", [], {}],\n"
+    " \"nested\": {\"list\": [1, 2, 3], \"id\": 1}, \"id\": 13}";
+
+  json_document doc;
+  doc.parse(s.data(), s.size());
+  const json_doc_value& r=doc.root();
+
+  EXPECT_EQ(json::Object, r.type());
+  EXPECT_EQ(9U, r.size());
+  // the last of the duplicate keys
+  EXPECT_EQ(13, json_cast<int>(r["id"]));
+  EXPECT_EQ("a long name with \"escapes\"", json_cast<string>(r["name"]));
+  EXPECT_EQ("abc", json_cast<string>(doc["short"]));
+  EXPECT_DOUBLE_EQ(0.5, json_cast<double>(r["ratio"]));
+  EXPECT_DOUBLE_EQ(13.0, json_cast<double>(r["id"]));
+  EXPECT_TRUE(json_cast<bool>(r["ok"]));
+  EXPECT_EQ(json::Null, r["none"].type());
+  EXPECT_EQ(4U, r["tags"].size());
+  EXPECT_EQ("yy", json_cast<string>(r["tags"][1]));
+  EXPECT_EQ(0U, r["tags"][2].size());
+  EXPECT_EQ(0U, r["tags"][3].size());
+  EXPECT_EQ(1U, r.count("nested"));
+  EXPECT_EQ(0U, r.count("missing"));
+  EXPECT_EQ(3, json_cast<int>(r["nested"]["list"][2]));
+
+  vector<int> v=json_cast<vector<int> >(r["nested"]["list"]);
+  ASSERT_EQ(3U, v.size());
+  EXPECT_EQ(2, v[1]);
+
+  EXPECT_THROW(r["missing"], std::out_of_range);
+  EXPECT_THROW(r[0], json_bad_cast_any);
+  EXPECT_THROW(r["tags"][4], std::out_of_range);
+  EXPECT_THROW(json_cast<int>(r["name"]), json_bad_cast_any);
+  EXPECT_THROW(json_cast<string>(r["id"]), json_bad_cast_any);
+
+  size_t members=0;
+  for (json_doc_value::const_iterator it=r.begin();it!=r.end();++it)
+    members++;
+  EXPECT_EQ(r.size(), members);
+
+  // the same json as parsed into json
+  istringstream iss(s);
+  json j;
+  iss>>j;
+  ostringstream os1, os2;
+  os1<<to_json(r);
+  os2<<j;
+  EXPECT_EQ(os2.str(), os1.str());
+
+  json_document doc2(j);
+  EXPECT_EQ(13, json_cast<int>(doc2["id"]));
+  EXPECT_EQ("a long name with \"escapes\"", json_cast<string>(doc2["name"]));
+  EXPECT_EQ(3U, doc2["nested"]["list"].size());
+
+  ostringstream os3, os4;
+  os3<<doc2;
+  os4<<j;
+  EXPECT_EQ(os4.str(), os3.str());
+
+  {
+    istringstream iss2("[1, \"two\", 3.5]");
+    json_document doc3;
+    doc3.parse(iss2);
+    ostringstream os;
+    os<<doc3;
+    EXPECT_EQ("[1,\"two\",3.5]", os.str());
+    ostringstream pos;
+    pos<<pretty(doc3.root());
+    EXPECT_EQ("[\n  1,\n  \"two\",\n  3.5\n]\n", pos.str());
+  }
+
+  EXPECT_LT(0U, doc.capacity());
+  doc.clear();
+  EXPECT_EQ(0U, doc.capacity());
+  EXPECT_EQ(json::Null, doc.root().type());
+
+  EXPECT_THROW(doc.parse("[1,", 3), pfi::lang::end_of_data);
+}
+
+TEST(json, lazy)
+{
+  string s=
+    "  {\"user\": {\"name\": \"taro \\\"t\\\"\", \"id\": 123, \"tags\": [\"a\", \"}]\", {\"x\": [1, {}]}]},\n"
+    "   \"skipped\": {\"deep\": [[[[\"\\\\\"]]]], \"s\": \"{[\"}, \"ratio\": 2.5e-1,\n"
+    "   \"ok\": false, \"none\": null, \"k\\u0065y\": \"escaped key\", \"empty\": [], \"id\": -7}";
+
+  lazy_json doc(s);
+  EXPECT_EQ(json::Object, doc.type());
+  EXPECT_EQ(8U, doc.size());
+  EXPECT_EQ(123, json_cast<int>(doc["user"]["id"]));
+  EXPECT_EQ("taro \"t\"", json_cast<string>(doc["user"]["name"]));
+  EXPECT_EQ(3U, doc["user"]["tags"].size());
+  EXPECT_EQ("}]", json_cast<string>(doc["user"]["tags"][1]));
+  EXPECT_EQ(json::Object, doc["user"]["tags"][2]["x"][1].type());
+  EXPECT_DOUBLE_EQ(0.25, json_cast<double>(doc["ratio"]));
+  EXPECT_EQ(json::Float, doc["ratio"].type());
+  EXPECT_EQ(json::Integer, doc["id"].type());
+  EXPECT_DOUBLE_EQ(-7.0, json_cast<double>(doc["id"]));
+  EXPECT_FALSE(json_cast<bool>(doc["ok"]));
+  EXPECT_EQ(json::Null, doc["none"].type());
+  EXPECT_EQ("escaped key", json_cast<string>(doc["key"]));
+  EXPECT_EQ(0U, doc["empty"].size());
+  EXPECT_EQ(-7, json_cast<int>(doc["id"]));
+  EXPECT_EQ(1U, doc.count("skipped"));
+  EXPECT_EQ(0U, doc.count("missing"));
+
+  // materialized
+  string nums="[1, 2]";
+  vector<int> v=json_cast<vector<int> >(lazy_json(nums));
+  EXPECT_EQ(2U, v.size());
+  json j=doc["skipped"].get();
+  EXPECT_EQ("{[", json_cast<string>(j["s"]));
+  EXPECT_EQ(string("[[[[\"\\\\\"]]]]"), string(doc["skipped"]["deep"].data(), doc["skipped"]["deep"].length()));
+
+  EXPECT_THROW(doc["missing"], std::out_of_range);
+  EXPECT_THROW(doc["empty"][0], std::out_of_range);
+  EXPECT_THROW(doc["user"][0], json_bad_cast_any);
+  EXPECT_THROW(doc["user"]["id"]["x"], json_bad_cast_any);
+  EXPECT_THROW(json_cast<int>(doc["ratio"]), json_bad_cast_any);
+  EXPECT_THROW(json_cast<string>(doc["id"]), json_bad_cast_any);
+
+  {
+    // concatenated values
+    string rs="{\"id\": 1, \"v\": [1,2]}\n{\"id\": 2}\n{\"v\": {}, \"id\": 3}\n";
+    lazy_json r(rs);
+    int sum=0;
+    for (int i=0;i<3;++i) {
+      sum+=json_cast<int>(r["id"]);
+      if (i<2) r=r.next();
+    }
+    EXPECT_EQ(6, sum);
+    EXPECT_THROW(r.next(), pfi::lang::end_of_data);
+  }
+
+  {
+    // the last of duplicated names, as json
+    string d="{\"a\": 1, \"b\": {\"a\": 0}, \"a\": 3}";
+    lazy_json r(d);
+    EXPECT_EQ(3, json_cast<int>(r["a"]));
+    EXPECT_EQ(json_cast<int>(parse_buffer(d)["a"]), json_cast<int>(r["a"]));
+    EXPECT_EQ(1U, r.count("a"));
+    EXPECT_EQ(3U, r.size());
+  }
+
+  {
+    string t="{\"a\": [1, 2, {\"b\": \"unterminated";
+    lazy_json r(t);
+    EXPECT_THROW(r["c"], pfi::lang::end_of_data);
+    string u="{\"a\" 1}";
+    lazy_json r2(u);
+    EXPECT_THROW(r2["a"], pfi::lang::parse_error);
+  }
+}
+
+struct stream_example {
+  stream_example(): n(0), u(0) {}
+
+  int n;
+  unsigned long long u;
+  vector<example3> xs;
+  map<string, vector<double> > m;
+  pfi::data::optional<string> o;
+  json j;
+
+  template <class Archive>
+  void serialize(Archive &ar){
+    ar & MEMBER(n) & MEMBER(u) & MEMBER(xs) & MEMBER(m) & MEMBER(o) & MEMBER(j);
+  }
+};
+
+TEST(json, stream_archive)
+{
+  {
+    ostringstream os;
+    json_stream_oarchive oa(os);
+
+    oa<<123<<3.14<<string("hoge \"\\/\n\x01 \xE3\x81\x82");
+    vector<int> v;
+    v.push_back(123);
+    v.push_back(-456);
+    oa<<v<<vector<int>();
+
+    ostringstream expected;
+    json_oarchive ea(expected);
+    ea<<123<<3.14<<string("hoge \"\\/\n\x01 \xE3\x81\x82")<<v<<vector<int>();
+    EXPECT_EQ(expected.str(), os.str());
+  }
+
+  {
+    example1 v;
+    v.Image.Width=800;
+    v.Image.Height=600;
+    v.Image.Title="View from 15th Floor";
+    v.Image.Thumbnail.Url="http://www.example.com/image/481989943";
+    v.Image.Thumbnail.Height=125;
+    v.Image.Thumbnail.Width="100";
+    v.Image.IDs.push_back(116);
+    v.Image.IDs.push_back(943);
+
+    stringstream ss;
+    json_stream_oarchive oa(ss);
+    oa<<v;
+    EXPECT_EQ("{\"Image\":{\"Width\":800,\"Height\":600,\"Title\":\"View from 15th Floor\","
+              "\"Thumbnail\":{\"Url\":\"http:\\/\\/www.example.com\\/image\\/481989943\",\"Height\":125,\"Width\":\"100\"},"
+              "\"IDs\":[116,943]}}\n", ss.str());
+
+    // readable by the other archive
+    json_iarchive ia(ss);
+    example1 w;
+    ia>>w;
+    EXPECT_TRUE(v==w);
+  }
+
+  {
+    stream_example v;
+    v.n=-1;
+    v.u=18446744073709551615ULL;
+    v.xs.resize(2);
+    v.xs[1].c="fuga";
+    v.m["a"].push_back(0.5);
+    v.m["b"];
+    v.j=json(new json_array());
+    v.j.add(json(new json_integer(1)));
+
+    stringstream ss;
+    json_stream_oarchive oa(ss);
+    oa<<v;
+    v.o=string("x");
+    oa<<v;
+
+    json_stream_iarchive ia(ss);
+    EXPECT_TRUE(ia);
+    stream_example w, x;
+    ia>>w>>x;
+    EXPECT_FALSE(ia);
+    EXPECT_THROW(ia>>w, pfi::lang::end_of_data);
+
+    EXPECT_EQ(-1, w.n);
+    EXPECT_EQ(v.u, w.u);
+    EXPECT_EQ(2U, w.xs.size());
+    EXPECT_TRUE(v.xs[1]==w.xs[1]);
+    EXPECT_EQ(2U, w.m.size());
+    EXPECT_EQ(1U, w.m["a"].size());
+    EXPECT_DOUBLE_EQ(0.5, w.m["a"][0]);
+    EXPECT_FALSE(w.o);
+    EXPECT_EQ("[1]", json_to_string(w.j));
+    ASSERT_TRUE(x.o);
+    EXPECT_EQ("x", *x.o);
+  }
+
+  {
+    // members are looked up by name, the last one wins, and missing ones
+    // are read from null
+    string s="{\"e\": 2.5, \"d\": false, \"c\": \"a\", \"b\": 1, \"a\": 3, \"a\": 4}";
+    json_stream_iarchive ia(s.data(), s.size());
+    example3 v;
+    ia>>v;
+    EXPECT_EQ(4, v.a);
+    EXPECT_EQ(1.0, v.b);
+    EXPECT_EQ("a", v.c);
+    EXPECT_FALSE(v.d);
+    EXPECT_EQ(2.5f, v.e);
+
+    string t="{\"e\": 2.5, \"d\": false, \"c\": \"a\", \"b\": 1}";
+    json_stream_iarchive ib(t.data(), t.size());
+    EXPECT_THROW(ib>>v, json_bad_cast_any);
+
+    string u="{\"a\": \"1\"}";
+    json_stream_iarchive ic(u.data(), u.size());
+    EXPECT_THROW(ic>>v, json_bad_cast_any);
+
+    string w="[{}]";
+    json_stream_iarchive id(w.data(), w.size());
+    vector<int> xs;
+    EXPECT_THROW(id>>xs, json_bad_cast_any);
+  }
+
+  {
+    // a record which fails to be read is skipped
+    string s=
+      "{\"a\": 1, \"b\": 1, \"c\": \"x\", \"d\": true, \"e\": 1}\n"
+      "{\"a\": \"2\", \"b\": 2, \"c\": \"y\", \"d\": true, \"e\": 2}\n"
+      "{\"a\": 3, \"b\": 3, \"c\": \"z\", \"d\": false, \"e\": 3}\n"
+      "[[1], [\"2\"], [3]]\n"
+      "[[4]]\n"
+      "{\"a\": 5, \"b\": 5, \"c\": \"w\", \"d\": false, \"e\": [}\n";
+    json_stream_iarchive ia(s.data(), s.size());
+    example3 v;
+    ia>>v;
+    EXPECT_EQ(1, v.a);
+    EXPECT_THROW(ia>>v, json_bad_cast_any);
+    EXPECT_TRUE(ia);
+    ia>>v;
+    EXPECT_EQ(3, v.a);
+    EXPECT_EQ("z", v.c);
+
+    vector<vector<int> > xs;
+    EXPECT_THROW(ia>>xs, json_bad_cast_any);
+    ia>>xs;
+    ASSERT_EQ(1U, xs.size());
+    EXPECT_EQ(4, xs[0][0]);
+
+    // the rest can not be parsed
+    EXPECT_ANY_THROW(ia>>v);
+    EXPECT_FALSE(ia);
+  }
+
+  {
+    string s="{\"a\": 1, \"b\\u0021\": [], \"c\": {\"d\": 2}}";
+    lazy_json doc(s);
+    vector<pair<string, lazy_json> > ms;
+    doc.members(ms);
+    ASSERT_EQ(3U, ms.size());
+    EXPECT_EQ("b!", ms[1].first);
+    EXPECT_EQ(json::Array, ms[1].second.type());
+    vector<lazy_json> es;
+    ms[1].second.elements(es);
+    EXPECT_TRUE(es.empty());
+    EXPECT_THROW(ms[0].second.elements(es), json_bad_cast_any);
+  }
+}
+
+TEST(json, number)
+{
+  {
+    const double ds[]={
+      0.1, 0.5, 3.14, -2.5, 1.0, 100.0, 1e16, 1e17, 1e20, 1e-5, 1e-4,
+      123.456, 1.5e-300, 5e-324, 1.7976931348623157e308, 2.2250738585072014e-308,
+      1.0/3, 0.0
+    };
+    const char* ss[]={
+      "0.1", "0.5", "3.14", "-2.5", "1", "100", "10000000000000000", "1e+17", "1e+20", "1e-05", "0.0001",
+      "123.456", "1.5e-300", "5e-324", "1.7976931348623157e+308", "2.2250738585072014e-308",
+      "0.3333333333333333", "0"
+    };
+    for (size_t i=0;i<sizeof(ds)/sizeof(ds[0]);++i) {
+      char buf[double_chars_size];
+      EXPECT_EQ(ss[i], string(buf, format_double(ds[i], buf)));
+      EXPECT_EQ(ss[i], json_to_string(json(new json_float(ds[i]))));
+    }
+    char buf[double_chars_size];
+    EXPECT_EQ("-0", string(buf, format_double(-0.0, buf)));
+  }
+
+  {
+    // every double is read back
+    srand(1);
+    for (int i=0;i<100000;++i) {
+      uint64_t bits=(static_cast<uint64_t>(rand())<<42)^(static_cast<uint64_t>(rand())<<21)^rand();
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      if (d!=d || d-d!=0)
+        continue;
+      char buf[double_chars_size];
+      size_t n=format_double(d, buf);
+      // subnormal values are read, though they are out of the range
+      double r;
+      parse_double(buf, buf+n, r);
+      EXPECT_EQ(d, r) << string(buf, n);
+      EXPECT_EQ(d, strtod(string(buf, n).c_str(), NULL)) << string(buf, n);
+    }
+  }
+
+  {
+    const int64_t ns[]={0, 7, -12, 1234567890123LL, 9223372036854775807LL, LLONG_MIN};
+    for (size_t i=0;i<sizeof(ns)/sizeof(ns[0]);++i) {
+      char buf[int_chars_size];
+      string s(buf, format_int(ns[i], buf));
+      EXPECT_EQ(lexical_cast<string>(ns[i]), s);
+      int64_t r;
+      EXPECT_TRUE(parse_int(s.data(), s.data()+s.size(), r));
+      EXPECT_EQ(ns[i], r);
+    }
+    int64_t r;
+    string over="9223372036854775808";
+    EXPECT_FALSE(parse_int(over.data(), over.data()+over.size(), r));
+    EXPECT_EQ(9223372036854775807LL, r);
+  }
+
+  {
+    // the same values as strtod
+    const char* ss[]={"0.1", "1e23", "123456789.123456789", "9007199254740993", "0.000001e-2", "1E5", "-0.0", "2.5e22", "17e300"};
+    for (size_t i=0;i<sizeof(ss)/sizeof(ss[0]);++i) {
+      double d;
+      EXPECT_TRUE(parse_double(ss[i], ss[i]+strlen(ss[i]), d));
+      EXPECT_EQ(strtod(ss[i], NULL), d) << ss[i];
+    }
+    double d;
+    string big="1e400";
+    EXPECT_FALSE(parse_double(big.data(), big.data()+big.size(), d));
+    EXPECT_THROW(parse_buffer(big), pfi::lang::parse_error);
+  }
+
+  {
+    string s="[0.1, -7, 1e-7, 12345678901234567]";
+    json j=lexical_cast<json>(s);
+    EXPECT_EQ("[0.1,-7,1e-07,12345678901234567]", json_to_string(j));
+    EXPECT_EQ(json_to_string(j), json_to_string(parse_buffer(s)));
+  }
+}
+
+TEST(json, ndjson)
+{
+  string s;
+  for (int i=0;i<1000;++i) {
+    s+="{\"id\": "+lexical_cast<string>(i)+", \"v\": [\"x\", "+lexical_cast<string>(i*2)+"]}\n";
+    if (i%100==0)
+      s+="  \r\n";
+  }
+
+  {
+    ndjson_reader r(true, 4, 100);
+    r.open(s.data(), s.size());
+    json j;
+    int n=0;
+    while (r.next(j)) {
+      EXPECT_EQ(n, json_cast<int>(j["id"]));
+      EXPECT_EQ(n*2, json_cast<int>(j["v"][1]));
+      ++n;
+    }
+    EXPECT_EQ(1000, n);
+    EXPECT_FALSE(r.next(j));
+  }
+
+  {
+    ndjson_reader r(false, 3, 50);
+    r.open(s.data(), s.size());
+    vector<int> ids;
+    json j;
+    while (r.next(j))
+      ids.push_back(json_cast<int>(j["id"]));
+    sort(ids.begin(), ids.end());
+    ASSERT_EQ(1000U, ids.size());
+    for (int i=0;i<1000;++i)
+      EXPECT_EQ(i, ids[i]);
+  }
+
+  {
+    // closed before the end
+    ndjson_reader r(true, 4, 10);
+    r.open(s.data(), s.size());
+    json j;
+    ASSERT_TRUE(r.next(j));
+    EXPECT_EQ(0, json_cast<int>(j["id"]));
+    r.close();
+    EXPECT_FALSE(r.next(j));
+  }
+
+  {
+    // the reader goes on after an error
+    string t="1\n2\n{\"a\": }\n3\n[4\n5 6\n7";
+    ndjson_reader r(true, 2, 1);
+    r.open(t.data(), t.size());
+    json j;
+    vector<int> vs;
+    vector<int> lines;
+    for (;;) {
+      try {
+        if (!r.next(j))
+          break;
+        vs.push_back(json_cast<int>(j));
+      } catch (const pfi::lang::parse_error& e) {
+        EXPECT_EQ("<buffer>", e.filename());
+        lines.push_back(e.lineno());
+      }
+    }
+    ASSERT_EQ(4U, vs.size());
+    EXPECT_EQ(1, vs[0]);
+    EXPECT_EQ(3, vs[2]);
+    EXPECT_EQ(7, vs[3]);
+    ASSERT_EQ(3U, lines.size());
+    EXPECT_EQ(3, lines[0]);
+    EXPECT_EQ(5, lines[1]);
+    EXPECT_EQ(6, lines[2]);
+
+    // the same in one chunk
+    ndjson_reader r2(true, 2);
+    r2.open(t.data(), t.size());
+    vs.clear();
+    lines.clear();
+    for (;;) {
+      try {
+        if (!r2.next(j))
+          break;
+        vs.push_back(json_cast<int>(j));
+      } catch (const pfi::lang::parse_error& e) {
+        lines.push_back(e.lineno());
+        EXPECT_EQ(static_cast<size_t>(e.lineno() - lines.size()), vs.size());
+      }
+    }
+    ASSERT_EQ(4U, vs.size());
+    EXPECT_EQ(2, vs[1]);
+    EXPECT_EQ(7, vs[3]);
+    ASSERT_EQ(3U, lines.size());
+    EXPECT_EQ(3, lines[0]);
+    EXPECT_EQ(5, lines[1]);
+    EXPECT_EQ(6, lines[2]);
+  }
+
+  {
+    char name[]="/tmp/ndjson_test_XXXXXX";
+    int fd=mkstemp(name);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(static_cast<ssize_t>(s.size()), write(fd, s.data(), s.size()));
+    ::close(fd);
+
+    ndjson_reader r;
+    ASSERT_EQ(0, r.open(name));
+    json j;
+    int n=0;
+    while (r.next(j))
+      ++n;
+    EXPECT_EQ(1000, n);
+    r.close();
+    unlink(name);
+
+    EXPECT_EQ(-1, r.open("/tmp/ndjson_test_missing"));
+
+    // an empty file
+    char empty[]="/tmp/ndjson_test_XXXXXX";
+    fd=mkstemp(empty);
+    ASSERT_LE(0, fd);
+    ::close(fd);
+    ASSERT_EQ(0, r.open(empty));
+    EXPECT_FALSE(r.next(j));
+    r.close();
+    unlink(empty);
+  }
+}